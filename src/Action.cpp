@@ -40,6 +40,7 @@
 
 #include <iostream>
 #include "Action.h"
+#include "DB.h"
 
 namespace Piglet {
 
@@ -50,7 +51,8 @@ bool TripleAction::operator()(Node s, Node p, Node o) MAYFAIL
 
 bool DebugTripleAction::operator()(Triple *t) MAYFAIL
 {
-  std::cerr << t << "\n";
+  TemporaryString s(db()->toString(t)); // not the thread's current database
+  std::cerr << s.string() << "\n";
   delete t;
   return true;
 }
@@ -57,6 +57,7 @@ public:
   bool getInfo(CURLINFO option, void *data) MAYFAIL;
   bool findFileTime(const char *url, time_t *time) MAYFAIL;
   static bool getFileTime(const char *url, time_t *time) MAYFAIL;
+  CURL *handle(void) { return _curl; }
 private:
   CURL *_curl;
 };
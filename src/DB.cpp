@@ -39,29 +39,145 @@
  */
 #include <stdint.h>
 #include <iostream>
+#include <algorithm>
+#include <set>
 #include <stdio.h>
 #include <raptor.h>
 #include <time.h>
+#include <unistd.h>
 #include <string.h>
 #include "Curl.h"
+#include "Fetch.h"
 #include "Messages.h"
 #include "DB.h"
 #include "RaptorParser.h"
+#include "NTriplesParser.h"
+#include "LoadQueue.h"
+#include "LoadJob.h"
 #include "sqlconst.h"
 
 namespace Piglet {
 
-DB *DB::_current = NULL;
+// Each thread has a current database of its own, so that threads can work
+// on different databases
+
+static pthread_key_t currentKey;
+static pthread_once_t currentOnce = PTHREAD_ONCE_INIT;
+
+static void createCurrentKey(void)
+{
+  pthread_key_create(&currentKey, NULL);
+}
+
+DB *DB::current(void)
+{
+  pthread_once(&currentOnce, createCurrentKey);
+  return (DB *)pthread_getspecific(currentKey);
+}
+
+void DB::setCurrent(DB *db)
+{
+  pthread_once(&currentOnce, createCurrentKey);
+  pthread_setspecific(currentKey, db);
+}
+
+// Keys of the prepared statements kept in the SQL::Database. Statements over
+// triples combine the operation with the pattern shape (mask of bound
+// positions) and the table (persistent or temporary).
+
+enum StatementKey {
+  SQL_NODE_INFO = 1, SQL_NODE_FIND, SQL_NODE_INSERT, SQL_BNODE_FIND, SQL_BNODE_INSERT,
+  SQL_LITERAL_FIND, SQL_LITERAL_FIND_DT, SQL_LITERAL_FIND_LANG, SQL_NS_URI, SQL_NS_PREFIX,
+  SQL_SEQUENCE_UPDATE, SQL_SEQUENCE_READ,
+  SQL_TRIPLE_QUERY = 16, SQL_TRIPLE_EXISTS, SQL_TRIPLE_COUNT, SQL_TRIPLE_INSERT,
+  SQL_TRIPLE_DELETE, SQL_TRIPLE_SOURCES, SQL_TRIPLE_SORTED, SQL_TRIPLE_ROW
+};
+
+enum { BOUND_S = 1, BOUND_P = 2, BOUND_O = 4, BOUND_SRC = 8 };
+
+static inline int tripleKey(int op, int mask, bool temporary)
+{
+  return (op << 5) | (mask << 1) | (temporary ? 1 : 0);
+}
+
+static inline int wildcardMask(Node s, Node p, Node o, Node source)
+{
+  return (((s != NULL_NODE) ? BOUND_S : 0) | ((p != NULL_NODE) ? BOUND_P : 0) |
+          ((o != NULL_NODE) ? BOUND_O : 0) | ((source != NULL_NODE) ? BOUND_SRC : 0));
+}
+
+// Parsed triples are inserted without probing for duplicates first. The
+// success path ends bulk mode with end(), so that a failure to do so is
+// reported; when unwinding, the destructor ends it and only prints a failure,
+// as throwing there would terminate (dropped indexes are restored when the
+// store is next opened).
+
+class BulkScope {
+public:
+  BulkScope(DB *db) MAYFAIL : _db(db) { _db->beginBulk(); }
+  ~BulkScope(void);
+  void end(void) MAYFAIL;
+private:
+  DB *_db;
+};
+
+BulkScope::~BulkScope(void)
+{
+  if (_db) {
+    try {
+      _db->endBulk();
+    }
+    catch (Condition &c) {
+      std::cerr << c;
+    }
+  }
+}
+
+void BulkScope::end(void) MAYFAIL
+{
+  DB *db = _db;
+  _db = NULL;
+  db->endBulk();
+}
 
 DB::DB(char* name, bool verbose) MAYFAIL
 {
   verboseOps() = verbose;
-  RaptorParser::init(); // implies: uses RaptorParser, only one database per program (!)
+  _indexesDropped = false;
+  _recordedGraph = std::make_pair(0, 0);
+  RaptorParser::init();
+  _readers = NULL;
+  _loaders = NULL;
+  _pipelinedLoad = false;
+  _groupCommit = NULL;
+  _refresher = NULL;
+  _transactionOpen = false;
+  _transactionDepth = 0;
+  _ends = 0;
+  pthread_mutex_init(&_endLock, NULL);
+  pthread_cond_init(&_ended, NULL);
   _db = new SQL::Database(name, PIGLET_DEBUG);
   check(_db->isOpen(), ERR_DB_OPEN);
-  db("ATTACH ':memory:' AS cache;");
+  char *mode = NULL;
+  char *msg = NULL;
+  _db->exec("PRAGMA journal_mode=WAL;", &mode, (SQL::Callback)SQL::oneStringCallback, &msg);
+  SQL::TemporaryString error(msg); // not fatal; e.g. in-memory databases stay as they are
+  if (mode && (strcmp(mode, "wal") == 0)) {
+    // readers get connections of their own; temporary triples live in a
+    // shared-cache memory database that they can attach as well
+    char cache[64];
+    snprintf(cache, sizeof(cache), "file:piglet-cache-%p?mode=memory&cache=shared", (void *)this);
+    db(tempsql(SQL::query("ATTACH %Q AS cache;", cache)));
+    _readers = new SQL::ReaderPool(name, tempsql(SQL::query("ATTACH %Q AS cache;"
+                                                             "PRAGMA read_uncommitted=1;",
+                                                             cache)),
+                                   PIGLET_DEBUG);
+  }
+  else db("ATTACH ':memory:' AS cache;");
+  free(mode);
   db((char *)SQL_CREATE_TEMP_DB);
-  DB::_current = this;
+  _db->setRollbackHook(DB::rollbackHook, this);
+  DB::setCurrent(this);
   char *version = NULL;
   try {
     db("SELECT version FROM info", NULL, &version, (SQL::Callback)SQL::oneStringCallback);
@@ -73,65 +189,77 @@ DB::DB(char* name, bool verbose) MAYFAIL
       std::cerr << "Creating a new database\n";
     db((char *)SQL_CREATE_DB);
   }
+  if (version && (strcmp(version, "Piglet 0.3") != 0)) { // 0.1 and 0.2 differ only in triple
+    if (verboseOps())
+      std::cerr << "Upgrading database to version \"Piglet 0.3\"\n";
+    db((char *)SQL_MIGRATE_DB, ERR_DB_MIGRATE);
+  }
+  if (version) { // stores from before conditional fetches have no ETag column
+    char *msg = NULL;
+    if (_db->exec("SELECT etag FROM source LIMIT 0;", NULL, NULL, &msg) != SQL::Database::OK) {
+      SQL::TemporaryString ignored(msg);
+      db((char *)SQL_MIGRATE_SOURCE, ERR_DB_MIGRATE);
+    }
+  }
   free(version);
+  // also restores indexes left dropped by an interrupted bulk load
+  db((char *)SQL_CREATE_INDEXES, ERR_BULK);
+  db((char *)SQL_CREATE_SEQUENCE, ERR_NODE_ID); // stores from before it start from the node table
+  db((char *)SQL_CREATE_GRAPHS, ERR_SRC_GRAPH);
 }
 
 DB::~DB(void) MAYFAIL
 {
+  shutdown();
+  for (size_t i = 0; i < _snapshots.size(); i++)
+    delete _snapshots[i];
+  delete _loaders;
+  delete _readers;
   if (_db)
     delete _db; // closes native db connection
+  if (DB::current() == this)
+    DB::setCurrent(NULL);
+  pthread_cond_destroy(&_ended);
+  pthread_mutex_destroy(&_endLock);
   RaptorParser::finish();
 }
 
-int DB::newNodeID(void) MAYFAIL
-{
-  int id = 0;
-  db("SELECT max(id) FROM node;", ERR_NODE_ID, &id, (SQL::Callback)SQL::oneIntCallback);
-  return id + 1;
-}
-
-int DB::newLiteralID(void) MAYFAIL
-{
-  int id = 0;
-  db("SELECT min(id) FROM node;", ERR_NODE_ID, &id, (SQL::Callback)SQL::oneIntCallback);
-  return id - 1;
-}
-
-struct LiteralDetails {
-  char *str;
-  int datatype;
-  char *language;
-};
-
-static int literalDetailsCallback(LiteralDetails *ld, int argc, char **argv, char **cols)
-{
-  if (argv[0])
-    ld->str = strdup(argv[0]);
-  ld->datatype = atoi(argv[1]);
-  if (ld->language && argv[2])
-    strcpy(ld->language, argv[2]);
-  return 0;
-}
-
 char *DB::info(Node n, Node *datatype, char *language) MAYFAIL
 {
-  if (isLiteral(n)) {
-    LiteralDetails ld;
-    ld.str = NULL;
-    ld.datatype = 0;
-    ld.language = language;
-    db(tempsql(SQL::query("SELECT str, datatype, lang FROM node WHERE id = %d", id(n))),
-       ERR_NODE_DETAILS, (void *)&ld, (SQL::Callback)literalDetailsCallback);
-    if (datatype)
-      *datatype = Node(ld.datatype);
-    return ld.str;
+  char *str = NULL;
+  SQL::CachedStatement q(reader(), SQL_NODE_INFO);
+  if (!q.prepared())
+    q.prepare("SELECT str, datatype, lang FROM node WHERE id = ?1");
+  q->bind(1, id(n));
+  if (q->step(ERR_NODE_DETAILS)) {
+    if (!q->isNull(0))
+      str = strdup(q->text(0));
+    if (isLiteral(n)) {
+      if (datatype)
+        *datatype = Node(q->column(1));
+      if (language && !q->isNull(2))
+        strcpy(language, q->text(2));
+    }
   }
   else {
-    char *uri = NULL;
-    db(tempsql(SQL::query("SELECT str FROM node WHERE id = %d", id(n))),
-       ERR_NODE_DETAILS, &uri, (SQL::Callback)SQL::oneStringCallback);
-    return uri;
+    mutex::MutexLock lock(&_snapshotsMutex);
+    std::string key;
+    for (size_t i = 0; i < _snapshots.size(); i++)
+      if (_snapshots[i]->key(id(n), key)) {
+        if (!isLiteral(n))
+          return strdup(key.c_str());
+        // literal keys are "<datatype>@<language>\0<string>"
+        size_t at = key.find('@');
+        if (datatype)
+          *datatype = Node(atoi(key.c_str()));
+        if (language)
+          strcpy(language, key.c_str() + at + 1);
+        return strdup(key.c_str() + key.find('\0') + 1);
+      }
+    if (isLiteral(n) && datatype)
+      *datatype = NULL_NODE;
   }
+  return str;
 }
 
 char *DB::toString(const Node n) MAYFAIL
@@ -208,110 +336,269 @@ char *DB::toString(const Triple *t) MAYFAIL
   return s;
 }
 
+// The dictionary only takes the write lock to add a node. A cache hit takes a
+// shared lock of the cache, and a node committed earlier is found through a
+// reader connection; nodes not yet committed are visible to neither, so other
+// threads wait for the writer only when it could be adding the same node.
+
 Node DB::node(const char *uri, bool bnode) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
-  int id;
-  if (bnode) {
-    if (uri == NULL)
-      return node(NULL, false);
-    else {
-      id = 0;
-      db(tempsql(SQL::query("SELECT id FROM cache.bnode WHERE str=%Q;", uri)),
-         ERR_NODE_NEW, &id, (SQL::Callback)SQL::oneIntCallback);
-      if (id == 0) {
-        id = id(node(NULL, false));
-        db(tempsql(SQL::query("INSERT INTO cache.bnode VALUES(%d,%Q);", id, uri)), ERR_NODE_NEW);
-      }
+  if (uri == NULL) {
+    mutex::MutexLock lock(&_mutex, "node");
+    int id = newNodeID();
+    insertNode(id, NULL, NULL_NODE, NULL);
+    return Node(id);
+  }
+  NodeCache &cache = bnode ? _bnodeCache : _nodeCache;
+  std::string key(NodeCache::uriKey(uri));
+  int id = cache.find(key, writing());
+  if (id != 0)
+    return Node(id);
+  if (!bnode && (_readers != NULL) && !writing()) { // blank node labels are temporary
+    unsigned long epoch = cache.epoch();
+    id = findNode(SQL_NODE_FIND, "SELECT id FROM node WHERE str = ?1 AND id > 0", uri);
+    if (id != 0) {
+      cache.fill(key, id, epoch);
       return Node(id);
     }
   }
-  else if (uri == NULL) {
-    id = newNodeID();
-    db(tempsql(SQL::query("INSERT INTO node VALUES(%d, NULL, 0, NULL)", id)), ERR_NODE_NEW);
-    return Node(id);
+  mutex::MutexLock lock(&_mutex, "node");
+  if (bnode) {
+    id = findNode(SQL_BNODE_FIND, "SELECT id FROM cache.bnode WHERE str = ?1", uri);
+    if (id == 0) {
+      id = id(node(NULL, false));
+      SQL::CachedStatement q(_db, SQL_BNODE_INSERT);
+      if (!q.prepared())
+        q.prepare("INSERT INTO cache.bnode VALUES(?1, ?2)");
+      q->bind(1, id);
+      q->bind(2, uri);
+      q->step(ERR_NODE_NEW);
+    }
   }
   else {
-    int id = 0;
-    db(tempsql(SQL::query("SELECT id FROM node WHERE str = %Q AND id > 0", uri)),
-       ERR_NODE_FIND, &id, (SQL::Callback)SQL::oneIntCallback);
+    id = findNode(SQL_NODE_FIND, "SELECT id FROM node WHERE str = ?1 AND id > 0", uri);
     if (id == 0) {
-      id = newNodeID();
-      db(tempsql(SQL::query("INSERT INTO node VALUES(%d, %Q, 0, NULL)", id, uri)), ERR_NODE_NEW);
+      id = allocateID(key, false);
+      insertNode(id, uri, NULL_NODE, NULL);
     }
-    return Node(id);
   }
+  cache.insert(key, id, _db->inTransaction());
+  return Node(id);
 }
 
-Node DB::literal(const char *str, Node dt, const char *lang) MAYFAIL
+// IDs come from the watermarks in the sequence table, so that other
+// processes, or other DB instances on the same file, never hand out the same
+// ones. Outside of a transaction a block of IDs is reserved and committed at
+// once; within one the sequence is leased, and commit() writes the watermarks
+// back, so that a rollback takes nothing with it that is still handed out.
+
+static const int ID_BLOCK = 1024;
+
+int DB::newNodeID(void) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
-  int id = 0;
-  if (dt != NULL_NODE) {
-    db(tempsql(SQL::query("SELECT id FROM node WHERE str=%Q AND id<0 AND datatype=%d", str, id(dt))),
-       ERR_NODE_FIND, &id, (SQL::Callback)SQL::oneIntCallback);
-    if (id == 0) {
-      id = newLiteralID();
-      db(tempsql(SQL::query("INSERT INTO node VALUES(%d, %Q, %d, NULL)", id, str, id(dt))),
-         ERR_NODE_NEW);
-    }
+  int id = _sequence.nextNode();
+  if (id == 0) {
+    reserveIDs(1);
+    id = _sequence.nextNode();
   }
-  else if (lang != NULL) {
-    db(tempsql(SQL::query("SELECT id FROM node WHERE str=%Q AND id<0 AND lang=%Q", str, lang)),
-       ERR_NODE_FIND, &id, (SQL::Callback)SQL::oneIntCallback);
-    if (id == 0) {
-      id = newLiteralID();
-      db(tempsql(SQL::query("INSERT INTO node VALUES(%d, %Q, 0, %Q)", id, str, lang)), ERR_NODE_NEW);
-    }
+  return id;
+}
+
+int DB::newLiteralID(void) MAYFAIL
+{
+  int id = _sequence.nextLiteral();
+  if (id == 0) {
+    reserveIDs(1);
+    id = _sequence.nextLiteral();
   }
-  else {
-    db(tempsql(SQL::query("SELECT id FROM node WHERE str=%Q AND id<0", str)),
-       ERR_NODE_FIND, &id, (SQL::Callback)SQL::oneIntCallback);
-    if (id == 0) {
-      id = newLiteralID();
-      db(tempsql(SQL::query("INSERT INTO node VALUES(%d, %Q, 0, NULL)", id, str)), ERR_NODE_NEW);
+  return id;
+}
+
+int DB::reserveNodeIDs(int n) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "reserveNodeIDs");
+  int first = _sequence.reserveNodes(n);
+  if (first == 0) {
+    reserveIDs(n);
+    first = _sequence.reserveNodes(n);
+  }
+  return first;
+}
+
+int DB::reserveLiteralIDs(int n) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "reserveLiteralIDs");
+  int first = _sequence.reserveLiterals(n);
+  if (first == 0) {
+    reserveIDs(n);
+    first = _sequence.reserveLiterals(n);
+  }
+  return first;
+}
+
+void DB::reserveIDs(int n) MAYFAIL
+{
+  bool lease = _db->inTransaction();
+  int block = lease ? 0 : std::max(n, ID_BLOCK);
+  updateSequence(block); // also takes the write lock before the table is read
+  SQL::CachedStatement q(_db, SQL_SEQUENCE_READ);
+  if (!q.prepared())
+    q.prepare("SELECT high, low FROM sequence");
+  check(q->step(ERR_NODE_ID), ERR_NODE_ID);
+  if (lease)
+    _sequence.lease(q->column(0), q->column(1));
+  else
+    _sequence.grant(q->column(0), q->column(1), block);
+}
+
+// Raises the watermarks in the table to those in memory, and by block more
+
+void DB::updateSequence(int block) MAYFAIL
+{
+  int high, low;
+  _sequence.watermarks(&high, &low);
+  SQL::CachedStatement q(_db, SQL_SEQUENCE_UPDATE);
+  if (!q.prepared())
+    q.prepare("UPDATE sequence SET high = max(high, ?1) + ?3, low = min(low, ?2) - ?3");
+  q->bind(1, high);
+  q->bind(2, low);
+  q->bind(3, block);
+  q->step(ERR_NODE_ID);
+}
+
+// Nodes not yet in the node table keep the ID they have in an attached
+// snapshot, if any
+
+int DB::allocateID(const std::string &key, bool literal) MAYFAIL
+{
+  int id = findInSnapshots(key);
+  if (id != 0)
+    return id;
+  return literal ? newLiteralID() : newNodeID();
+}
+
+int DB::findNode(int key, const char *sql, const char *str, int datatype, const char *lang) MAYFAIL
+{
+  SQL::CachedStatement q(reader(), key);
+  if (!q.prepared())
+    q.prepare(sql);
+  q->bind(1, str);
+  if (datatype)
+    q->bind(2, datatype);
+  else if (lang)
+    q->bind(2, lang);
+  return q->step(ERR_NODE_FIND) ? q->column(0) : 0;
+}
+
+void DB::insertNode(int id, const char *str, Node datatype, const char *lang) MAYFAIL
+{
+  SQL::CachedStatement q(_db, SQL_NODE_INSERT);
+  if (!q.prepared())
+    q.prepare("INSERT INTO node VALUES(?1, ?2, ?3, ?4)");
+  q->bind(1, id);
+  q->bind(2, str);
+  q->bind(3, id(datatype));
+  q->bind(4, lang);
+  q->step(ERR_NODE_NEW);
+}
+
+Node DB::literal(const char *str, Node dt, const char *lang) MAYFAIL
+{
+  if (dt != NULL_NODE)
+    lang = NULL;
+  std::string key(NodeCache::literalKey(str, id(dt), lang));
+  int id = _nodeCache.find(key, writing());
+  if (id != 0)
+    return Node(id);
+  if ((_readers != NULL) && !writing()) {
+    unsigned long epoch = _nodeCache.epoch();
+    id = findLiteral(str, dt, lang);
+    if (id != 0) {
+      _nodeCache.fill(key, id, epoch);
+      return Node(id);
     }
   }
+  mutex::MutexLock lock(&_mutex, "literal");
+  id = findLiteral(str, dt, lang);
+  if (id == 0) {
+    id = allocateID(key, true);
+    insertNode(id, str, dt, lang);
+  }
+  _nodeCache.insert(key, id, _db->inTransaction());
   return Node(id);
 }
 
+int DB::findLiteral(const char *str, Node dt, const char *lang) MAYFAIL
+{
+  if (dt != NULL_NODE)
+    return findNode(SQL_LITERAL_FIND_DT,
+                    "SELECT id FROM node WHERE str = ?1 AND id < 0 AND datatype = ?2",
+                    str, id(dt));
+  else if (lang != NULL)
+    return findNode(SQL_LITERAL_FIND_LANG,
+                    "SELECT id FROM node WHERE str = ?1 AND id < 0 AND lang = ?2", str, 0, lang);
+  else
+    return findNode(SQL_LITERAL_FIND, "SELECT id FROM node WHERE str = ?1 AND id < 0", str);
+}
+
 bool DB::augmentLiteral(Node literal, Node datatype) MAYFAIL
 {
   if (id(literal) > 0)
     return false;
   else {
+    mutex::MutexLock lock(&_mutex, "augmentLiteral");
     Node oldDatatype = 0;
-    char *contents = info(literal, &oldDatatype, NULL);
-    if (contents != NULL)
-      free(contents);
+    char language[256];
+    language[0] = '\0';
+    TemporaryString contents(info(literal, &oldDatatype, language));
     if (oldDatatype == datatype)
       return true;
-    else
-      return db(tempsql(SQL::query("UPDATE node SET datatype = %d WHERE id=%d",
-                                   id(datatype), id(literal))),
-                ERR_NODE_NEW);
+    else {
+      if (contents.string() != NULL)
+        _nodeCache.erase(NodeCache::literalKey(contents.string(), id(oldDatatype),
+                                               language[0] ? language : NULL));
+      bool ok = db(tempsql(SQL::query("UPDATE node SET datatype = %d WHERE id=%d",
+                                      id(datatype), id(literal))),
+                   ERR_NODE_NEW);
+      if (!_db->inTransaction()) // the update has committed already
+        _nodeCache.commit();
+      return ok;
+    }
   }
 }
 
 bool DB::exists(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
 {
-  int i = 0;
-  db(tempsql(SQL::query("%s LIMIT 1",
-                        tempsql(makeWildcardQuery((temporary
-                                                   ? "SELECT 1 FROM cache.triple"
-                                                   : "SELECT 1 FROM triple"),
-                                                  s, p, o, source)))),
-     ERR_NODE_FIND, &i, (SQL::Callback)SQL::oneIntCallback);
-  return i == 1;
+  return (stored(s, p, o, source, temporary) ||
+          (!temporary && (matchSnapshots(s, p, o, source, NULL, 1) > 0)));
+}
+
+// Whether a pattern matches triples of the database itself, as opposed to
+// those of attached snapshots, which cannot be deleted
+
+bool DB::stored(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  int mask = wildcardMask(s, p, o, source);
+  SQL::CachedStatement q(reader(), tripleKey(SQL_TRIPLE_EXISTS, mask, temporary));
+  if (!q.prepared())
+    q.prepare((makeWildcardQuery((temporary
+                                  ? "SELECT 1 FROM cache.triple"
+                                  : "SELECT 1 FROM triple"), mask) + " LIMIT 1").c_str());
+  bindWildcard(q.statement(), s, p, o, source);
+  return q->step(ERR_NODE_FIND);
 }
 
-static int tripleCallback(TripleAction *action, int argc, char **argv, char **cols)
+// Like stored(), but for exactly one quad; a source of 0 is matched as such
+// rather than as a wildcard
+
+bool DB::storedQuad(const Quad &quad) MAYFAIL
 {
-  int rval;
-  Triple *t = new Triple(atoi(argv[0]), atoi(argv[1]), atoi(argv[2]));
-  rval = (*action)(t) ? 0 : 1;
-  delete t;
-  return rval;
+  SQL::CachedStatement q(reader(), tripleKey(SQL_TRIPLE_ROW, 0, false));
+  if (!q.prepared())
+    q.prepare("SELECT 1 FROM triple WHERE s = ?1 AND p = ?2 AND o = ?3 AND src = ?4 LIMIT 1");
+  for (int i = 0; i < 4; i++)
+    q->bind(i + 1, quad.k[i]);
+  return q->step(ERR_NODE_FIND);
 }
 
 static int nodeCallback(NodeAction *nodes, int argc, char **argv, char **cols)
@@ -340,12 +627,94 @@ Triples *DB::query(Node subject, Node predicate, Node object, Node source) MAYFA
 
 bool DB::query(Node subject, Node predicate, Node object, Node source, TripleAction *action) MAYFAIL
 {
-  return db(tempsql(SQL::query("%s UNION %s", // UNION implies DISTINCT
-                               tempsql(makeWildcardQuery("SELECT s,p,o FROM triple",
-                                                         subject, predicate, object, source)),
-                               tempsql(makeWildcardQuery("SELECT s,p,o FROM cache.triple",
-                                                         subject, predicate, object, source)))),
-            ERR_TRIPLE_FIND, action, (SQL::Callback)tripleCallback);
+  TripleCursor *c = cursor(subject, predicate, object, source);
+  try {
+    while (c->hasNext()) {
+      Triple t = c->next();
+      if (!(*action)(t.s(), t.p(), t.o())) {
+        delete c;
+        return false;
+      }
+    }
+  }
+  catch (Condition &e) {
+    delete c;
+    throw;
+  }
+  delete c;
+  return true;
+}
+
+// With snapshots attached, the SQL results are read in (s, p, o) order and
+// merged with the (sorted) snapshot matches as the cursor advances
+
+// With snapshots attached, the query is sorted in the order their cursors
+// produce triples in for the pattern, and the cursors are merged as they go
+
+TripleCursor *DB::cursor(Node subject, Node predicate, Node object, Node source) MAYFAIL
+{
+  std::vector<TripleCursor *> cursors;
+  snapshotCursors(subject, predicate, object, source, cursors);
+  bool merge = !cursors.empty();
+  try {
+    cursors.push_back(tripleCursor(subject, predicate, object, source, merge));
+  }
+  catch (Condition &c) {
+    for (size_t i = 0; i < cursors.size(); i++)
+      delete cursors[i];
+    throw;
+  }
+  if (!merge)
+    return cursors[0];
+  return new MergeTripleCursor(cursors,
+                               planPattern(id(subject), id(predicate), id(object), id(source)).order);
+}
+
+// The ORDER BY clause that sorts s, p, o columns like a QuadOrder
+
+const char *DB::orderBy(QuadOrder order)
+{
+  static const char *clauses[3] = { " ORDER BY 1, 2, 3", " ORDER BY 2, 3, 1", " ORDER BY 3, 1, 2" };
+  return clauses[order];
+}
+
+// Cursors over the snapshots that have matches for a pattern
+
+void DB::snapshotCursors(Node s, Node p, Node o, Node source, std::vector<TripleCursor *> &cursors)
+{
+  mutex::MutexLock lock(&_snapshotsMutex);
+  for (size_t i = 0; i < _snapshots.size(); i++) {
+    SnapshotCursor *c = new SnapshotCursor(_snapshots[i], id(s), id(p), id(o), id(source));
+    if (c->hasNext())
+      cursors.push_back(c);
+    else
+      delete c;
+  }
+}
+
+// A cursor over the triple tables of the main file, permanent and temporary,
+// sorted in the order planPattern() picks for the pattern if asked to
+
+TripleCursor *DB::tripleCursor(Node s, Node p, Node o, Node source, bool sorted) MAYFAIL
+{
+  int mask = wildcardMask(s, p, o, source);
+  SQL::CachedStatement *q =
+    new SQL::CachedStatement(reader(), tripleKey(sorted ? SQL_TRIPLE_SORTED : SQL_TRIPLE_QUERY,
+                                                 mask, false));
+  try {
+    if (!q->prepared())
+      q->prepare((makeWildcardQuery("SELECT s,p,o FROM triple", mask) +
+                  " UNION " + // UNION implies DISTINCT
+                  makeWildcardQuery("SELECT s,p,o FROM cache.triple", mask) +
+                  (sorted ? orderBy(planPattern(id(s), id(p), id(o), id(source)).order)
+                          : "")).c_str());
+    bindWildcard(q->statement(), s, p, o, source);
+  }
+  catch (Condition &c) {
+    delete q;
+    throw;
+  }
+  return new SQLTripleCursor(q);
 }
 
 bool DB::queryUsingSQL(char *condition, GenericAction *action) MAYFAIL
@@ -361,9 +730,31 @@ bool DB::queryUsingSQL(char *condition, GenericAction *action) MAYFAIL
 bool DB::sources(Triple *triple, NodeAction *action) MAYFAIL
 {
   // should this also query the temporary table?
-  return db(tempsql(makeWildcardQuery("SELECT DISTINCT src FROM triple",
-                                      triple->s(), triple->p(), triple->o(), NULL_NODE)),
-            ERR_SRC_QUERY, action, (SQL::Callback)nodeCallback);
+  int mask = wildcardMask(triple->s(), triple->p(), triple->o(), NULL_NODE);
+  SQL::CachedStatement q(reader(), tripleKey(SQL_TRIPLE_SOURCES, mask, false));
+  if (!q.prepared())
+    q.prepare(makeWildcardQuery("SELECT DISTINCT src FROM triple", mask).c_str());
+  bindWildcard(q.statement(), triple->s(), triple->p(), triple->o(), NULL_NODE);
+  if (_snapshots.empty()) {
+    while (q->step(ERR_SRC_QUERY))
+      if (!q->isNull(0) && !(*action)(Node(q->column(0))))
+        return false;
+    return true;
+  }
+  std::vector<Quad> rows;
+  std::vector<int> sources;
+  while (q->step(ERR_SRC_QUERY))
+    if (!q->isNull(0))
+      sources.push_back(q->column(0));
+  matchSnapshots(triple->s(), triple->p(), triple->o(), NULL_NODE, &rows);
+  for (std::vector<Quad>::const_iterator r = rows.begin(); r != rows.end(); r++)
+    sources.push_back(r->k[3]);
+  std::sort(sources.begin(), sources.end());
+  sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+  for (std::vector<int>::const_iterator i = sources.begin(); i != sources.end(); i++)
+    if (!(*action)(Node(*i)))
+      return false;
+  return true;
 }
 
 Nodes *DB::sources(Triple *triple) MAYFAIL
@@ -377,81 +768,63 @@ Nodes *DB::sources(Triple *triple) MAYFAIL
   }
 }
 
-char* DB::makeWildcardQuery(const char *pre, Node s, Node p, Node o, Node source)
+// Patterns use the numbered parameters ?1, ?2, ?3 and ?4 for s, p, o and src,
+// so that any shape can be bound the same way by bindWildcard(). Unless src is
+// the only bound position it is written +src, which keeps the (unanalyzed)
+// planner from preferring the src index over the spo, pos and osp orderings
+
+std::string DB::makeWildcardQuery(const char *pre, int mask)
 {
-  if (s == NULL_NODE) {             // [*,?,?,?]
-    if (p == NULL_NODE) {           // [*,*,?,?]
-      if (o == NULL_NODE) {         // [*,*,*,?]
-        if (source == NULL_NODE)    // [*,*,*,*]
-          return SQL::query("%s", pre);
-        else                        // [*,*,*,source]
-          return SQL::query("%s WHERE src=%d", pre, id(source));
-      }
-      else if (source == NULL_NODE) // [*,*,o,*]
-        return SQL::query("%s WHERE o=%d", pre, id(o));
-      else                          // [*,*,o,source]
-        return SQL::query("%s WHERE o=%d AND src=%d", pre, id(o), id(source));
-    }
-    else if (o == NULL_NODE) {      // [*,p,*,?]
-      if (source == NULL_NODE)      // [*,p,*,*]
-        return SQL::query("%s WHERE p=%d", pre, id(p));
-      else
-        return SQL::query("%s WHERE p=%d AND src=%d", pre, id(p), id(source));
-    }
-    else if (source == NULL_NODE)   // [*,p,o,*]
-      return SQL::query("%s WHERE p=%d AND o=%d", pre, id(p), id(o));
-    else
-      return SQL::query("%s WHERE p=%d AND o=%d AND src=%d", pre, id(p), id(o), id(source));
-  }
-  else if (p == NULL_NODE) {        // [s,*,?,?]
-    if (o == NULL_NODE) {           // [s,*,*,?]
-      if (source == NULL_NODE)      // [s,*,*,*]
-        return SQL::query("%s WHERE s=%d", pre, id(s));
-      else
-        return SQL::query("%s WHERE s=%d AND src=%d", pre, id(s), id(source));
-    }
-    else if (source == NULL_NODE)   // [s,*,o,*]
-      return SQL::query("%s WHERE s=%d AND o=%d", pre, id(s), id(o));
-    else                            // [s,*,o,source]
-      return SQL::query("%s WHERE s=%d AND o=%d AND src=%d", pre, id(s), id(o), id(source));
-  }
-  else if (o == NULL_NODE) {        // [s,p,*,?]
-    if (source == NULL_NODE)        // [s,p,*,*]
-      return SQL::query("%s WHERE s=%d AND p=%d", pre, id(s), id(p));
-    else                            // [s,p,*,source]
-      return SQL::query("%s WHERE s=%d AND p=%d AND src=%d", pre, id(s), id(p), id(source));
-  }
-  else if (source == NULL_NODE)     // [s,p,o,*]
-    return SQL::query("%s WHERE s=%d AND p=%d AND o=%d", pre, id(s), id(p), id(o));
-  else
-    return SQL::query("%s WHERE s=%d AND p=%d AND o=%d AND src=%d",
-                      pre, id(s), id(p), id(o), id(source));
+  const char *conditions[] = { "s=?1", "p=?2", "o=?3",
+                               (mask == BOUND_SRC) ? "src=?4" : "+src=?4" };
+  std::string query(pre);
+  const char *glue = " WHERE ";
+  for (int i = 0; i < 4; i++)
+    if (mask & (1 << i)) {
+      query.append(glue);
+      query.append(conditions[i]);
+      glue = " AND ";
+    }
+  return query;
+}
+
+void DB::bindWildcard(SQL::Statement *statement, Node s, Node p, Node o, Node source)
+{
+  if (s != NULL_NODE)      statement->bind(1, id(s));
+  if (p != NULL_NODE)      statement->bind(2, id(p));
+  if (o != NULL_NODE)      statement->bind(3, id(o));
+  if (source != NULL_NODE) statement->bind(4, id(source));
 }
 
+// Uniqueness of (s, p, o, src) is enforced by the primary key; outside of
+// bulk mode we still probe first, since a triple without a source must not
+// duplicate one that has a source, nor a temporary triple a permanent one
+
 Triple *DB::add(Triple *t, Node source, bool temporary) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
-  if (temporary) {
-    if (exists(t->s(), t->p(), t->o(), source, true) ||
-        exists(t->s(), t->p(), t->o(), source, false))
-      return NULL;
-    else {
-      db(tempsql(SQL::query("INSERT INTO cache.triple VALUES (%d, %d, %d, %d)",
-                            id(t->s()), id(t->p()), id(t->o()), id(source))),
-         ERR_TRIPLE_ADD);
-      return t;
-    }
-  }
-  else {
-    if (exists(t->s(), t->p(), t->o(), source, false))
-      return NULL;
-    else {
-      db(tempsql(SQL::query("INSERT INTO triple VALUES (%d, %d, %d, %d)",
-                            id(t->s()), id(t->p()), id(t->o()), id(source))),
-         ERR_TRIPLE_ADD);
-      return t;
-    }
-  }
+  if (_groupCommit && !writing())
+    return _groupCommit->write(true, t->s(), t->p(), t->o(), source, temporary) ? t : NULL;
+  mutex::MutexLock lock(&_mutex, "add");
+  if (!inBulk() &&
+      (exists(t->s(), t->p(), t->o(), source, temporary) ||
+       (temporary && exists(t->s(), t->p(), t->o(), source, false))))
+    return NULL;
+  return insertTriple(t->s(), t->p(), t->o(), source, temporary) ? t : NULL;
+}
+
+bool DB::insertTriple(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  SQL::CachedStatement q(_db, tripleKey(SQL_TRIPLE_INSERT, 0, temporary));
+  if (!q.prepared())
+    q.prepare(temporary
+              ? "INSERT OR IGNORE INTO cache.triple VALUES (?1, ?2, ?3, ?4)"
+              : "INSERT OR IGNORE INTO triple VALUES (?1, ?2, ?3, ?4)");
+  q->bind(1, id(s));
+  q->bind(2, id(p));
+  q->bind(3, id(o));
+  q->bind(4, id(source));
+  q->step(ERR_TRIPLE_ADD);
+  return (_db->changes() > 0);
 }
 
 void DB::addQuick(Node subject, Node predicate, Node object) MAYFAIL
@@ -479,31 +852,49 @@ bool DB::addPostProcess(Triple *t) MAYFAIL
 
 Triple *DB::del(Triple *t, Node source, bool temporary) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
-  if (exists(t->s(), t->p(), t->o(), source, temporary)) {
-    db(tempsql(makeWildcardQuery((temporary ? "DELETE FROM cache.triple" : "DELETE FROM triple"),
-                                 t->s(), t->p(), t->o(), source)),
-       ERR_TRIPLE_DEL);
+  if (_groupCommit && !writing())
+    return _groupCommit->write(false, t->s(), t->p(), t->o(), source, temporary) ? t : NULL;
+  mutex::MutexLock lock(&_mutex, "del");
+  if (stored(t->s(), t->p(), t->o(), source, temporary)) {
+    deleteTriples(t->s(), t->p(), t->o(), source, temporary);
     return t;
   }
   else return NULL;
 }
 
+void DB::deleteTriples(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  int mask = wildcardMask(s, p, o, source);
+  SQL::CachedStatement q(_db, tripleKey(SQL_TRIPLE_DELETE, mask, temporary));
+  if (!q.prepared())
+    q.prepare(makeWildcardQuery((temporary ? "DELETE FROM cache.triple" : "DELETE FROM triple"),
+                                mask).c_str());
+  bindWildcard(q.statement(), s, p, o, source);
+  q->step(ERR_TRIPLE_DEL);
+}
+
 int DB::count(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
 {
-  int n = 0;
-  db(tempsql(makeWildcardQuery((temporary
-                                ? "SELECT count(*) FROM cache.triple"
-                                : "SELECT count(*) FROM triple"),
-                               s, p, o, source)),
-     ERR_TRIPLE_FIND, &n, (SQL::Callback)SQL::oneIntCallback);
-  //db("SELECT count(*) FROM triple;", ERR_SRC_QUERY, &n, (SQL::Callback)SQL::oneIntCallback);
-  return n;
+  int n = storedCount(s, p, o, source, temporary);
+  return temporary ? n : n + (int)countSnapshotOnly(s, p, o, source, n > 0);
+}
+
+int DB::storedCount(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  int mask = wildcardMask(s, p, o, source);
+  SQL::CachedStatement q(reader(), tripleKey(SQL_TRIPLE_COUNT, mask, temporary));
+  if (!q.prepared())
+    q.prepare(makeWildcardQuery((temporary
+                                 ? "SELECT count(*) FROM cache.triple"
+                                 : "SELECT count(*) FROM triple"),
+                                mask).c_str());
+  bindWildcard(q.statement(), s, p, o, source);
+  return q->step(ERR_TRIPLE_FIND) ? q->column(0) : 0;
 }
 
 bool DB::addNamespace(const char *prefix, const char *uri) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
+  mutex::MutexLock lock(&_mutex, "addNamespace");
   if (temp(prefix2namespace(prefix)))
     return false;
   else {
@@ -514,16 +905,13 @@ bool DB::addNamespace(const char *prefix, const char *uri) MAYFAIL
 
 void DB::delNamespace(const char *prefix) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
+  mutex::MutexLock lock(&_mutex, "delNamespace");
   db(tempsql(SQL::query("DELETE FROM namespace WHERE prefix=%Q", prefix)), ERR_NS_DEL);
 }
 
 char *DB::prefix2namespace(const char *prefix) MAYFAIL
 {
-  char *uri = NULL;
-  db(tempsql(SQL::query("SELECT uri FROM namespace WHERE prefix=%Q", prefix)),
-     ERR_NS_FIND, &uri, (SQL::Callback)SQL::oneStringCallback);
-  return uri;
+  return findString(SQL_NS_URI, "SELECT uri FROM namespace WHERE prefix = ?1", prefix);
 }
 
 // char *DB::prefix2namespace_m3(const char *prefix) MAYFAIL
@@ -539,10 +927,16 @@ char *DB::prefix2namespace(const char *prefix) MAYFAIL
 
 char *DB::namespace2prefix(const char *uri) MAYFAIL
 {
-  char *prefix = NULL;
-  db(tempsql(SQL::query("SELECT prefix FROM namespace WHERE uri=%Q", uri)),
-     ERR_NS_FIND, &prefix, (SQL::Callback)SQL::oneStringCallback);
-  return prefix;
+  return findString(SQL_NS_PREFIX, "SELECT prefix FROM namespace WHERE uri = ?1", uri);
+}
+
+char *DB::findString(int key, const char *sql, const char *arg) MAYFAIL
+{
+  SQL::CachedStatement q(reader(), key);
+  if (!q.prepared())
+    q.prepare(sql);
+  q->bind(1, arg);
+  return (q->step(ERR_NS_FIND) && !q->isNull(0)) ? strdup(q->text(0)) : NULL;
 }
 
 char *DB::nodeQName(Node n) MAYFAIL
@@ -583,9 +977,20 @@ char *DB::qName2URI(const char *qname) MAYFAIL
   for (p = prefix, q = (char *)qname; *q != '\0' && *q != ':'; *p++ = *q++);
   check(*q != '\0', ERR_NS_FIND);
   *p = '\0';
-  char *uri = NULL;
-  db(tempsql(SQL::query("SELECT uri||%Q FROM namespace WHERE prefix=%Q", q+1, prefix)),
-     ERR_NS_FIND, &uri, (SQL::Callback)SQL::oneStringCallback);
+  return expandQName(prefix, q + 1);
+}
+
+// Namespaces are read like the rest of the store, through the reader
+// connection of the calling thread
+
+char *DB::expandQName(const char *prefix, const char *name) MAYFAIL
+{
+  TemporaryString ns(prefix2namespace(prefix));
+  if (ns.string() == NULL)
+    return NULL;
+  char *uri = (char *)malloc(strlen(ns.string()) + strlen(name) + 1);
+  strcpy(uri, ns.string());
+  strcat(uri, name);
   return uri;
 }
 
@@ -613,8 +1018,7 @@ char *DB::tryQName2URI_m3(const char *qname)
     // std::cerr << "tryQName2URI_m3: " << (char *)qname << "\n";
     return uri;
   }
-  db(tempsql(SQL::query("SELECT uri||%Q FROM namespace WHERE prefix=%Q", q+1, prefix)),
-     ERR_NS_FIND, &uri, (SQL::Callback)SQL::oneStringCallback);
+  uri = expandQName(prefix, q + 1);
   if (uri) {
     // std::cerr << "tryQName2URI_m3: expanded " << (char *)qname << " to " << (char *)uri << "\n";
     return uri;
@@ -648,7 +1052,7 @@ bool DB::load(Node source, unsigned char* content, bool verbose) MAYFAIL
    * -- juhonkol
    */
 
-  mutex::MutexLock lock(&_mutex);
+  mutex::MutexLock lock(&_mutex, "load");
   bool terminated = false;
   TemporaryString uri(info(source));
   verbose = verbose | PIGLET_DEBUG | verboseOps();
@@ -658,96 +1062,242 @@ bool DB::load(Node source, unsigned char* content, bool verbose) MAYFAIL
     std::cerr.flush();
   }
 
-  time_t old_filetime = -1, new_filetime;
-  bool reload = true;
-  db(tempsql(SQL::query("SELECT created FROM source WHERE src=%d LIMIT 1", id(source))),
-     ERR_SRC_FIND, &old_filetime, (SQL::Callback)SQL::oneIntCallback);
-  reload = (old_filetime != -1);
-
-  Parser *parser = createParser();
-  db("BEGIN TRANSACTION;");
+  Parser *parser = createParser(source);
+  transaction();
   try {
-    db("DELETE FROM cache.bnode;");
-    parser->parse(source, content);
+    {
+      BulkScope bulk(this);
+      parser->parse(source, content);
+      bulk.end();
+    }
     if (parser->terminated()) {
       terminated = true;
-      db("ROLLBACK;");
+      rollback();
+    }
+    else {
+      markLoaded(source, 0);
+      commit();
     }
-    else db(tempsql(reload
-		    ? SQL::query("UPDATE source SET loaded=%d, created=%d WHERE src=%d; COMMIT",
-				 time(NULL), new_filetime, id(source))
-		    : SQL::query("INSERT INTO source VALUES (%d, %d, %d); COMMIT",
-				 id(source), new_filetime, time(NULL))),
-	    ERR_SRC_TIME);
   }
   catch (Condition &c) {
-    db("ROLLBACK;");
+    rollback();
     if (verbose) std::cerr << "failed\n";
     throw;
   }
   if (verbose)
     std::cerr << (terminated? "failed\n" : "done\n");
   delete parser;
-  db("DELETE FROM cache.bnode;");
   
   return !terminated;
 }
 
 bool DB::load(Node source, bool append, bool verbose, char *script, char *argv[]) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
-  bool terminated = false;
-  TemporaryString uri(info(source));
+  return loadSource(source, append, verbose, script, argv, NULL);
+}
+
+// Starts loading a source on a thread of its own; the caller owns the job
+
+// Content loaded from a string or in chunks has no modification time of its
+// own; it is recorded as 0, so that a later load() of the source's URL reloads
+
+void DB::markLoaded(Node source, time_t filetime, const std::string &etag) MAYFAIL
+{
+  int created = -1;
+  const char *tag = etag.empty() ? NULL : etag.c_str();
+  db(tempsql(SQL::query("SELECT created FROM source WHERE src=%d LIMIT 1", id(source))),
+     ERR_SRC_FIND, &created, (SQL::Callback)SQL::oneIntCallback);
+  db(tempsql((created != -1)
+             ? SQL::query("UPDATE source SET loaded=%d, created=%d, etag=%Q WHERE src=%d",
+                          (int)time(NULL), (int)filetime, tag, id(source))
+             : SQL::query("INSERT INTO source (src, created, loaded, etag) VALUES (%d, %d, %d, %Q)",
+                          id(source), (int)filetime, (int)time(NULL), tag)),
+     ERR_SRC_TIME);
+}
+
+// A chunked load holds the lock from loadBegin() until loadEnd(), so that
+// the writes of other threads wait for it instead of going into its
+// transaction (and being rolled back with it)
+
+ChunkedLoad *DB::loadBegin(Node source, bool verbose) MAYFAIL
+{
+  _mutex.lock("chunkedLoad");
   verbose = verbose | PIGLET_DEBUG | verboseOps();
-  if (verbose) {
-    std::cerr << "Loading: " << uri.string();
-    if (script != NULL)
-      std::cerr << " using script " << script;
-    std::cerr << "...";
-    std::cerr.flush();
-  }
-  time_t old_filetime = -1, new_filetime;
-  bool reload = true;
-  if (script == NULL) {
-    db(tempsql(SQL::query("SELECT created FROM source WHERE src=%d LIMIT 1", id(source))),
-       ERR_SRC_FIND, &old_filetime, (SQL::Callback)SQL::oneIntCallback);
-    reload = (old_filetime != -1);
+  Parser *parser = NULL;
+  bool begun = false;
+  try {
+    if (verbose) {
+      TemporaryString uri(info(source));
+      std::cerr << "Loading: " << uri.string() << "...";
+      std::cerr.flush();
+    }
+    parser = createParser(source);
+    transaction();
+    begun = true;
+    if (!parser->parseBegin(source) && !parser->terminated())
+      parser->terminate("Unable to start parsing");
+    return new ChunkedLoad(this, source, parser, verbose);
   }
-  if ((script == NULL) && !libcurl::Curl::getFileTime(uri.string(), &new_filetime)) {
-    terminated = true;
+  catch (Condition &c) {
+    if (begun)
+      rollback();
+    delete parser;
+    _mutex.unlock();
     if (verbose) std::cerr << "failed\n";
+    throw;
   }
-  else if ((script != NULL) || !reload || ((new_filetime != 0) && (new_filetime > old_filetime))) {
-    Parser *parser = createParser();
-    db("BEGIN TRANSACTION;");
-    try {
-      db("DELETE FROM cache.bnode;");
-      if (!append) // this is still a hack (compared to Wilbur functionality)
-        delSourceTriples(source);
-      if (script == NULL)
-        parser->parse(source);
-      else
-        parser->parseFromScript(source, script, argv);
-      if (parser->terminated()) {
-        terminated = true;
-        db("ROLLBACK;");
-      }
-      else db(tempsql(reload
-                      ? SQL::query("UPDATE source SET loaded=%d, created=%d WHERE src=%d; COMMIT",
-                                   time(NULL), new_filetime, id(source))
-                      : SQL::query("INSERT INTO source VALUES (%d, %d, %d); COMMIT",
-                                   id(source), new_filetime, time(NULL))),
-           ERR_SRC_TIME);
-    }
+}
+
+// Gives up the lock held since loadBegin()
+
+class ChunkedLoadHold {
+public:
+  ChunkedLoadHold(mutex::Mutex *mutex) : _mutex(mutex) {}
+  ~ChunkedLoadHold(void) MAYFAIL { _mutex->unlock(); }
+private:
+  mutex::Mutex *_mutex;
+};
+
+// Each chunk is parsed in bulk mode of its own, so that other writers are
+// not left in bulk mode between chunks
+
+bool DB::loadChunk(ChunkedLoad *load, const unsigned char *data, size_t length) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "load");
+  Parser *parser = load->_parser;
+  if (!parser->terminated()) {
+    try {
+      BulkScope bulk(this);
+      parser->parseChunk(data, length);
+      bulk.end();
+    }
     catch (Condition &c) {
-      db("ROLLBACK;");
+      parser->terminate(c.message()); // end() rolls back
+      throw;
+    }
+  }
+  return !parser->terminated();
+}
+
+bool DB::loadEnd(ChunkedLoad *load, bool keep) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "load");
+  ChunkedLoadHold hold(&_mutex);
+  Parser *parser = load->_parser;
+  bool loaded = false;
+  try {
+    if (keep && !parser->terminated()) {
+      BulkScope bulk(this);
+      parser->parseEnd();
+      bulk.end();
+    }
+    loaded = keep && !parser->terminated();
+    if (loaded) {
+      markLoaded(load->_source, 0);
+      commit();
+    }
+    else
+      rollback();
+  }
+  catch (Condition &c) {
+    rollback();
+    if (load->_verbose) std::cerr << "failed\n";
+    throw;
+  }
+  if (load->_verbose)
+    std::cerr << (loaded ? "done\n" : "failed\n");
+  return loaded;
+}
+
+LoadJob *DB::loadAsync(Node source, bool append, bool verbose, LoadProgress *progress) MAYFAIL
+{
+  LoadJob *job = new LoadJob(this, source, append, verbose, progress);
+  try {
+    job->start();
+  }
+  catch (Condition &c) {
+    delete job;
+    throw;
+  }
+  return job;
+}
+
+// A load run as a job reports its progress, and can be cancelled; file:
+// sources are then read through a stream of our own so that the number of
+// bytes read is known. Other loads without a script are fetched as below.
+
+bool DB::loadSource(Node source, bool append, bool verbose, char *script, char *argv[],
+                    LoadJob *job) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "load");
+  bool terminated = false;
+  TemporaryString uri(info(source));
+  verbose = verbose | PIGLET_DEBUG | verboseOps();
+  if (verbose) {
+    std::cerr << "Loading: " << uri.string();
+    if (script != NULL)
+      std::cerr << " using script " << script;
+    std::cerr << "...";
+    std::cerr.flush();
+  }
+  if ((script == NULL) && !_pipelinedLoad &&
+      ((job == NULL) || (strncmp(uri.string(), "file://", 7) != 0)))
+    return loadFetched(source, uri.string(), append, verbose, job);
+  time_t old_filetime = -1, new_filetime;
+  bool reload = true;
+  if (script == NULL) {
+    db(tempsql(SQL::query("SELECT created FROM source WHERE src=%d LIMIT 1", id(source))),
+       ERR_SRC_FIND, &old_filetime, (SQL::Callback)SQL::oneIntCallback);
+    reload = (old_filetime != -1);
+  }
+  if ((script == NULL) && !libcurl::Curl::getFileTime(uri.string(), &new_filetime)) {
+    terminated = true;
+    if (verbose) std::cerr << "failed\n";
+  }
+  else if ((script != NULL) || !reload || ((new_filetime != 0) && (new_filetime > old_filetime))) {
+    Parser *parser = _pipelinedLoad ? NULL : createParser(source);
+    transaction();
+    try {
+      if (!append) // this is still a hack (compared to Wilbur functionality)
+        delSourceTriples(source);
+      {
+        BulkScope bulk(this);
+        if (_pipelinedLoad)
+          terminated = !loadPipelined(source, script, argv, job);
+        else {
+          FILE *stream = NULL;
+          parser->setJob(job);
+          if ((job != NULL) && (script == NULL) && (strncmp(uri.string(), "file://", 7) == 0))
+            stream = fopen(uri.string() + 7, "r");
+          if (stream != NULL) {
+            job->setStream(stream);
+            parser->parse(source, stream);
+            job->setStream(NULL);
+            fclose(stream);
+          }
+          else if (script == NULL)
+            parser->parse(source);
+          else
+            parser->parseFromScript(source, script, argv);
+          terminated = parser->terminated();
+        }
+        bulk.end();
+      }
+      if (terminated)
+        rollback();
+      else {
+        markLoaded(source, new_filetime);
+        commit();
+      }
+    }
+    catch (Condition &c) {
+      rollback();
       std::cerr << "failed\n";
       throw;
     }
     if (verbose)
       std::cerr << (terminated ? "failed\n" : "done\n");
     delete parser;
-    db("DELETE FROM cache.bnode;");
   }
   else if (verbose)
     std::cerr << "no reload needed\n";
@@ -755,35 +1305,744 @@ bool DB::load(Node source, bool append, bool verbose, char *script, char *argv[]
   return !terminated;
 }
 
-Parser *DB::createParser(void)
+// A fetched load asks for the source with a single conditional GET, sending
+// the validators it was last loaded with, and begins its transaction only
+// once the content is known to have changed; an unchanged source costs one
+// round trip and nothing else
+
+class LoadStart : public FetchStart {
+public:
+  LoadStart(DB *db, Node source, bool replace)
+    : begun(false), _db(db), _source(source), _replace(replace) {}
+  virtual void operator()(void) MAYFAIL {
+    _db->transaction();
+    begun = true;
+    if (_replace)
+      _db->delSourceTriples(_source);
+  }
+  bool begun;
+private:
+  DB *_db;
+  Node _source;
+  bool _replace;
+};
+
+static int validatorsCallback(Validators *validators, int argc, char **argv, char **cols)
+{
+  validators->modified = argv[0] ? (time_t)atol(argv[0]) : 0;
+  validators->etag = argv[1] ? argv[1] : "";
+  return 0;
+}
+
+bool DB::loadFetched(Node source, const char *uri, bool append, bool verbose,
+                     LoadJob *job) MAYFAIL
+{
+  Validators known;
+  db(tempsql(SQL::query("SELECT created, etag FROM source WHERE src=%d LIMIT 1", id(source))),
+     ERR_SRC_FIND, &known, (SQL::Callback)validatorsCallback);
+  Parser *parser = createParser(source);
+  parser->setJob(job);
+  Fetch fetch(uri, _fetchCache);
+  LoadStart start(this, source, !append);
+  Fetch::Outcome outcome;
+  bool terminated;
+  try {
+    {
+      BulkScope bulk(this);
+      outcome = fetch.run(parser, source, known, &start);
+      bulk.end();
+    }
+    terminated = (outcome == Fetch::FAILED) || parser->terminated();
+    if (start.begun) {
+      if (terminated)
+        rollback();
+      else {
+        markLoaded(source, fetch.validators().modified, fetch.validators().etag);
+        commit();
+      }
+    }
+  }
+  catch (Condition &c) {
+    if (start.begun)
+      rollback();
+    delete parser;
+    if (verbose) std::cerr << "failed\n";
+    throw;
+  }
+  delete parser;
+  if (verbose)
+    std::cerr << ((outcome == Fetch::NOT_MODIFIED) ? "no reload needed\n"
+                  : terminated ? "failed\n" : "done\n");
+  return !terminated;
+}
+
+// Loading many sources: every source is parsed on a pool thread into a queue
+// of its own, and the calling thread, as the only writer, turns the parsed
+// triples into nodes and inserts them. Sources go in one savepoint each so
+// that a failing source leaves no trace, and several sources share one
+// transaction until enough triples have been written.
+
+static const size_t LOAD_BATCH_TRIPLES = 2048;   // triples per parsed batch
+static const size_t LOAD_QUEUE_BATCHES = 8;      // batches a parser may run ahead
+static const size_t LOAD_COMMIT_TRIPLES = 100000; // triples per transaction
+
+void DB::loadMany(const std::vector<Node> &sources, std::vector<LoadResult> &results,
+                  bool append, bool verbose) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "loadMany");
+  verbose = verbose | PIGLET_DEBUG | verboseOps();
+  size_t n = sources.size();
+  LoadResult none = { false, false, "" };
+  results.assign(n, none);
+  if (n == 0)
+    return;
+  std::vector<Validators> known(n);
+  for (size_t i = 0; i < n; i++)
+    db(tempsql(SQL::query("SELECT created, etag FROM source WHERE src=%d LIMIT 1",
+                          id(sources[i]))),
+       ERR_SRC_FIND, &known[i], (SQL::Callback)validatorsCallback);
+  ThreadPool *pool = loaders();
+  LoadQueue queue(n, LOAD_QUEUE_BATCHES);
+  std::vector<Task *> tasks;
+  for (size_t i = 0; i < n; i++) {
+    SourceParse *task = new SourceParse(NULL, sources[i], known[i], &queue, i,
+                                        LOAD_BATCH_TRIPLES, _fetchCache);
+    task->setParser(createParser(sources[i], task, false));
+    tasks.push_back(task);
+  }
+  ThreadPool::Batch *parsing = pool->submit(tasks);
+  int depth = transactionDepth();
+  try {
+    transaction();
+    {
+      BulkScope bulk(this);
+      size_t written = 0;
+      for (size_t done = 0; done < n; done++) {
+        size_t i = queue.next();
+        if (verbose) {
+          TemporaryString uri(info(sources[i]));
+          std::cerr << "Loading: " << uri.string() << "...";
+          std::cerr.flush();
+        }
+        written += loadParsed(queue, i, sources[i], append, results[i]);
+        if (verbose)
+          std::cerr << (!results[i].ok ? "failed\n"
+                        : results[i].unchanged ? "no reload needed\n" : "done\n");
+        if ((written >= LOAD_COMMIT_TRIPLES) && (done + 1 < n)) {
+          commit();
+          transaction();
+          written = 0;
+        }
+      }
+      bulk.end();
+    }
+    commit();
+  }
+  catch (Condition &c) {
+    queue.abort();
+    try { pool->wait(parsing); } catch (Condition &) {}
+    for (size_t i = 0; i < n; i++)
+      delete tasks[i];
+    if (transactionDepth() > depth)
+      rollback();
+    throw;
+  }
+  pool->wait(parsing);
+  for (size_t i = 0; i < n; i++)
+    delete tasks[i];
+}
+
+// Writes one parsed source; returns the number of triples written
+
+size_t DB::loadParsed(LoadQueue &queue, size_t i, Node source, bool append,
+                      LoadResult &result) MAYFAIL
+{
+  ParsedBatch *batch = queue.pop(i);
+  if ((batch == NULL) && (queue.outcome(i) != LoadQueue::PARSED)) {
+    result.ok = (queue.outcome(i) == LoadQueue::UNCHANGED);
+    result.unchanged = result.ok;
+    result.error = queue.error(i);
+    return 0;
+  }
+  BNodeMap bnodes; // labels are local to the source
+  size_t written = 0;
+  savepoint("piglet_load");
+  try {
+    if (!append)
+      delSourceTriples(source);
+    for (; batch != NULL; batch = queue.pop(i)) {
+      for (size_t j = 0; j < batch->namespaces.size(); j++) {
+        const std::string &prefix = batch->namespaces[j].first;
+        addNamespace(prefix.empty() ? NULL : prefix.c_str(), batch->namespaces[j].second.c_str());
+      }
+      for (size_t j = 0; j < batch->triples.size(); j++) {
+        const ParsedTriple &parsed = batch->triples[j];
+        Triple t(encode(parsed.s, bnodes), encode(parsed.p, bnodes), encode(parsed.o, bnodes));
+        addToGraph(&t, parsed.g.str.empty() ? source : encode(parsed.g, bnodes), source);
+      }
+      written += batch->triples.size();
+      delete batch;
+    }
+    if (queue.outcome(i) == LoadQueue::PARSED) {
+      markLoaded(source, queue.validators(i).modified, queue.validators(i).etag);
+      releaseSavepoint("piglet_load");
+      result.ok = true;
+      return written;
+    }
+    result.error = queue.error(i);
+  }
+  catch (Condition &c) {
+    delete batch;
+    while ((batch = queue.pop(i)) != NULL)
+      delete batch;
+    result.error = c.message();
+  }
+  rollbackToSavepoint("piglet_load");
+  releaseSavepoint("piglet_load");
+  return 0;
+}
+
+Node DB::encode(const ParsedTerm &term, BNodeMap &bnodes) MAYFAIL
+{
+  switch (term.kind) {
+    case ParsedTerm::RESOURCE:
+      return node(term.str.c_str());
+    case ParsedTerm::BNODE: {
+      BNodeMap::iterator i = bnodes.find(term.str);
+      if (i != bnodes.end())
+        return Node(i->second);
+      Node n = node(NULL);
+      bnodes[term.str] = id(n);
+      return n;
+    }
+    default:
+      return literal(term.str.c_str(),
+                     term.datatype.empty() ? NULL_NODE : node(term.datatype.c_str()),
+                     term.lang.empty() ? NULL : term.lang.c_str());
+  }
+}
+
+// Reloading a source fetches it as a load does, parses it into a set of node
+// IDs, and then applies only the difference to the triples it had, merging
+// the two sorted sets, so an unchanged triple is never touched and readers
+// never see the source emptied. The named graphs of its content are diffed
+// along with it, and those it no longer has are emptied. Blank nodes get new
+// IDs in every parse, so triples that have them are always replaced.
+
+class ReloadSink : public ParsedTripleSink {
+public:
+  ReloadSink(DB *db, Node source) : _db(db), _source(source) {}
+  virtual void triple(const ParsedTriple &t) MAYFAIL;
+  virtual void addNamespace(const char *prefix, const char *uri) MAYFAIL
+    { _db->addNamespace(prefix, uri); }
+  std::vector<Quad> quads; // (s, p, o, src), src the source or a graph
+  std::set<int> graphs; // of the content, other than the source
+private:
+  DB *_db;
+  Node _source;
+  BNodeMap _bnodes;
+};
+
+void ReloadSink::triple(const ParsedTriple &t) MAYFAIL
+{
+  Quad q = { { id(_db->encode(t.s, _bnodes)), id(_db->encode(t.p, _bnodes)),
+               id(_db->encode(t.o, _bnodes)), id(_source) } };
+  if (!t.g.str.empty()) {
+    q.k[3] = id(_db->encode(t.g, _bnodes));
+    if (q.k[3] != id(_source))
+      graphs.insert(q.k[3]);
+  }
+  quads.push_back(q);
+}
+
+static bool sameQuad(const Quad &a, const Quad &b)
+{
+  return !QuadLess()(a, b) && !QuadLess()(b, a);
+}
+
+bool DB::reload(Node source, ReloadResult &result, bool verbose) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "reload");
+  result.unchanged = false;
+  result.added = result.removed = result.kept = 0;
+  TemporaryString uri(info(source));
+  verbose = verbose | PIGLET_DEBUG | verboseOps();
+  if (verbose) {
+    std::cerr << "Reloading: " << uri.string() << "...";
+    std::cerr.flush();
+  }
+  Validators known;
+  db(tempsql(SQL::query("SELECT created, etag FROM source WHERE src=%d LIMIT 1", id(source))),
+     ERR_SRC_FIND, &known, (SQL::Callback)validatorsCallback);
+  ReloadSink sink(this, source);
+  Parser *parser = createParser(source, &sink);
+  Fetch fetch(uri.string(), _fetchCache);
+  LoadStart start(this, source, false);
+  Fetch::Outcome outcome;
+  bool terminated;
+  try {
+    outcome = fetch.run(parser, source, known, &start);
+    terminated = (outcome == Fetch::FAILED) || parser->terminated();
+    if (outcome == Fetch::NOT_MODIFIED) {
+      result.unchanged = true;
+      result.kept = count(NULL_NODE, NULL_NODE, NULL_NODE, source, false);
+    }
+    else if (terminated) {
+      if (start.begun)
+        rollback();
+    }
+    else {
+      QuadLess less;
+      std::vector<Quad> &now = sink.quads;
+      std::sort(now.begin(), now.end(), less);
+      now.erase(std::unique(now.begin(), now.end(), sameQuad), now.end());
+      std::vector<Quad> before;
+      Nodes graphs(this);
+      sourceGraphs(source, &graphs);
+      graphs.push_back(source);
+      for (Nodes::iterator g = graphs.begin(); g != graphs.end(); g++) {
+        collectQuads(*g, before);
+        deleteTriples(NULL_NODE, NULL_NODE, NULL_NODE, *g, true);
+      }
+      std::sort(before.begin(), before.end(), less);
+      size_t i = 0, j = 0;
+      while ((i < before.size()) || (j < now.size())) {
+        if ((j == now.size()) || ((i < before.size()) && less(before[i], now[j]))) {
+          const Quad &q = before[i++];
+          deleteTriples(Node(q.k[0]), Node(q.k[1]), Node(q.k[2]), Node(q.k[3]), false);
+          result.removed++;
+        }
+        else if ((i == before.size()) || less(now[j], before[i])) {
+          const Quad &q = now[j++];
+          insertTriple(Node(q.k[0]), Node(q.k[1]), Node(q.k[2]), Node(q.k[3]), false);
+          result.added++;
+        }
+        else {
+          i++, j++;
+          result.kept++;
+        }
+      }
+      db(tempsql(SQL::query("DELETE FROM graph WHERE src=%d;", id(source))), ERR_SRC_GRAPH);
+      for (std::set<int>::iterator g = sink.graphs.begin(); g != sink.graphs.end(); g++)
+        recordGraph(source, Node(*g));
+      markLoaded(source, fetch.validators().modified, fetch.validators().etag);
+      commit();
+    }
+  }
+  catch (Condition &c) {
+    if (start.begun)
+      rollback();
+    delete parser;
+    if (verbose) std::cerr << "failed\n";
+    throw;
+  }
+  delete parser;
+  if (verbose) {
+    if (terminated)
+      std::cerr << "failed\n";
+    else if (result.unchanged)
+      std::cerr << "no reload needed\n";
+    else
+      std::cerr << "+" << result.added << " -" << result.removed << "\n";
+  }
+  return !terminated;
+}
+
+// Sources are checked without the lock held, so that the store stays usable
+// while the checks wait on the network; only those found stale are loaded,
+// in parallel, replacing their triples
+
+void DB::refresh(const std::vector<Node> &sources, RefreshResult *result, bool verbose) MAYFAIL
 {
-  return new RaptorParser(this);
+  verbose = verbose | PIGLET_DEBUG | verboseOps();
+  std::vector<Freshness> checks(sources.size());
+  {
+    mutex::MutexLock lock(&_mutex, "refresh");
+    for (size_t i = 0; i < sources.size(); i++) {
+      TemporaryString uri(info(sources[i]));
+      checks[i].url = uri.string();
+      db(tempsql(SQL::query("SELECT created, etag FROM source WHERE src=%d LIMIT 1",
+                            id(sources[i]))),
+         ERR_SRC_FIND, &checks[i].known, (SQL::Callback)validatorsCallback);
+    }
+  }
+  checkFreshness(checks);
+  RefreshResult counts = { (long)sources.size(), 0, 0, 0 };
+  std::vector<Node> stale;
+  for (size_t i = 0; i < checks.size(); i++) {
+    if (checks[i].state == Freshness::STALE) {
+      stale.push_back(sources[i]);
+      counts.stale++;
+    }
+    else if (checks[i].state == Freshness::UNKNOWN) {
+      counts.unknown++;
+      if (verbose)
+        std::cerr << "Checking: " << checks[i].url << "..." << checks[i].error << "\n";
+    }
+  }
+  if (!stale.empty()) {
+    std::vector<LoadResult> results;
+    loadMany(stale, results, false, verbose);
+    for (size_t i = 0; i < results.size(); i++)
+      if (results[i].ok && !results[i].unchanged)
+        counts.loaded++;
+  }
+  if (result)
+    *result = counts;
+}
+
+void DB::refreshAll(RefreshResult *result, bool verbose) MAYFAIL
+{
+  std::vector<Node> sources;
+  {
+    mutex::MutexLock lock(&_mutex, "refresh");
+    Nodes *all = allSources();
+    sources.assign(all->begin(), all->end());
+    delete all;
+  }
+  refresh(sources, result, verbose);
+}
+
+// A pipelined load runs parsing, encoding and inserting on threads of their
+// own, connected by bounded queues. The encoding stage resolves terms to node
+// IDs without the write connection: it remembers the nodes of this load in a
+// cache of its own, looks up others through a reader connection (which sees
+// what was committed before the load began), and takes IDs for new nodes from
+// the sequence, which the writer leases for the transaction before the stage
+// starts. Once the cache may have forgotten nodes, new ones are marked
+// unsettled, and the writer looks them up again before adding them. Without
+// reader connections the writer encodes as well.
+
+static const size_t PIPELINE_BATCHES = 4; // batches buffered between stages
+
+class EncodeStage : public Task {
+public:
+  EncodeStage(DB *db, LoadQueue *in, LoadQueue *out)
+    : _db(db), _in(in), _out(out), _nodes(db->_nodeCache.capacity()), _remembered(0) {}
+  void run(void) MAYFAIL;
+  void encode(ParsedBatch *batch) MAYFAIL;
+  void settle(ParsedBatch *batch) MAYFAIL;
+private:
+  int node(const ParsedTerm &term, ParsedBatch *batch) MAYFAIL;
+  int remember(const std::string &key, bool literal, const ParsedTerm &term, int datatype,
+               ParsedBatch *batch) MAYFAIL;
+  void cache(const std::string &key, int id);
+  bool forgetting(void) const { return _remembered >= (_nodes.capacity() + 1) / 2; }
+  DB *_db;
+  LoadQueue *_in;
+  LoadQueue *_out;
+  NodeCache _nodes;
+  size_t _remembered;
+  BNodeMap _unsettled; // new nodes of the batch being encoded
+  BNodeMap _bnodes;
+};
+
+void EncodeStage::run(void) MAYFAIL
+{
+  try {
+    ParsedBatch *batch;
+    while ((batch = _in->pop(0)) != NULL) {
+      encode(batch);
+      if (!_out->push(0, batch))
+        _in->abort();
+    }
+    _out->finish(0, _in->outcome(0), _in->validators(0), _in->error(0));
+  }
+  catch (Condition &c) {
+    _in->abort();
+    _out->finish(0, LoadQueue::FAILED, Validators(), c.message());
+  }
+}
+
+void EncodeStage::encode(ParsedBatch *batch) MAYFAIL
+{
+  _unsettled.clear();
+  batch->encoded.resize(batch->triples.size());
+  for (size_t i = 0; i < batch->triples.size(); i++) {
+    const ParsedTriple &t = batch->triples[i];
+    EncodedTriple &e = batch->encoded[i];
+    e.s = node(t.s, batch);
+    e.p = node(t.p, batch);
+    e.o = node(t.o, batch);
+    e.g = t.g.str.empty() ? 0 : node(t.g, batch);
+  }
+  batch->triples.clear();
+  std::sort(batch->encoded.begin(), batch->encoded.end());
+}
+
+int EncodeStage::node(const ParsedTerm &term, ParsedBatch *batch) MAYFAIL
+{
+  switch (term.kind) {
+    case ParsedTerm::BNODE: {
+      BNodeMap::iterator i = _bnodes.find(term.str);
+      if (i != _bnodes.end())
+        return i->second;
+      NewNode n = { _db->newNodeID(), true, "", 0, "", false };
+      batch->nodes.push_back(n);
+      return _bnodes[term.str] = n.id;
+    }
+    case ParsedTerm::RESOURCE:
+      return remember(NodeCache::uriKey(term.str.c_str()), false, term, 0, batch);
+    default: {
+      int dt = 0;
+      if (!term.datatype.empty()) {
+        ParsedTerm datatype = { ParsedTerm::RESOURCE, term.datatype, "", "" };
+        dt = node(datatype, batch);
+      }
+      const char *lang = (dt || term.lang.empty()) ? NULL : term.lang.c_str();
+      return remember(NodeCache::literalKey(term.str.c_str(), dt, lang), true, term, dt, batch);
+    }
+  }
+}
+
+int EncodeStage::remember(const std::string &key, bool literal, const ParsedTerm &term,
+                          int datatype, ParsedBatch *batch) MAYFAIL
+{
+  int id = _nodes.find(key);
+  if (id != 0)
+    return id;
+  BNodeMap::iterator i = _unsettled.find(key);
+  if (i != _unsettled.end())
+    return i->second;
+  const char *str = term.str.c_str();
+  if (!literal)
+    id = _db->findNode(SQL_NODE_FIND, "SELECT id FROM node WHERE str = ?1 AND id > 0", str);
+  else
+    id = _db->findLiteral(str, Node(datatype),
+                          (datatype || term.lang.empty()) ? NULL : term.lang.c_str());
+  if (id != 0) {
+    cache(key, id);
+    return id;
+  }
+  id = _db->allocateID(key, literal);
+  NewNode n = { id, false, term.str, datatype, datatype ? "" : term.lang, forgetting() };
+  batch->nodes.push_back(n);
+  if (n.unsettled)
+    _unsettled[key] = id; // the writer caches it once settled
+  else
+    cache(key, id);
+  return id;
+}
+
+// Nothing is evicted before the cache has turned over twice, i.e. before it
+// has taken in half its capacity
+
+void EncodeStage::cache(const std::string &key, int id)
+{
+  _nodes.insert(key, id);
+  _remembered++;
+}
+
+static int settled(const std::tr1::unordered_map<int, int> &moved, int id)
+{
+  std::tr1::unordered_map<int, int>::const_iterator i = moved.find(id);
+  return (i != moved.end()) ? i->second : id;
+}
+
+// Runs on the writer: unsettled nodes that an earlier batch of this load has
+// added already are dropped, and the triples moved over to the existing IDs
+
+void EncodeStage::settle(ParsedBatch *batch) MAYFAIL
+{
+  std::tr1::unordered_map<int, int> moved;
+  size_t kept = 0;
+  for (size_t i = 0; i < batch->nodes.size(); i++) {
+    NewNode n = batch->nodes[i];
+    if (n.unsettled) {
+      n.datatype = settled(moved, n.datatype);
+      const char *str = n.str.c_str();
+      const char *lang = n.lang.empty() ? NULL : n.lang.c_str();
+      bool literal = (n.id < 0);
+      int id = literal
+        ? _db->findLiteral(str, Node(n.datatype), lang)
+        : _db->findNode(SQL_NODE_FIND, "SELECT id FROM node WHERE str = ?1 AND id > 0", str);
+      std::string key(literal ? NodeCache::literalKey(str, n.datatype, lang)
+                              : NodeCache::uriKey(str));
+      _nodes.insert(key, id ? id : n.id);
+      if (id != 0) {
+        moved[n.id] = id;
+        continue;
+      }
+    }
+    batch->nodes[kept++] = n;
+  }
+  batch->nodes.resize(kept);
+  if (moved.empty())
+    return;
+  for (size_t i = 0; i < batch->encoded.size(); i++) {
+    EncodedTriple &e = batch->encoded[i];
+    e.s = settled(moved, e.s);
+    e.p = settled(moved, e.p);
+    e.o = settled(moved, e.o);
+    e.g = settled(moved, e.g);
+  }
+  std::sort(batch->encoded.begin(), batch->encoded.end());
+}
+
+// Returns false if the source could not be parsed; the caller holds the lock
+// and has the transaction open
+
+bool DB::loadPipelined(Node source, const char *script, char *argv[], LoadJob *job) MAYFAIL
+{
+  LoadQueue parsed(1, PIPELINE_BATCHES), encoded(1, PIPELINE_BATCHES);
+  SourceParse parse(NULL, source, Validators(), &parsed, 0, LOAD_BATCH_TRIPLES);
+  parse.setParser(createParser(source, &parse));
+  parse.force(script, argv);
+  EncodeStage encode(this, &parsed, &encoded);
+  // nodes written earlier in an enclosing transaction are only visible to the
+  // writer connection, so a nested load encodes on this thread
+  bool threaded = (_readers != NULL) && (transactionDepth() == 1);
+  if (threaded && !_sequence.leased())
+    reserveIDs(0); // the encoding stage must not need the write connection for IDs
+  std::vector<Task *> tasks;
+  tasks.push_back(&parse);
+  if (threaded)
+    tasks.push_back(&encode);
+  ThreadPool stages((int)tasks.size());
+  if (stages.size() < (int)tasks.size())
+    FAIL("Unable to start load pipeline");
+  LoadQueue &input = threaded ? encoded : parsed;
+  ThreadPool::Batch *running = stages.submit(tasks);
+  bool cancelled = false;
+  try {
+    ParsedBatch *batch;
+    while (!cancelled && ((batch = input.pop(0)) != NULL)) {
+      if (!threaded)
+        encode.encode(batch);
+      encode.settle(batch);
+      long inserted = insertEncoded(batch, source);
+      long parsed = (long)batch->encoded.size();
+      delete batch;
+      cancelled = (job && !job->triples(parsed, inserted));
+    }
+  }
+  catch (Condition &c) {
+    parsed.abort();
+    encoded.abort();
+    try { stages.wait(running); } catch (Condition &) {}
+    throw;
+  }
+  if (cancelled) {
+    parsed.abort();
+    encoded.abort();
+  }
+  stages.wait(running);
+  if (cancelled)
+    return false;
+  else if (input.outcome(0) == LoadQueue::PARSED)
+    return true;
+  else if (parsed.outcome(0) == LoadQueue::PARSED)
+    FAIL(input.error(0)); // encoding failed
+  else
+    return false;
+}
+
+long DB::insertEncoded(ParsedBatch *batch, Node source) MAYFAIL
+{
+  long inserted = 0;
+  for (size_t i = 0; i < batch->namespaces.size(); i++) {
+    const std::string &prefix = batch->namespaces[i].first;
+    addNamespace(prefix.empty() ? NULL : prefix.c_str(), batch->namespaces[i].second.c_str());
+  }
+  for (size_t i = 0; i < batch->nodes.size(); i++) {
+    const NewNode &n = batch->nodes[i];
+    insertNode(n.id, n.bnode ? NULL : n.str.c_str(), Node(n.datatype),
+               n.lang.empty() ? NULL : n.lang.c_str());
+  }
+  for (size_t i = 0; i < batch->encoded.size(); i++) {
+    const EncodedTriple &e = batch->encoded[i];
+    Triple t(Node(e.s), Node(e.p), Node(e.o));
+    if (addToGraph(&t, e.g ? Node(e.g) : source, source) != NULL)
+      inserted++;
+  }
+  return inserted;
+}
+
+// One parsing thread per processor, less one for the writer
+
+ThreadPool *DB::loaders(void) MAYFAIL
+{
+  if (_loaders == NULL) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    _loaders = new ThreadPool((cpus > 2) ? (int)cpus - 1 : 1);
+    if (_loaders->size() == 0)
+      FAIL("Unable to start loader threads");
+  }
+  return _loaders;
+}
+
+// N-Triples and N-Quads, told apart from RDF/XML by the extension of the
+// source URI, are parsed without Raptor; unless the load already runs on a
+// pool thread, one file is then tokenized on every processor but the writer's
+
+Parser *DB::createParser(Node source, ParsedTripleSink *sink, bool split) MAYFAIL
+{
+  TemporaryString uri(info(source));
+  NTriplesParser::Syntax syntax = NTriplesParser::syntax(uri.string());
+  if (syntax == NTriplesParser::NONE)
+    return new RaptorParser(this, sink);
+  long cpus = split ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+  return new NTriplesParser(this, syntax, sink, (cpus > 1) ? (int)cpus - 1 : 0);
 }
 
 bool DB::delSource(Node source) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
-  db("BEGIN TRANSACTION;");
+  mutex::MutexLock lock(&_mutex, "delSource");
+  transaction();
   try {
     delSourceTriples(source);
-    db(tempsql(SQL::query("DELETE FROM source WHERE src=%d; COMMIT;", id(source))), ERR_SRC_DEL);
+    db(tempsql(SQL::query("DELETE FROM source WHERE src=%d;", id(source))), ERR_SRC_DEL);
+    commit();
     return true;
   }
   catch (Condition &c) {
-    db("ROLLBACK;");
+    rollback();
     throw c;
   }
 }
 
+// The named graphs of N-Quads content go with the source that had them, each
+// as a whole: a graph that several sources add to is emptied by any of them
+
 bool DB::delSourceTriples(Node source) MAYFAIL
 {
-  mutex::MutexLock lock(&_mutex);
-  return (db(tempsql(makeWildcardQuery("DELETE FROM cache.triple",
-                                       NULL_NODE, NULL_NODE, NULL_NODE, id(source))),
-             ERR_SRC_DEL) &&
-          db(tempsql(makeWildcardQuery("DELETE FROM triple",
-                                       NULL_NODE, NULL_NODE, NULL_NODE, id(source))),
-             ERR_SRC_DEL));
+  mutex::MutexLock lock(&_mutex, "delSourceTriples");
+  Nodes graphs(this);
+  sourceGraphs(source, &graphs);
+  for (Nodes::iterator i = graphs.begin(); i != graphs.end(); i++) {
+    deleteTriples(NULL_NODE, NULL_NODE, NULL_NODE, *i, true);
+    deleteTriples(NULL_NODE, NULL_NODE, NULL_NODE, *i, false);
+  }
+  db(tempsql(SQL::query("DELETE FROM graph WHERE src=%d;", id(source))), ERR_SRC_GRAPH);
+  _recordedGraph = std::make_pair(0, 0);
+  deleteTriples(NULL_NODE, NULL_NODE, NULL_NODE, source, true);
+  deleteTriples(NULL_NODE, NULL_NODE, NULL_NODE, source, false);
+  return true;
+}
+
+// Adds a triple that the content of source puts in a graph, recording the
+// graph as one of the source's if it is not the source itself; content comes
+// grouped by graph, so only a change of graph costs a statement
+
+Triple *DB::addToGraph(Triple *t, Node graph, Node source) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "addToGraph");
+  if ((graph != source) && (std::make_pair(id(source), id(graph)) != _recordedGraph))
+    recordGraph(source, graph);
+  return add(t, graph);
+}
+
+void DB::recordGraph(Node source, Node graph) MAYFAIL
+{
+  db(tempsql(SQL::query("INSERT OR IGNORE INTO graph (src, graph) VALUES (%d, %d);",
+                        id(source), id(graph))), ERR_SRC_GRAPH);
+  _recordedGraph = std::make_pair(id(source), id(graph));
+}
+
+void DB::sourceGraphs(Node source, Nodes *graphs) MAYFAIL
+{
+  db(tempsql(SQL::query("SELECT graph FROM graph WHERE src=%d;", id(source))),
+     ERR_SRC_GRAPH, graphs, (SQL::Callback)nodeCallback);
 }
 
 Nodes *DB::allSources(void) MAYFAIL
@@ -803,19 +2062,450 @@ bool DB::db(const char *query, const char *msg, void *arg, SQL::Callback callbac
   }
 }
 
+// Bulk mode may be nested, and is a mode of the calling thread: only its own
+// add() calls skip the probes for duplicates. Dropped indexes are shared,
+// though, and rebuilt by the outermost endBulk() of the last thread to end.
+
+void DB::beginBulk(bool dropIndexes) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "beginBulk");
+  if (dropIndexes && !_indexesDropped) {
+    db((char *)SQL_DROP_INDEXES, ERR_BULK);
+    _indexesDropped = true;
+  }
+  pthread_t self = pthread_self();
+  for (size_t i = 0; i < _bulk.size(); i++)
+    if (pthread_equal(_bulk[i].first, self)) {
+      _bulk[i].second++;
+      return;
+    }
+  _bulk.push_back(std::make_pair(self, 1));
+}
+
+void DB::endBulk(void) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "endBulk");
+  pthread_t self = pthread_self();
+  for (size_t i = 0; i < _bulk.size(); i++)
+    if (pthread_equal(_bulk[i].first, self)) {
+      if (--_bulk[i].second == 0)
+        _bulk.erase(_bulk.begin() + i);
+      break;
+    }
+  if (_bulk.empty() && _indexesDropped) {
+    db((char *)SQL_CREATE_INDEXES, ERR_BULK);
+    _indexesDropped = false;
+  }
+}
+
+bool DB::inBulk(void)
+{
+  mutex::MutexLock lock(&_mutex, "inBulk");
+  pthread_t self = pthread_self();
+  for (size_t i = 0; i < _bulk.size(); i++)
+    if (pthread_equal(_bulk[i].first, self))
+      return true;
+  return false;
+}
+
+// Snapshots hold triples in the same ID space as the store, so a snapshot
+// can be attached to the store it was compiled from, or to one that has not
+// allocated any of its IDs yet; a sample of the dictionary is checked against
+// the node table to catch other combinations
+
+void DB::compileSnapshot(const char *path, Node source) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "compileSnapshot");
+  std::vector<Quad> quads;
+  collectQuads(source, quads);
+  std::vector<int> used;
+  for (std::vector<Quad>::const_iterator i = quads.begin(); i != quads.end(); i++)
+    used.insert(used.end(), i->k, i->k + 4);
+  std::sort(used.begin(), used.end());
+  used.erase(std::unique(used.begin(), used.end()), used.end());
+  std::vector<SnapshotNode> nodes;
+  std::vector<int> datatypes;
+  SQL::Statement q(_db, "SELECT str, datatype, lang FROM node WHERE id = ?1 AND str IS NOT NULL");
+  for (size_t i = 0; i < used.size(); i++) {
+    q.bind(1, used[i]);
+    if (q.step(ERR_NODE_DETAILS)) {
+      SnapshotNode node;
+      node.id = used[i];
+      node.key = isLiteral(node.id)
+        ? NodeCache::literalKey(q.text(0), q.column(1), q.isNull(2) ? NULL : q.text(2))
+        : NodeCache::uriKey(q.text(0));
+      nodes.push_back(node);
+      if (isLiteral(node.id) && (q.column(1) != 0) &&
+          !std::binary_search(used.begin(), used.end(), q.column(1)))
+        datatypes.push_back(q.column(1));
+    }
+    q.reset();
+  }
+  std::sort(datatypes.begin(), datatypes.end());
+  datatypes.erase(std::unique(datatypes.begin(), datatypes.end()), datatypes.end());
+  for (size_t i = 0; i < datatypes.size(); i++) {
+    q.bind(1, datatypes[i]);
+    if (q.step(ERR_NODE_DETAILS)) {
+      SnapshotNode node;
+      node.id = datatypes[i];
+      node.key = NodeCache::uriKey(q.text(0));
+      nodes.push_back(node);
+    }
+    q.reset();
+  }
+  Snapshot::write(path, nodes, quads);
+}
+
+void DB::collectQuads(Node source, std::vector<Quad> &quads) MAYFAIL
+{
+  SQL::Statement q(_db, (source != NULL_NODE)
+                        ? "SELECT s, p, o, src FROM triple WHERE src = ?1"
+                        : "SELECT s, p, o, src FROM triple");
+  if (source != NULL_NODE)
+    q.bind(1, id(source));
+  while (q.step(ERR_TRIPLE_FIND)) {
+    Quad quad = { { q.column(0), q.column(1), q.column(2), q.column(3) } };
+    quads.push_back(quad);
+  }
+}
+
+void DB::attachSnapshot(const char *path) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "attachSnapshot");
+  Snapshot *snapshot = new Snapshot(path);
+  size_t n = snapshot->nodes();
+  for (size_t i = 0; (n > 0) && (i < 16); i++) {
+    int nodeID = snapshot->nodeID(i * (n - 1) / 15);
+    Node datatype = NULL_NODE;
+    char language[256];
+    language[0] = '\0';
+    TemporaryString str(info(Node(nodeID), &datatype, language));
+    std::string key;
+    snapshot->key(nodeID, key);
+    if ((str.string() != NULL) &&
+        (key != (isLiteral(nodeID)
+                 ? NodeCache::literalKey(str.string(), id(datatype), language[0] ? language : NULL)
+                 : NodeCache::uriKey(str.string())))) {
+      delete snapshot;
+      FAIL(ERR_SNAPSHOT_MISMATCH);
+    }
+  }
+  _sequence.raise(snapshot->high(), snapshot->low());
+  updateSequence(0);
+  mutex::MutexLock snapshotsLock(&_snapshotsMutex);
+  _snapshots.push_back(snapshot);
+}
+
+size_t DB::matchSnapshots(Node s, Node p, Node o, Node source, std::vector<Quad> *out, size_t limit)
+{
+  mutex::MutexLock lock(&_snapshotsMutex);
+  size_t count = 0;
+  for (size_t i = 0; i < _snapshots.size(); i++) {
+    count += _snapshots[i]->match(id(s), id(p), id(o), id(source), out,
+                                  limit ? limit - count : 0);
+    if (limit && (count >= limit))
+      break;
+  }
+  return count;
+}
+
+// The snapshot quads matching a pattern that the database does not store
+// itself, so that a snapshot attached to the store it was compiled from is
+// not counted twice; the probes are skipped when no stored triple matched
+
+size_t DB::countSnapshotOnly(Node s, Node p, Node o, Node source, bool probe) MAYFAIL
+{
+  bool single;
+  {
+    mutex::MutexLock lock(&_snapshotsMutex);
+    single = (_snapshots.size() < 2);
+  }
+  if (single && !probe)
+    return matchSnapshots(s, p, o, source, NULL);
+  std::vector<Quad> rows;
+  matchSnapshots(s, p, o, source, &rows);
+  std::sort(rows.begin(), rows.end(), QuadLess(4));
+  size_t count = 0;
+  for (size_t i = 0; i < rows.size(); i++)
+    if (((i == 0) || QuadLess(4)(rows[i - 1], rows[i])) && !(probe && storedQuad(rows[i])))
+      count++;
+  return count;
+}
+
+int DB::findInSnapshots(const std::string &key)
+{
+  mutex::MutexLock lock(&_snapshotsMutex);
+  for (size_t i = 0; i < _snapshots.size(); i++) {
+    int id = _snapshots[i]->find(key);
+    if (id != 0)
+      return id;
+  }
+  return 0;
+}
+
+// Transactions nest: within a transaction of its own, a thread starting
+// another one gets a savepoint instead, which commit() releases and
+// rollback() rolls back to, leaving the enclosing transaction open. Thus
+// load() and the like can be batched into a transaction of the caller, and a
+// failing one is rolled back alone.
+
+static std::string nestedName(int depth)
+{
+  char name[32];
+  snprintf(name, sizeof(name), "piglet_nested_%d", depth);
+  return name;
+}
+
 bool DB::transaction(void) MAYFAIL
 {
-  return db("BEGIN", ERR_TRANSACTION);
+  mutex::MutexLock lock(&_mutex, "transaction");
+  if (transactionDepth() > 0) {
+    savepoint(nestedName(_transactionDepth).c_str());
+    _transactionDepth++;
+    return true;
+  }
+  bool ok = db("BEGIN", ERR_TRANSACTION);
+  _transactionOwner = pthread_self();
+  _transactionOpen = true;
+  _transactionDepth = 1;
+  return ok;
 }
 
 bool DB::commit(void) MAYFAIL
 {
-  return db("COMMIT", ERR_TRANSACTION);
+  mutex::MutexLock lock(&_mutex, "commit");
+  if (transactionDepth() > 1) {
+    _transactionDepth--;
+    releaseSavepoint(nestedName(_transactionDepth).c_str());
+    return true;
+  }
+  if (_sequence.leased())
+    updateSequence(0);
+  bool ok;
+  try {
+    ok = db("COMMIT", ERR_TRANSACTION);
+  }
+  catch (Condition &c) {
+    // a COMMIT that fails may leave the transaction open (when busy, say)
+    if (_db->inTransaction())
+      _db->exec("ROLLBACK", NULL, NULL, NULL);
+    if (_transactionOpen)
+      rolledBack();
+    throw;
+  }
+  committed();
+  return ok;
 }
 
 bool DB::rollback(void) MAYFAIL
 {
-  return db("ROLLBACK", ERR_TRANSACTION);
+  mutex::MutexLock lock(&_mutex, "rollback");
+  if (transactionDepth() > 1) {
+    _transactionDepth--;
+    std::string name(nestedName(_transactionDepth));
+    rollbackToSavepoint(name.c_str());
+    releaseSavepoint(name.c_str());
+    return true;
+  }
+  _transactionOpen = false;
+  _transactionDepth = 0;
+  bool ok = db("ROLLBACK", ERR_TRANSACTION);
+  transactionEnded();
+  return ok;
+}
+
+// Threads waiting for another's transaction to end (see GroupCommit) are
+// woken once its COMMIT or ROLLBACK has returned. They should take the count
+// of ends before checking for an open transaction, so as not to miss one.
+
+void DB::transactionEnded(void)
+{
+  pthread_mutex_lock(&_endLock);
+  _ends++;
+  pthread_cond_broadcast(&_ended);
+  pthread_mutex_unlock(&_endLock);
+}
+
+unsigned long DB::transactionEnds(void)
+{
+  pthread_mutex_lock(&_endLock);
+  unsigned long ends = _ends;
+  pthread_mutex_unlock(&_endLock);
+  return ends;
+}
+
+void DB::waitTransactionEnd(unsigned long ends)
+{
+  pthread_mutex_lock(&_endLock);
+  while (_ends == ends)
+    pthread_cond_wait(&_ended, &_endLock);
+  pthread_mutex_unlock(&_endLock);
+}
+
+// Nesting level of the calling thread's own transaction, 0 if it has none
+
+int DB::transactionDepth(void)
+{
+  return (_transactionOpen && pthread_equal(_transactionOwner, pthread_self()))
+    ? _transactionDepth : 0;
+}
+
+// Savepoints nest within a transaction (SQLite starts one if none is open);
+// rolling back to a savepoint does not end the transaction, so the commit and
+// rollback hooks are not called and the node caches are rolled back here
+
+void DB::savepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "savepoint");
+  db(tempsql(SQL::query("SAVEPOINT %Q", name)), ERR_TRANSACTION);
+}
+
+void DB::releaseSavepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "releaseSavepoint");
+  db(tempsql(SQL::query("RELEASE %Q", name)), ERR_TRANSACTION);
+  if (!_db->inTransaction()) // it was the outermost, and began the transaction
+    committed();
+}
+
+void DB::rollbackToSavepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "rollbackToSavepoint");
+  db(tempsql(SQL::query("ROLLBACK TO %Q", name)), ERR_TRANSACTION);
+  _nodeCache.rollback();
+  _bnodeCache.rollback();
+  _recordedGraph = std::make_pair(0, 0);
+}
+
+// Reads go to a connection of the calling thread's own, and see the last
+// committed state of the store, except when the thread is itself writing
+// (holds the lock, or has an explicit transaction open) and must see its own
+// changes
+
+SQL::Database *DB::reader(void) MAYFAIL
+{
+  return ((_readers == NULL) || writing()) ? _db : _readers->connection();
+}
+
+bool DB::writing(void)
+{
+  return (_mutex.held() ||
+          (_transactionOpen && pthread_equal(_transactionOwner, pthread_self())));
+}
+
+// Group commit applies to add() and del() called by threads that are not
+// writing already; it should be set up before such calls start
+
+void DB::setGroupCommit(size_t maxBatch, long maxDelay) MAYFAIL
+{
+  GroupCommit *stopped = NULL;
+  {
+    mutex::MutexLock lock(&_mutex, "setGroupCommit");
+    if (maxBatch == 0) {
+      stopped = _groupCommit;
+      _groupCommit = NULL;
+    }
+    else if (_groupCommit)
+      _groupCommit->configure(maxBatch, maxDelay);
+    else
+      _groupCommit = new GroupCommit(this, maxBatch, maxDelay);
+  }
+  delete stopped; // outside the lock, as its writer needs it to finish
+}
+
+// Stops the threads working on the database in the background. Subclass
+// destructors call this first, since those threads use what they destroy.
+
+void DB::shutdown(void) MAYFAIL
+{
+  setRefresh(0);
+  setGroupCommit(0);
+}
+
+GroupCommitStats DB::groupCommitStats(void)
+{
+  if (_groupCommit)
+    return _groupCommit->stats();
+  GroupCommitStats none = { 0, 0, 0, 0, 0 };
+  return none;
+}
+
+void DB::setRefresh(long interval) MAYFAIL
+{
+  RefreshScheduler *stopped = NULL;
+  {
+    mutex::MutexLock lock(&_mutex, "setRefresh");
+    if (interval <= 0) {
+      stopped = _refresher;
+      _refresher = NULL;
+    }
+    else if (_refresher)
+      _refresher->configure(interval);
+    else
+      _refresher = new RefreshScheduler(this, interval);
+  }
+  delete stopped; // outside the lock, as a refresh under way needs it to finish
+}
+
+void DB::setRefreshInterval(Node source, long interval) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "setRefresh");
+  if (_refresher == NULL)
+    FAIL("Periodic refresh is not on");
+  _refresher->setInterval(source, interval);
+}
+
+RefreshStats DB::refreshStats(void)
+{
+  if (_refresher)
+    return _refresher->stats();
+  RefreshStats none = { 0, 0, 0, 0, 0 };
+  return none;
+}
+
+void DB::setNodeCacheSize(size_t entries)
+{
+  mutex::MutexLock lock(&_mutex, "setNodeCacheSize");
+  _nodeCache.setCapacity(entries);
+  _bnodeCache.setCapacity(entries);
+}
+
+// Called by SQLite whenever a transaction is rolled back, whether asked to or
+// on an error; commits are noticed by commit() instead, once COMMIT has
+// returned, since the commit hook runs before the transaction is durable
+
+void DB::rollbackHook(void *db)
+{
+  ((DB *)db)->rolledBack();
+}
+
+// Called once a transaction has committed; nodes created inside it are only
+// trusted from then on
+
+void DB::committed(void)
+{
+  _transactionOpen = false;
+  _transactionDepth = 0;
+  _nodeCache.commit();
+  _bnodeCache.commit();
+  _sequence.endLease();
+  transactionEnded();
+}
+
+// Called from within SQLite when a transaction is rolled back; must not use
+// the database connection. Rollbacks SQLite makes on its own are only seen
+// here, so waiting threads are woken as well; the thread rolling back holds
+// the lock until the statement returns, and they check again under it.
+
+void DB::rolledBack(void)
+{
+  _transactionOpen = false;
+  _transactionDepth = 0;
+  _nodeCache.rollback();
+  _bnodeCache.rollback();
+  _recordedGraph = std::make_pair(0, 0);
+  _sequence.endLease();
+  transactionEnded();
 }
 
 }
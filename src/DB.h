@@ -49,6 +49,12 @@
 #include "Action.h"
 #include "Parser.h"
 #include "Mutex.h"
+#include "NodeCache.h"
+#include "NodeSequence.h"
+#include "TripleCursor.h"
+#include "Snapshot.h"
+#include "GroupCommit.h"
+#include "RefreshScheduler.h"
 
 namespace Piglet {
 
@@ -61,12 +67,48 @@ const Node Node_rdfs_Class = 4;
 const Node Node_rdfs_subClassOf = 5;
 
 class Parser;
+class ParsedTripleSink;
+struct ParsedTerm;
+class ThreadPool;
+class LoadQueue;
+class LoadJob;
+class LoadProgress;
+class ChunkedLoad;
+struct ParsedBatch;
+
+// Outcome of loading one source with DB::loadMany()
+
+struct LoadResult {
+  bool ok;        // loaded, or needed no reloading
+  bool unchanged; // not modified since it was last loaded
+  std::string error;
+};
+
+// Outcome of DB::reload(): how the triples of the source (and of the named
+// graphs of its content) changed
+
+struct ReloadResult {
+  bool unchanged; // not modified since it was last loaded, so not parsed
+  long added;
+  long removed;
+  long kept;
+};
+
+// Outcome of DB::refresh()
+
+struct RefreshResult {
+  long checked; // sources looked at
+  long stale;   // changed since they were last loaded
+  long loaded;  // of those, loaded again
+  long unknown; // could not be checked, and were left alone
+};
 
 class DB {
 public:
   DB(char* name, bool verbose = false) MAYFAIL;
-  ~DB(void) MAYFAIL;
-  static DB *current(void) { return DB::_current; }
+  virtual ~DB(void) MAYFAIL;
+  static DB *current(void);
+  static void setCurrent(DB *db);
   SQL::Database *getDatabase() { return _db; }
   inline bool& verboseOps(void) { return _verboseOps; }
   virtual Node node(const char *uri, bool bnode = false) MAYFAIL;
@@ -74,6 +116,7 @@ public:
   virtual bool augmentLiteral(Node literal, Node datatype) MAYFAIL;
   virtual Triples *query(Node subject, Node predicate, Node object, Node source=NULL_NODE) MAYFAIL;
   virtual bool query(Node subject, Node predicate, Node object, Node source, TripleAction *action) MAYFAIL;
+  virtual TripleCursor *cursor(Node subject, Node predicate, Node object, Node source = NULL_NODE) MAYFAIL;
   virtual bool queryUsingSQL(char *condition, GenericAction *action) MAYFAIL;
   virtual bool exists(Node s, Node p, Node o, Node source = NULL_NODE, bool temporary = false) MAYFAIL;
   virtual Triple *add(Triple *triple, Node source = NULL_NODE, bool temporary = false) MAYFAIL;
@@ -85,6 +128,15 @@ public:
   virtual bool load(Node source, unsigned char* content, bool verbose) MAYFAIL;
   virtual bool load(Node source, bool append = false, bool verbose = false, char *path = NULL, char *argv[] = NULL) MAYFAIL;
   virtual bool load(const char *source, bool append = false, bool verbose = false, char *path = NULL, char *argv[] = NULL) MAYFAIL;
+  virtual LoadJob *loadAsync(Node source, bool append = false, bool verbose = false,
+                             LoadProgress *progress = NULL) MAYFAIL;
+  virtual ChunkedLoad *loadBegin(Node source, bool verbose = false) MAYFAIL;
+  virtual void loadMany(const std::vector<Node> &sources, std::vector<LoadResult> &results,
+                        bool append = false, bool verbose = false) MAYFAIL;
+  virtual bool reload(Node source, ReloadResult &result, bool verbose = false) MAYFAIL;
+  virtual void refresh(const std::vector<Node> &sources, RefreshResult *result = NULL,
+                       bool verbose = false) MAYFAIL;
+  void refreshAll(RefreshResult *result = NULL, bool verbose = false) MAYFAIL;
   virtual bool addNamespace(const char *prefix, const char *uri) MAYFAIL;
   virtual void delNamespace(const char *prefix) MAYFAIL;
   virtual char *toString(const Node n) MAYFAIL;
@@ -101,23 +153,135 @@ public:
   virtual bool transaction(void) MAYFAIL;
   virtual bool commit(void) MAYFAIL;
   virtual bool rollback(void) MAYFAIL;
+  virtual void beginBulk(bool dropIndexes = false) MAYFAIL;
+  virtual void endBulk(void) MAYFAIL;
+  bool inBulk(void); // of the calling thread
+  const NodeCache &nodeCache(void) const { return _nodeCache; }
+  const NodeCache &bnodeCache(void) const { return _bnodeCache; }
+  void setNodeCacheSize(size_t entries);
+  void setGroupCommit(size_t maxBatch, long maxDelay = 0) MAYFAIL; // maxBatch 0 disables
+  GroupCommitStats groupCommitStats(void);
+  void setRefresh(long interval) MAYFAIL; // seconds, 0 disables
+  void setRefreshInterval(Node source, long interval) MAYFAIL; // negative for the default
+  RefreshStats refreshStats(void);
+  void setLockStats(bool enabled) MAYFAIL { _mutex.instrument(enabled); }
+  void lockStats(std::vector<mutex::LockStats> &stats) MAYFAIL { _mutex.stats(stats); }
+  void setPipelinedLoad(bool pipelined) { _pipelinedLoad = pipelined; }
+  bool pipelinedLoad(void) const { return _pipelinedLoad; }
+  void setFetchCache(const char *dir) { _fetchCache = dir ? dir : ""; } // NULL stops caching
+  const std::string &fetchCache(void) const { return _fetchCache; }
+  void compileSnapshot(const char *path, Node source = NULL_NODE) MAYFAIL;
+  void attachSnapshot(const char *path) MAYFAIL;
+  int reserveNodeIDs(int n) MAYFAIL;
+  int reserveLiteralIDs(int n) MAYFAIL;
 protected:
+  mutex::Mutex _mutex;
+  void shutdown(void) MAYFAIL; // stops group commit and refreshes
   void addQuick(Node subject, Node predicate, Node object) MAYFAIL;
   inline bool isLiteral(Node n) { return n < NULL_NODE; }
   bool db(const char *query, const char *msg = NULL,
           void *arg = NULL, SQL::Callback callback = NULL) MAYFAIL;
-  char* makeWildcardQuery(const char *prefix, Node s, Node p, Node o, Node source);
+  std::string makeWildcardQuery(const char *prefix, int mask);
+  static const char *orderBy(QuadOrder order);
+  void snapshotCursors(Node s, Node p, Node o, Node source, std::vector<TripleCursor *> &cursors);
+  TripleCursor *tripleCursor(Node s, Node p, Node o, Node source, bool sorted) MAYFAIL;
+  void bindWildcard(SQL::Statement *statement, Node s, Node p, Node o, Node source);
+  int findNode(int key, const char *sql, const char *str, int datatype = 0,
+               const char *lang = NULL) MAYFAIL;
+  int findLiteral(const char *str, Node datatype, const char *lang) MAYFAIL;
+  void insertNode(int id, const char *str, Node datatype, const char *lang) MAYFAIL;
+  char *findString(int key, const char *sql, const char *arg) MAYFAIL;
+  char *expandQName(const char *prefix, const char *name) MAYFAIL;
+  virtual bool insertTriple(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual void deleteTriples(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual void committed(void);
+  virtual void rolledBack(void);
+  virtual void savepoint(const char *name) MAYFAIL;
+  virtual void releaseSavepoint(const char *name) MAYFAIL;
+  virtual void rollbackToSavepoint(const char *name) MAYFAIL;
+  virtual bool stored(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual bool storedQuad(const Quad &quad) MAYFAIL;
+  int storedCount(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  size_t matchSnapshots(Node s, Node p, Node o, Node source, std::vector<Quad> *out,
+                        size_t limit = 0);
+  size_t countSnapshotOnly(Node s, Node p, Node o, Node source, bool probe) MAYFAIL;
+  int findInSnapshots(const std::string &key);
+  int allocateID(const std::string &key, bool literal) MAYFAIL;
+  SQL::Database *reader(void) MAYFAIL;
+  bool writing(void);
+  int transactionDepth(void);
+  virtual void collectQuads(Node source, std::vector<Quad> &quads) MAYFAIL;
+  virtual void markLoaded(Node source, time_t filetime,
+                          const std::string &etag = std::string()) MAYFAIL;
+  Triple *addToGraph(Triple *t, Node graph, Node source) MAYFAIL;
+  void recordGraph(Node source, Node graph) MAYFAIL;
+  void sourceGraphs(Node source, Nodes *graphs) MAYFAIL;
+  bool indexesDropped(void) const { return _indexesDropped; }
+  void reserveIDs(int n) MAYFAIL;
+  void updateSequence(int block) MAYFAIL;
   int newNodeID(void) MAYFAIL;
   int newLiteralID(void) MAYFAIL;
-  Parser *createParser(void);
+  Parser *createParser(Node source, ParsedTripleSink *sink = NULL, bool split = true) MAYFAIL;
+  Node encode(const ParsedTerm &term, BNodeMap &bnodes) MAYFAIL;
   virtual char *prefix2namespace(const char *prefix) MAYFAIL;
   virtual char *namespace2prefix(const char *uri) MAYFAIL;
 private:
-  mutex::Mutex _mutex;
   const char *_name;
   SQL::Database *_db;
-  static DB *_current;
+  SQL::ReaderPool *_readers;
+  pthread_t _transactionOwner;
+  bool _transactionOpen;
+  int _transactionDepth;
+  pthread_mutex_t _endLock;
+  pthread_cond_t _ended;
+  unsigned long _ends; // transactions ended so far
   bool _verboseOps;
+  NodeCache _nodeCache;
+  NodeCache _bnodeCache;
+  NodeSequence _sequence;
+  std::vector<std::pair<pthread_t, int> > _bulk; // nesting of each thread in bulk mode
+  bool _indexesDropped;
+  std::pair<int, int> _recordedGraph; // (source, graph) last recorded by addToGraph()
+  std::vector<Snapshot *> _snapshots;
+  mutex::Mutex _snapshotsMutex;
+  bool _pipelinedLoad;
+  std::string _fetchCache;
+  GroupCommit *_groupCommit;
+  RefreshScheduler *_refresher;
+  ThreadPool *_loaders;
+  ThreadPool *loaders(void) MAYFAIL;
+  size_t loadParsed(LoadQueue &queue, size_t i, Node source, bool append,
+                    LoadResult &result) MAYFAIL;
+  bool loadSource(Node source, bool append, bool verbose, char *script, char *argv[],
+                  LoadJob *job) MAYFAIL;
+  bool loadFetched(Node source, const char *uri, bool append, bool verbose, LoadJob *job) MAYFAIL;
+  bool loadPipelined(Node source, const char *script, char *argv[], LoadJob *job) MAYFAIL;
+  long insertEncoded(ParsedBatch *batch, Node source) MAYFAIL;
+  bool loadChunk(ChunkedLoad *load, const unsigned char *data, size_t length) MAYFAIL;
+  bool loadEnd(ChunkedLoad *load, bool keep) MAYFAIL;
+  void transactionEnded(void);
+  unsigned long transactionEnds(void);
+  void waitTransactionEnd(unsigned long ends);
+  friend class EncodeStage;
+  friend class ReloadSink;
+  friend class NTriplesParser;
+  friend class LoadJob;
+  friend class ChunkedLoad;
+  friend class GroupCommit;
+  friend class RefreshScheduler;
+  static void rollbackHook(void *db);
+};
+
+// Makes a database the current one of the calling thread while in scope.
+// The current database is what Node(const char *) and the printing of nodes
+// and triples refer to; a DB is made current by its constructor
+
+class CurrentDB {
+public:
+  CurrentDB(DB *db) : _previous(DB::current()) { DB::setCurrent(db); }
+  ~CurrentDB(void) { DB::setCurrent(_previous); }
+private:
+  DB *_previous;
 };
 
 }
@@ -0,0 +1,393 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  Fetch.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Fetch.h"
+#include "Parser.h"
+#include "Curl.h"
+
+namespace Piglet {
+
+// Cached content is named by a hash of its URL; the URL is kept with the
+// validators, so that a collision only costs a fetch
+
+static std::string cacheName(const std::string &url)
+{
+  uint64_t h = 14695981039346656037ULL; // FNV-1a
+  for (size_t i = 0; i < url.size(); i++)
+    h = (h ^ (unsigned char)url[i]) * 1099511628211ULL;
+  char name[17];
+  snprintf(name, sizeof(name), "%016llx", (unsigned long long)h);
+  return name;
+}
+
+// Makes a request conditional on validators; returns the header list to free
+// once the request has been made
+
+static libcurl::curl_slist *askIfChanged(libcurl::Curl &curl, const Validators &known)
+{
+  libcurl::curl_slist *headers = NULL;
+  if (!known.etag.empty()) {
+    headers = libcurl::curl_slist_append(headers, ("If-None-Match: " + known.etag).c_str());
+    curl.setOption(libcurl::CURLOPT_HTTPHEADER, headers);
+  }
+  if (known.modified != 0) {
+    curl.setOption(libcurl::CURLOPT_TIMECONDITION, (void *)(long)libcurl::CURL_TIMECOND_IFMODSINCE);
+    curl.setOption(libcurl::CURLOPT_TIMEVALUE, (void *)(long)known.modified);
+  }
+  return headers;
+}
+
+// Only ETag is looked at in response headers; a redirect starts them over
+
+static void scanHeader(const char *data, size_t length, std::string &etag)
+{
+  if ((length >= 5) && (strncmp(data, "HTTP/", 5) == 0))
+    etag.clear();
+  else if ((length > 5) && (strncasecmp(data, "ETag:", 5) == 0)) {
+    size_t begin = 5, end = length;
+    while ((begin < end) && ((data[begin] == ' ') || (data[begin] == '\t')))
+      begin++;
+    while ((end > begin) && ((data[end - 1] == '\r') || (data[end - 1] == '\n') ||
+                             (data[end - 1] == ' ')))
+      end--;
+    etag.assign(data + begin, end - begin);
+  }
+}
+
+Fetch::Fetch(const std::string &url, const std::string &cacheDir)
+  : _url(url), _parser(NULL), _source(NULL_NODE), _start(NULL), _started(false), _cache(NULL)
+{
+  if (!cacheDir.empty() && (url.compare(0, 5, "file:") != 0))
+    _cachePath = cacheDir + "/" + cacheName(url);
+}
+
+Fetch::~Fetch(void)
+{
+  closeCache(false);
+}
+
+Fetch::Outcome Fetch::run(Parser *parser, Node source, const Validators &known,
+                          FetchStart *start) MAYFAIL
+{
+  _parser = parser;
+  _source = source;
+  _start = start;
+  _started = false;
+  _etag.clear();
+  _failure.clear();
+  _validators = Validators();
+  _error.clear();
+  Validators ask(known);
+  bool cached = ((known.modified == 0) && known.etag.empty() && readCached(ask));
+  libcurl::Curl curl;
+  curl.setURL(_url.c_str());
+  curl.setOption(libcurl::CURLOPT_FOLLOWLOCATION, (void *)1);
+  curl.setOption(libcurl::CURLOPT_FAILONERROR, (void *)1);
+  curl.setOption(libcurl::CURLOPT_NOSIGNAL, (void *)1);
+  curl.setOption(libcurl::CURLOPT_FILETIME, (void *)1);
+  curl.setOption(libcurl::CURLOPT_ACCEPT_ENCODING, (void *)"gzip");
+  curl.setOption(libcurl::CURLOPT_WRITEFUNCTION, (void *)received);
+  curl.setOption(libcurl::CURLOPT_WRITEDATA, this);
+  curl.setOption(libcurl::CURLOPT_HEADERFUNCTION, (void *)header);
+  curl.setOption(libcurl::CURLOPT_HEADERDATA, this);
+  libcurl::curl_slist *headers = askIfChanged(curl, ask);
+  bool ok = curl.perform();
+  libcurl::curl_slist_free_all(headers);
+  if (!_failure.empty()) {
+    closeCache(false);
+    FAIL(_failure);
+  }
+  long code = 0, unmet = 0;
+  curl.getInfo(libcurl::CURLINFO_RESPONSE_CODE, &code);
+  curl.getInfo(libcurl::CURLINFO_CONDITION_UNMET, &unmet);
+  if (!ok) {
+    closeCache(false);
+    _error = "Unable to retrieve " + _url;
+    if (!parser->terminated())
+      parser->terminate(_error.c_str());
+    if (_started)
+      parser->parseEnd();
+    return FAILED;
+  }
+  if ((code == 304) || (unmet != 0)) {
+    _validators = ask;
+    if (!cached)
+      return NOT_MODIFIED;
+    FILE *stream = fopen(_cachePath.c_str(), "r");
+    if (stream == NULL) {
+      _error = "Unable to read the cached copy of " + _url;
+      parser->terminate(_error.c_str());
+      return FAILED;
+    }
+    try {
+      if (_start)
+        (*_start)();
+      parser->parse(source, stream);
+    }
+    catch (Condition &c) {
+      fclose(stream);
+      throw;
+    }
+    fclose(stream);
+    return FETCHED;
+  }
+  if (!_started) // an empty body
+    begin();
+  time_t modified = 0;
+  if (curl.getInfo(libcurl::CURLINFO_FILETIME, &modified) && (modified > 0))
+    _validators.modified = modified;
+  _validators.etag = _etag;
+  closeCache(parser->parseEnd());
+  return FETCHED;
+}
+
+void Fetch::begin(void) MAYFAIL
+{
+  _started = true;
+  if (_start)
+    (*_start)();
+  _parser->parseBegin(_source);
+  if (!_cachePath.empty())
+    _cache = fopen((_cachePath + ".part").c_str(), "w"); // not caching if this fails
+}
+
+size_t Fetch::received(char *data, size_t size, size_t n, void *arg)
+{
+  Fetch *fetch = (Fetch *)arg;
+  try {
+    if (!fetch->_started)
+      fetch->begin();
+    if (fetch->_cache && (fwrite(data, size, n, fetch->_cache) != n)) {
+      fclose(fetch->_cache);
+      fetch->_cache = NULL;
+      unlink((fetch->_cachePath + ".part").c_str());
+    }
+    return fetch->_parser->parseChunk((const unsigned char *)data, size * n) ? size * n : 0;
+  }
+  catch (Condition &c) {
+    fetch->_failure = c.message();
+    return 0;
+  }
+}
+
+size_t Fetch::header(char *data, size_t size, size_t n, void *arg)
+{
+  scanHeader(data, size * n, ((Fetch *)arg)->_etag);
+  return size * n;
+}
+
+// The .meta file next to cached content holds its URL, Last-Modified and ETag
+// on lines of their own
+
+bool Fetch::readCached(Validators &cached)
+{
+  if (_cachePath.empty() || (access(_cachePath.c_str(), R_OK) != 0))
+    return false;
+  FILE *meta = fopen((_cachePath + ".meta").c_str(), "r");
+  if (meta == NULL)
+    return false;
+  char line[4096];
+  std::string fields[3];
+  for (int i = 0; (i < 3) && fgets(line, sizeof(line), meta); i++) {
+    fields[i] = line;
+    if (!fields[i].empty() && (fields[i][fields[i].size() - 1] == '\n'))
+      fields[i].erase(fields[i].size() - 1);
+  }
+  fclose(meta);
+  if (fields[0] != _url)
+    return false;
+  cached.modified = (time_t)atol(fields[1].c_str());
+  cached.etag = fields[2];
+  return (cached.modified != 0) || !cached.etag.empty();
+}
+
+void Fetch::closeCache(bool keep)
+{
+  if (_cache == NULL)
+    return;
+  fclose(_cache);
+  _cache = NULL;
+  std::string part(_cachePath + ".part");
+  if (keep && ((_validators.modified != 0) || !_validators.etag.empty())) {
+    std::string meta(_cachePath + ".meta");
+    FILE *f = fopen((meta + ".part").c_str(), "w");
+    if (f != NULL) {
+      fprintf(f, "%s\n%ld\n%s\n", _url.c_str(), (long)_validators.modified,
+              _validators.etag.c_str());
+      if ((fclose(f) == 0) && (rename(part.c_str(), _cachePath.c_str()) == 0) &&
+          (rename((meta + ".part").c_str(), meta.c_str()) == 0))
+        return;
+      unlink((meta + ".part").c_str());
+    }
+  }
+  unlink(part.c_str());
+}
+
+// One HEAD request of checkFreshness()
+
+struct Probe {
+  libcurl::Curl curl;
+  Freshness *check;
+  libcurl::curl_slist *headers;
+  std::string etag;
+};
+
+static size_t probeHeader(char *data, size_t size, size_t n, void *probe)
+{
+  scanHeader(data, size * n, ((Probe *)probe)->etag);
+  return size * n;
+}
+
+// A changed ETag settles it; without one, a later Last-Modified does, and a
+// server that offers neither is taken to have changed its content
+
+static void judge(Probe *probe, libcurl::CURLcode code) MAYFAIL
+{
+  Freshness &check = *probe->check;
+  if (code != libcurl::CURLE_OK) {
+    check.state = Freshness::UNKNOWN;
+    check.error = libcurl::curl_easy_strerror(code);
+    return;
+  }
+  long response = 0, unmet = 0;
+  time_t modified = 0;
+  probe->curl.getInfo(libcurl::CURLINFO_RESPONSE_CODE, &response);
+  probe->curl.getInfo(libcurl::CURLINFO_CONDITION_UNMET, &unmet);
+  probe->curl.getInfo(libcurl::CURLINFO_FILETIME, &modified);
+  check.current.modified = (modified > 0) ? modified : 0;
+  check.current.etag = probe->etag;
+  if ((response == 304) || (unmet != 0)) {
+    check.current = check.known;
+    check.state = Freshness::FRESH;
+  }
+  else if (!check.current.etag.empty())
+    check.state = (check.current.etag == check.known.etag) ? Freshness::FRESH : Freshness::STALE;
+  else if (check.current.modified != 0)
+    check.state = (check.current.modified > check.known.modified) ? Freshness::STALE : Freshness::FRESH;
+  else
+    check.state = Freshness::STALE;
+}
+
+static void release(libcurl::CURLM *multi, std::vector<Probe *> &probes)
+{
+  for (size_t i = 0; i < probes.size(); i++) {
+    libcurl::curl_multi_remove_handle(multi, probes[i]->curl.handle());
+    libcurl::curl_slist_free_all(probes[i]->headers);
+    delete probes[i];
+  }
+  libcurl::curl_multi_cleanup(multi);
+}
+
+void checkFreshness(std::vector<Freshness> &checks, long timeout, long maxPerHost) MAYFAIL
+{
+  using namespace libcurl;
+  CURLM *multi = curl_multi_init();
+  if (multi == NULL)
+    FAIL("Unable to check sources");
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxPerHost);
+  curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+  std::vector<Probe *> probes;
+  try {
+    for (size_t i = 0; i < checks.size(); i++) {
+      Freshness &check = checks[i];
+      check.state = Freshness::UNKNOWN;
+      check.current = Validators();
+      check.error.clear();
+      if (check.url.compare(0, 7, "file://") == 0) {
+        struct stat st;
+        if (stat(check.url.c_str() + 7, &st) != 0)
+          check.error = "Unable to find " + check.url;
+        else {
+          check.current.modified = st.st_mtime;
+          check.state = (st.st_mtime > check.known.modified) ? Freshness::STALE : Freshness::FRESH;
+        }
+        continue;
+      }
+      Probe *probe = new Probe;
+      probe->check = &check;
+      probe->headers = NULL;
+      probes.push_back(probe);
+      Curl &curl = probe->curl;
+      curl.setURL(check.url.c_str());
+      curl.setOption(CURLOPT_NOBODY, (void *)1);
+      curl.setOption(CURLOPT_FILETIME, (void *)1);
+      curl.setOption(CURLOPT_FOLLOWLOCATION, (void *)1);
+      curl.setOption(CURLOPT_FAILONERROR, (void *)1);
+      curl.setOption(CURLOPT_NOSIGNAL, (void *)1);
+      curl.setOption(CURLOPT_CONNECTTIMEOUT, (void *)3); // 3 seconds
+      curl.setOption(CURLOPT_TIMEOUT, (void *)timeout);
+      curl.setOption(CURLOPT_HEADERFUNCTION, (void *)probeHeader);
+      curl.setOption(CURLOPT_HEADERDATA, probe);
+      curl.setOption(CURLOPT_PRIVATE, probe);
+      probe->headers = askIfChanged(curl, check.known);
+      curl_multi_add_handle(multi, curl.handle());
+    }
+    int running = (int)probes.size();
+    while (running > 0) {
+      if (curl_multi_perform(multi, &running) != CURLM_OK)
+        break;
+      if (running > 0)
+        curl_multi_wait(multi, NULL, 0, 1000, NULL);
+      CURLMsg *message;
+      int left;
+      while ((message = curl_multi_info_read(multi, &left)) != NULL) {
+        if (message->msg == CURLMSG_DONE) {
+          char *probe = NULL;
+          curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &probe);
+          judge((Probe *)probe, message->data.result);
+        }
+      }
+    }
+  }
+  catch (Condition &c) {
+    release(multi, probes);
+    throw;
+  }
+  release(multi, probes);
+}
+
+}
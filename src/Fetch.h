@@ -0,0 +1,133 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  Fetch.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <time.h>
+#include "Node.h"
+#include "Condition.h"
+
+namespace Piglet {
+
+class Parser;
+
+// What the content of a source was last fetched with; sent back to ask
+// whether it has changed since
+
+struct Validators {
+  time_t modified;  // Last-Modified, or the mtime of a file: (0 if unknown)
+  std::string etag; // empty if none
+  Validators(void) : modified(0) {}
+};
+
+// Called on the fetching thread once the content is known to have changed,
+// just before any of it is parsed
+
+class FetchStart {
+public:
+  virtual ~FetchStart(void) {}
+  virtual void operator()(void) MAYFAIL = 0;
+};
+
+// One conditional GET of a source, with the body (gzip-compressed or not)
+// streamed into a parser as it arrives; if the content has not changed since
+// the validators given, nothing is parsed at all. With a cache directory,
+// content fetched over the network is also written there under a name derived
+// from its URL, along with its validators, so that a store that has never
+// loaded the URL can still ask whether the cached copy is current, and parse
+// that instead of fetching the content again.
+
+class Fetch {
+public:
+  enum Outcome { FETCHED, NOT_MODIFIED, FAILED };
+  Fetch(const std::string &url, const std::string &cacheDir = std::string());
+  ~Fetch(void);
+  // FETCHED means the content was handed to the parser, which may still
+  // have terminated; FAILED that it could not be retrieved
+  Outcome run(Parser *parser, Node source, const Validators &known,
+              FetchStart *start = NULL) MAYFAIL;
+  const Validators &validators(void) const { return _validators; } // of the content
+  const std::string &error(void) const { return _error; }
+private:
+  static size_t received(char *data, size_t size, size_t n, void *fetch);
+  static size_t header(char *data, size_t size, size_t n, void *fetch);
+  void begin(void) MAYFAIL;
+  bool readCached(Validators &cached);
+  void closeCache(bool keep);
+  std::string _url;
+  std::string _cachePath; // empty if not caching
+  Parser *_parser;
+  Node _source;
+  FetchStart *_start;
+  bool _started;
+  FILE *_cache;
+  std::string _etag;
+  std::string _failure; // a condition raised while curl was calling us
+  Validators _validators;
+  std::string _error;
+};
+
+// Whether a source has changed since it was last loaded, as found by
+// checkFreshness(); a source that cannot be checked is UNKNOWN, with the
+// reason in error
+
+struct Freshness {
+  enum State { UNKNOWN, FRESH, STALE };
+  std::string url;
+  Validators known;   // what it was last loaded with
+  State state;
+  Validators current; // of the content now, as far as told
+  std::string error;
+  Freshness(void) : state(UNKNOWN) {}
+};
+
+// Checks many sources at once: file: URLs by looking at the file, others with
+// conditional HEAD requests running concurrently on one curl multi handle,
+// which reuses connections to a host and opens at most maxPerHost of them.
+// No check takes longer than timeout seconds, so a slow host only holds up
+// its own sources.
+
+void checkFreshness(std::vector<Freshness> &checks, long timeout = 10,
+                    long maxPerHost = 4) MAYFAIL;
+
+}
@@ -0,0 +1,229 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  GroupCommit.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <sys/time.h>
+#include "GroupCommit.h"
+#include "DB.h"
+
+namespace Piglet {
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
+GroupCommit::GroupCommit(DB *db, size_t maxBatch, long maxDelay) MAYFAIL
+  : _db(db), _maxBatch(maxBatch ? maxBatch : 1), _maxDelay(maxDelay),
+    _committing(0), _waiting(0), _stop(false)
+{
+  GroupCommitStats zero = { 0, 0, 0, 0, 0 };
+  _stats = zero;
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_work, NULL);
+  pthread_cond_init(&_released, NULL);
+  if (pthread_create(&_thread, NULL, GroupCommit::writer, this) != 0) {
+    pthread_cond_destroy(&_released);
+    pthread_cond_destroy(&_work);
+    pthread_mutex_destroy(&_lock);
+    FAIL("Unable to start group commit writer");
+  }
+}
+
+GroupCommit::~GroupCommit(void)
+{
+  pthread_mutex_lock(&_lock);
+  _stop = true;
+  pthread_cond_broadcast(&_work);
+  pthread_mutex_unlock(&_lock);
+  pthread_join(_thread, NULL);
+  pthread_cond_destroy(&_released);
+  pthread_cond_destroy(&_work);
+  pthread_mutex_destroy(&_lock);
+}
+
+bool GroupCommit::write(bool add, Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  Request r;
+  r.add = add;
+  r.s = s; r.p = p; r.o = o; r.source = source;
+  r.temporary = temporary;
+  r.queued = now();
+  r.done = r.result = r.failed = false;
+  pthread_mutex_lock(&_lock);
+  _queue.push_back(&r);
+  pthread_cond_signal(&_work);
+  while (!r.done)
+    pthread_cond_wait(&_released, &_lock);
+  pthread_mutex_unlock(&_lock);
+  if (r.failed)
+    FAIL(r.error);
+  return r.result;
+}
+
+void GroupCommit::configure(size_t maxBatch, long maxDelay)
+{
+  pthread_mutex_lock(&_lock);
+  _maxBatch = maxBatch ? maxBatch : 1;
+  _maxDelay = maxDelay;
+  pthread_cond_signal(&_work);
+  pthread_mutex_unlock(&_lock);
+}
+
+GroupCommitStats GroupCommit::stats(void)
+{
+  pthread_mutex_lock(&_lock);
+  GroupCommitStats stats = _stats;
+  if (stats.batches)
+    stats.commitTime = _committing / stats.batches;
+  if (stats.writes)
+    stats.waitTime = _waiting / stats.writes;
+  pthread_mutex_unlock(&_lock);
+  return stats;
+}
+
+void *GroupCommit::writer(void *committer)
+{
+  GroupCommit *gc = (GroupCommit *)committer;
+  CurrentDB use(gc->_db);
+  std::vector<Request *> batch;
+  pthread_mutex_lock(&gc->_lock);
+  for (;;) {
+    while (gc->_queue.empty() && !gc->_stop)
+      pthread_cond_wait(&gc->_work, &gc->_lock);
+    if (gc->_queue.empty())
+      break; // stopping, and nothing left to do
+    gc->collect(batch);
+    pthread_mutex_unlock(&gc->_lock);
+    double start = now();
+    gc->apply(batch);
+    double end = now();
+    pthread_mutex_lock(&gc->_lock);
+    gc->_stats.batches++;
+    gc->_stats.writes += batch.size();
+    if (batch.size() > gc->_stats.largest)
+      gc->_stats.largest = batch.size();
+    gc->_committing += end - start;
+    for (size_t i = 0; i < batch.size(); i++) {
+      gc->_waiting += end - batch[i]->queued;
+      batch[i]->done = true;
+    }
+    pthread_cond_broadcast(&gc->_released);
+  }
+  pthread_mutex_unlock(&gc->_lock);
+  return NULL;
+}
+
+// Called with the lock held; waits for the batch to fill up or for its
+// delay to pass, then takes it off the queue
+
+void GroupCommit::collect(std::vector<Request *> &batch)
+{
+  double deadline = _queue.front()->queued + _maxDelay;
+  while ((_queue.size() < _maxBatch) && !_stop && (_maxDelay > 0)) {
+    double left = deadline - now();
+    if (left <= 0)
+      break;
+    struct timespec until;
+    until.tv_sec = (time_t)(deadline / 1000000.0);
+    until.tv_nsec = (long)(deadline - until.tv_sec * 1000000.0) * 1000;
+    pthread_cond_timedwait(&_work, &_lock, &until);
+  }
+  batch.clear();
+  while (!_queue.empty() && (batch.size() < _maxBatch)) {
+    batch.push_back(_queue.front());
+    _queue.pop_front();
+  }
+}
+
+// Should another thread have a transaction open, the batch waits for it to
+// end rather than going into it, since the callers would be released before
+// knowing whether it commits
+
+void GroupCommit::apply(std::vector<Request *> &batch)
+{
+  for (;;) {
+    unsigned long ends = _db->transactionEnds();
+    {
+      mutex::MutexLock lock(&_db->_mutex, "groupCommit");
+      if (!_db->getDatabase()->inTransaction()) {
+        commit(batch);
+        return;
+      }
+    }
+    _db->waitTransactionEnd(ends);
+  }
+}
+
+// Called with the database lock held and no transaction open
+
+void GroupCommit::commit(std::vector<Request *> &batch)
+{
+  try {
+    _db->transaction();
+    for (size_t i = 0; i < batch.size(); i++)
+      perform(batch[i]);
+    _db->commit();
+    return;
+  }
+  catch (Condition &c) {
+    if (_db->getDatabase()->inTransaction())
+      _db->rollback();
+  }
+  for (size_t i = 0; i < batch.size(); i++) {
+    try {
+      perform(batch[i]);
+    }
+    catch (Condition &c) {
+      batch[i]->failed = true;
+      batch[i]->error = c.message();
+    }
+  }
+}
+
+void GroupCommit::perform(Request *r) MAYFAIL
+{
+  Triple t(r->s, r->p, r->o);
+  r->result = ((r->add ? _db->add(&t, r->source, r->temporary)
+                       : _db->del(&t, r->source, r->temporary)) != NULL);
+}
+
+}
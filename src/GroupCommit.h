@@ -0,0 +1,109 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  GroupCommit.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "Node.h"
+#include "Condition.h"
+
+namespace Piglet {
+
+class DB;
+
+struct GroupCommitStats {
+  unsigned long batches; // transactions committed by the writer
+  unsigned long writes;  // add() and del() calls applied
+  unsigned long largest; // most calls applied in one transaction
+  double commitTime;     // average time to apply and commit a batch, in microseconds
+  double waitTime;       // average time a caller waited for its batch, in microseconds
+};
+
+// Group commit: add() and del() calls made outside of a transaction are
+// queued, and a writer thread applies them in batches, one transaction per
+// batch, releasing the callers once their batch has been committed. A batch
+// closes when it has maxBatch calls in it, or maxDelay microseconds after its
+// first call was queued (with no delay, a batch is whatever was queued while
+// the previous one was being committed). Should a batch fail, its calls are
+// applied one at a time, so that only the failing ones report the failure.
+// A batch never goes into a transaction another thread has open; it waits
+// for that transaction to end first.
+
+class GroupCommit {
+public:
+  GroupCommit(DB *db, size_t maxBatch, long maxDelay) MAYFAIL;
+  ~GroupCommit(void); // applies whatever is still queued
+  bool write(bool add, Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  void configure(size_t maxBatch, long maxDelay);
+  GroupCommitStats stats(void);
+private:
+  struct Request {
+    bool add;
+    Node s, p, o, source;
+    bool temporary;
+    double queued;
+    bool done;
+    bool result;
+    bool failed;
+    std::string error;
+  };
+  static void *writer(void *committer);
+  void collect(std::vector<Request *> &batch);
+  void apply(std::vector<Request *> &batch);
+  void commit(std::vector<Request *> &batch);
+  void perform(Request *request) MAYFAIL;
+  DB *_db;
+  size_t _maxBatch;
+  long _maxDelay;
+  std::deque<Request *> _queue;
+  GroupCommitStats _stats;
+  double _committing;
+  double _waiting;
+  bool _stop;
+  pthread_t _thread;
+  pthread_mutex_t _lock;
+  pthread_cond_t _work;
+  pthread_cond_t _released;
+};
+
+}
@@ -0,0 +1,745 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  Importer.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <iostream>
+#include <queue>
+#include <set>
+#include <tr1/unordered_map>
+#include "Importer.h"
+#include "NTriplesParser.h"
+#include "RaptorParser.h"
+#include "ThreadPool.h"
+#include "TripleIndex.h"
+#include "SQL.h"
+#include "sqlconst.h"
+
+namespace Piglet {
+
+static const size_t DEFAULT_MEMORY = 256 << 20;
+static const size_t CACHE_SHARE = 4;        // SQLite's page cache gets 1/4 of the memory
+static const size_t IO_BUFFER = 1 << 16;    // per temporary file
+static const size_t MAX_PARTITIONS = 1024;
+static const size_t MAX_FANIN = 256;        // runs merged at a time
+static const size_t RESERVED_FILES = 32;    // descriptors left for the store, inputs and the caller
+
+static inline bool sameQuad(const Quad &a, const Quad &b)
+{
+  return (a.k[0] == b.k[0]) && (a.k[1] == b.k[1]) && (a.k[2] == b.k[2]) && (a.k[3] == b.k[3]);
+}
+
+// A temporary file of fixed-size and length-prefixed records
+
+class TempFile {
+public:
+  TempFile(const std::string &path, bool writing) MAYFAIL;
+  ~TempFile(void) { if (_file) fclose(_file); }
+  void write(const void *data, size_t n) MAYFAIL
+  {
+    if (fwrite(data, 1, n, _file) != n)
+      FAIL("Unable to write " + _path);
+  }
+  bool read(void *data, size_t n) MAYFAIL
+  {
+    size_t got = fread(data, 1, n, _file);
+    if ((got != n) && ((got != 0) || ferror(_file)))
+      FAIL("Unable to read " + _path);
+    return (got == n);
+  }
+  void close(void) MAYFAIL;
+private:
+  FILE *_file;
+  std::string _path;
+  std::vector<char> _buffer;
+};
+
+TempFile::TempFile(const std::string &path, bool writing) MAYFAIL : _path(path), _buffer(IO_BUFFER)
+{
+  _file = fopen(path.c_str(), writing ? "wb" : "rb");
+  if (_file == NULL)
+    FAIL("Unable to open " + path);
+  setvbuf(_file, &_buffer[0], _IOFBF, _buffer.size());
+}
+
+void TempFile::close(void) MAYFAIL
+{
+  bool ok = (fclose(_file) == 0);
+  _file = NULL;
+  if (!ok)
+    FAIL("Unable to write " + _path);
+}
+
+// Every partition is open at once, in pass 1 and again in pass 3, as is
+// every run of a merge; both stay within the descriptors the process may
+// have open, less a reserve
+
+static size_t openFileLimit(void)
+{
+  struct rlimit limit;
+  if ((getrlimit(RLIMIT_NOFILE, &limit) != 0) || (limit.rlim_cur == RLIM_INFINITY) ||
+      (limit.rlim_cur > MAX_PARTITIONS + RESERVED_FILES + 1))
+    return MAX_PARTITIONS + 1;
+  return std::max<size_t>((size_t)limit.rlim_cur, RESERVED_FILES + 3) - RESERVED_FILES;
+}
+
+class SortTask : public Task {
+public:
+  SortTask(Quad *begin, Quad *end) : _begin(begin), _end(end) {}
+  void run(void) MAYFAIL { std::sort(_begin, _end, QuadLess()); }
+private:
+  Quad *_begin;
+  Quad *_end;
+};
+
+// The import runs in four passes:
+//
+//  1. Files are parsed in turn, and every term is written with its position
+//     (triple number * 4 + slot) to the partition its key hashes to. URIs of
+//     sources and datatypes get their IDs right away, and go to a file of
+//     positions and IDs of their own.
+//  2. Each partition in turn is encoded with an in-memory dictionary: new
+//     nodes are inserted, and positions and IDs written out, still in
+//     position order.
+//  3. The positions of all partitions are merged, which brings the terms of
+//     each triple back together; the triples are sorted, on all threads, in
+//     runs that fit in memory.
+//  4. Runs are merged into the triple table, in primary key order, and
+//     duplicates dropped; indexes are created last.
+
+class Importer : public ParsedTripleSink {
+public:
+  Importer(const char *path, const ImportOptions &options);
+  ~Importer(void);
+  void run(const std::vector<std::string> &files) MAYFAIL;
+  void triple(const ParsedTriple &t) MAYFAIL;
+  void addNamespace(const char *prefix, const char *uri) MAYFAIL;
+private:
+  struct Source {
+    std::string uri;
+    time_t filetime;
+    int id;
+    uint64_t first; // triple
+  };
+  std::string tempPath(const char *kind, size_t i);
+  void exec(const char *sql, const char *message) MAYFAIL;
+  void insertNode(int id, const char *str, int datatype, const char *lang) MAYFAIL;
+  int fixed(const std::string &uri) MAYFAIL;
+  void spill(const ParsedTerm &term, uint64_t position) MAYFAIL;
+  void parse(Source &source) MAYFAIL;
+  void encode(size_t partition) MAYFAIL;
+  int newNode(const std::string &key) MAYFAIL;
+  void sort(void) MAYFAIL;
+  void sortRun(std::vector<Quad> &quads) MAYFAIL;
+  void writeRun(const Quad *begin, const Quad *end) MAYFAIL;
+  void merge(void) MAYFAIL;
+  void mergeRuns(const std::vector<std::string> &runs, TempFile *output) MAYFAIL;
+  std::string _path;
+  std::string _building;
+  ImportOptions _options;
+  size_t _working; // the memory not given to SQLite's cache
+  SQL::Database *_db;
+  SQL::Statement *_insertNode;
+  ThreadPool *_pool;
+  std::vector<Source> _sources;
+  size_t _source; // being parsed
+  std::tr1::unordered_map<std::string, int> _fixed;
+  std::vector<TempFile *> _partitions; // the last one holds fixed IDs
+  std::vector<std::string> _runs;
+  std::set<std::string> _temporary;
+  std::vector<std::pair<std::string, std::string> > _namespaces;
+  std::set<std::pair<int, int> > _graphs; // (source, graph) of N-Quads content
+  uint64_t _triples;
+  int _high;
+  int _low;
+  size_t _runCount;
+};
+
+Importer::Importer(const char *path, const ImportOptions &options)
+  : _path(path), _building(std::string(path) + ".import"), _options(options)
+{
+  if (_options.memory == 0)
+    _options.memory = DEFAULT_MEMORY;
+  _working = _options.memory - _options.memory / CACHE_SHARE;
+  if (_options.threads <= 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    _options.threads = (cpus > 0) ? (int)cpus : 1;
+  }
+  if (_options.tempDir.empty())
+    _options.tempDir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  _db = NULL;
+  _insertNode = NULL;
+  _pool = NULL;
+  _source = 0;
+  _triples = 0;
+  _high = 0;
+  _low = 0;
+  _runCount = 0;
+  RaptorParser::init();
+}
+
+Importer::~Importer(void)
+{
+  for (size_t i = 0; i < _partitions.size(); i++)
+    delete _partitions[i];
+  for (std::set<std::string>::iterator i = _temporary.begin(); i != _temporary.end(); i++)
+    unlink(i->c_str());
+  delete _insertNode;
+  delete _db;
+  delete _pool;
+  unlink(_building.c_str()); // left over only if the import failed
+  RaptorParser::finish();
+}
+
+std::string Importer::tempPath(const char *kind, size_t i)
+{
+  char name[128];
+  snprintf(name, sizeof(name), "/piglet-import-%ld-%s-%lu", (long)getpid(), kind, (unsigned long)i);
+  std::string path(_options.tempDir + name);
+  _temporary.insert(path);
+  return path;
+}
+
+void Importer::exec(const char *sql, const char *message) MAYFAIL
+{
+  char *msg = NULL;
+  if (_db->exec(sql, NULL, NULL, &msg) != SQL::Database::OK) {
+    SQL::TemporaryString error(msg);
+    FAIL(std::string(message) + ": " + (msg ? msg : "unknown error"));
+  }
+}
+
+void Importer::insertNode(int id, const char *str, int datatype, const char *lang) MAYFAIL
+{
+  _insertNode->bind(1, id);
+  _insertNode->bind(2, str);
+  _insertNode->bind(3, datatype);
+  _insertNode->bind(4, lang);
+  _insertNode->step("Unable to insert node");
+  _insertNode->reset();
+}
+
+static int seedCallback(std::tr1::unordered_map<std::string, int> *fixed,
+                        int argc, char **argv, char **cols)
+{
+  if (argv[1])
+    (*fixed)[argv[1]] = atoi(argv[0]);
+  return 0;
+}
+
+void Importer::run(const std::vector<std::string> &files) MAYFAIL
+{
+  struct stat st;
+  if (stat(_path.c_str(), &st) == 0)
+    FAIL(_path + " already exists");
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    Source source;
+    const char *file = files[i].c_str();
+    if (strncmp(file, "file://", 7) == 0)
+      file += 7;
+    else if (strstr(file, "://") != NULL)
+      FAIL("Only local files can be imported: " + files[i]);
+    char resolved[PATH_MAX];
+    if ((realpath(file, resolved) == NULL) || (stat(resolved, &st) != 0))
+      FAIL("Unable to find " + files[i]);
+    source.uri = std::string("file://") + resolved;
+    source.filetime = st.st_mtime;
+    source.id = 0;
+    source.first = 0;
+    bool seen = false;
+    for (size_t j = 0; j < _sources.size(); j++)
+      seen = seen || (_sources[j].uri == source.uri);
+    if (!seen) {
+      _sources.push_back(source);
+      bytes += st.st_size;
+    }
+  }
+
+  unlink(_building.c_str());
+  _db = new SQL::Database(_building.c_str());
+  if (!_db->isOpen())
+    FAIL("Unable to create " + _building);
+  exec(SQL_CREATE_DB, "Unable to create store");
+  char pragmas[128];
+  snprintf(pragmas, sizeof(pragmas), "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF; "
+           "PRAGMA cache_size=-%lu;", (unsigned long)((_options.memory / CACHE_SHARE) >> 10));
+  exec(pragmas, "Unable to set up store");
+  exec("DROP INDEX IF EXISTS strs;", "Unable to drop indexes");
+  exec(SQL_DROP_INDEXES, "Unable to drop indexes");
+  exec("BEGIN;", "Unable to begin transaction");
+  {
+    char *msg = NULL;
+    _db->exec("SELECT id, str FROM node;", &_fixed, (SQL::Callback)seedCallback, &msg);
+    SQL::TemporaryString error(msg);
+  }
+  _high = 0;
+  for (std::tr1::unordered_map<std::string, int>::iterator i = _fixed.begin();
+       i != _fixed.end(); i++)
+    _high = std::max(_high, i->second);
+  _insertNode = new SQL::Statement(_db, "INSERT INTO node VALUES(?1, ?2, ?3, ?4)");
+  if (_options.threads > 1) {
+    _pool = new ThreadPool(_options.threads);
+    if (_pool->size() == 0) {
+      delete _pool;
+      _pool = NULL;
+    }
+  }
+
+  // 1. parse into partitions
+  size_t partitions = (size_t)std::min<uint64_t>(MAX_PARTITIONS,
+                                                 2 * bytes / _working + 1);
+  if (partitions + 1 > openFileLimit()) {
+    partitions = openFileLimit() - 1;
+    if (_options.verbose)
+      std::cerr << "Limited to " << partitions << " partitions by the open file limit\n";
+  }
+  for (size_t i = 0; i <= partitions; i++)
+    _partitions.push_back(new TempFile(tempPath("terms", i), true));
+  for (size_t i = 0; i < _sources.size(); i++)
+    _sources[i].id = fixed(_sources[i].uri);
+  for (_source = 0; _source < _sources.size(); _source++)
+    parse(_sources[_source]);
+  for (size_t i = 0; i < _partitions.size(); i++)
+    _partitions[i]->close();
+  if (_options.verbose)
+    std::cerr << "Parsed " << _triples << " triples from " << _sources.size()
+              << " files into " << partitions << " partitions\n";
+
+  // 2. encode
+  for (size_t i = 0; i < partitions; i++)
+    encode(i);
+  if (_options.verbose)
+    std::cerr << "Encoded " << (_high + 1 - _low) << " nodes\n";
+
+  // 3. sort
+  sort();
+  if (_options.verbose)
+    std::cerr << "Sorted triples into " << _runs.size() << " runs\n";
+
+  // 4. write
+  merge();
+  for (size_t i = 0; i < _sources.size(); i++) {
+    std::string sql(tempsql(SQL::query("INSERT INTO source (src, created, loaded)"
+                                       " VALUES (%d, %d, %d);",
+                                       _sources[i].id, (int)_sources[i].filetime,
+                                       (int)time(NULL))));
+    exec(sql.c_str(), "Unable to insert source");
+  }
+  exec(SQL_CREATE_GRAPHS, "Unable to create store");
+  for (std::set<std::pair<int, int> >::iterator i = _graphs.begin(); i != _graphs.end(); i++) {
+    std::string sql(tempsql(SQL::query("INSERT INTO graph (src, graph) VALUES (%d, %d);",
+                                       i->first, i->second)));
+    exec(sql.c_str(), "Unable to insert graph");
+  }
+  for (size_t i = 0; i < _namespaces.size(); i++) {
+    const char *prefix = _namespaces[i].first.empty() ? NULL : _namespaces[i].first.c_str();
+    std::string sql(tempsql(SQL::query("INSERT INTO namespace SELECT %Q, %Q, 1 WHERE NOT EXISTS "
+                                       "(SELECT 1 FROM namespace WHERE prefix = %Q);",
+                                       prefix, _namespaces[i].second.c_str(), prefix)));
+    exec(sql.c_str(), "Unable to insert namespace");
+  }
+  delete _insertNode;
+  _insertNode = NULL;
+  exec("CREATE INDEX strs ON node (str);", "Unable to create indexes");
+  exec(SQL_CREATE_INDEXES, "Unable to create indexes");
+  exec("COMMIT; PRAGMA journal_mode=DELETE;", "Unable to commit");
+  delete _db;
+  _db = NULL;
+  if (rename(_building.c_str(), _path.c_str()) != 0)
+    FAIL("Unable to rename " + _building + " to " + _path);
+  if (_options.verbose)
+    std::cerr << "Imported " << _path << "\n";
+}
+
+// Sources and datatypes get their IDs while parsing, since literals are keyed
+// by the IDs of their datatypes
+
+int Importer::fixed(const std::string &uri) MAYFAIL
+{
+  std::tr1::unordered_map<std::string, int>::iterator i = _fixed.find(uri);
+  if (i != _fixed.end())
+    return i->second;
+  int id = ++_high;
+  insertNode(id, uri.c_str(), 0, NULL);
+  return _fixed[uri] = id;
+}
+
+void Importer::parse(Source &source) MAYFAIL
+{
+  source.first = _triples;
+  Parser *parser;
+  NTriplesParser::Syntax syntax = NTriplesParser::syntax(source.uri.c_str());
+  if (syntax == NTriplesParser::NONE)
+    parser = new RaptorParser(NULL, this);
+  else
+    parser = new NTriplesParser(NULL, syntax, this, _pool ? _options.threads - 1 : 0);
+  parser->setSourceURI(source.uri);
+  bool ok;
+  try {
+    ok = parser->parse(Node(source.id)) && !parser->terminated();
+  }
+  catch (Condition &c) {
+    delete parser;
+    throw;
+  }
+  std::string error(parser->error());
+  delete parser;
+  if (!ok)
+    FAIL("Unable to parse " + source.uri + (error.empty() ? "" : ": " + error));
+}
+
+void Importer::triple(const ParsedTriple &t) MAYFAIL
+{
+  if (t.s.kind == ParsedTerm::LITERAL)
+    FAIL("Literal subject in " + _sources[_source].uri);
+  uint64_t position = _triples++ << 2;
+  spill(t.s, position);
+  spill(t.p, position + 1);
+  spill(t.o, position + 2);
+  if (!t.g.str.empty())
+    spill(t.g, position + 3);
+}
+
+void Importer::addNamespace(const char *prefix, const char *uri) MAYFAIL
+{
+  _namespaces.push_back(std::make_pair(std::string(prefix ? prefix : ""), std::string(uri)));
+}
+
+// Keys are "R<uri>", "B<file>:<label>" and "L<datatype>\0<language>\0<string>"
+
+static size_t hash(const std::string &key)
+{
+  uint64_t h = 14695981039346656037ULL; // FNV-1a
+  for (size_t i = 0; i < key.size(); i++)
+    h = (h ^ (unsigned char)key[i]) * 1099511628211ULL;
+  return (size_t)h;
+}
+
+void Importer::spill(const ParsedTerm &term, uint64_t position) MAYFAIL
+{
+  std::string key;
+  switch (term.kind) {
+    case ParsedTerm::RESOURCE: {
+      std::tr1::unordered_map<std::string, int>::iterator i = _fixed.find(term.str);
+      if (i != _fixed.end()) {
+        TempFile *ids = _partitions.back();
+        ids->write(&position, sizeof(position));
+        ids->write(&i->second, sizeof(i->second));
+        return;
+      }
+      key = "R" + term.str;
+      break;
+    }
+    case ParsedTerm::BNODE: {
+      char prefix[32];
+      snprintf(prefix, sizeof(prefix), "B%lu:", (unsigned long)_source);
+      key = prefix + term.str;
+      break;
+    }
+    default:
+      if (!term.datatype.empty())
+        fixed(term.datatype);
+      key = "L" + term.datatype;
+      key += '\0';
+      if (term.datatype.empty())
+        key += term.lang;
+      key += '\0';
+      key += term.str;
+  }
+  TempFile *partition = _partitions[hash(key) % (_partitions.size() - 1)];
+  uint32_t length = (uint32_t)key.size();
+  partition->write(&position, sizeof(position));
+  partition->write(&length, sizeof(length));
+  partition->write(key.data(), length);
+}
+
+void Importer::encode(size_t partition) MAYFAIL
+{
+  std::tr1::unordered_map<std::string, int> nodes;
+  TempFile terms(tempPath("terms", partition), false);
+  TempFile ids(tempPath("ids", partition), true);
+  uint64_t position;
+  uint32_t length;
+  std::string key;
+  while (terms.read(&position, sizeof(position))) {
+    if (!terms.read(&length, sizeof(length)))
+      FAIL("Truncated partition");
+    key.resize(length);
+    if ((length > 0) && !terms.read(&key[0], length))
+      FAIL("Truncated partition");
+    std::tr1::unordered_map<std::string, int>::iterator i = nodes.find(key);
+    int id = (i != nodes.end()) ? i->second : (nodes[key] = newNode(key));
+    ids.write(&position, sizeof(position));
+    ids.write(&id, sizeof(id));
+  }
+  ids.close();
+  unlink(tempPath("terms", partition).c_str());
+}
+
+int Importer::newNode(const std::string &key) MAYFAIL
+{
+  switch (key[0]) {
+    case 'R': {
+      // a URI seen before it turned out to be a datatype
+      std::tr1::unordered_map<std::string, int>::iterator i = _fixed.find(key.substr(1));
+      if (i != _fixed.end())
+        return i->second;
+      int id = ++_high;
+      insertNode(id, key.c_str() + 1, 0, NULL);
+      return id;
+    }
+    case 'B': {
+      int id = ++_high;
+      insertNode(id, NULL, 0, NULL);
+      return id;
+    }
+    default: {
+      size_t lang = key.find('\0') + 1;
+      size_t str = key.find('\0', lang) + 1;
+      std::string datatype(key, 1, lang - 2);
+      int dt = datatype.empty() ? 0 : _fixed[datatype];
+      int id = --_low;
+      insertNode(id, key.c_str() + str, dt, (str - lang > 1) ? key.c_str() + lang : NULL);
+      return id;
+    }
+  }
+}
+
+// Streams of positions and IDs, merged by position
+
+struct PositionStream {
+  TempFile *file;
+  uint64_t position;
+  int id;
+  bool next(void) MAYFAIL
+  {
+    return file->read(&position, sizeof(position)) && file->read(&id, sizeof(id));
+  }
+};
+
+struct LaterPosition {
+  bool operator()(const PositionStream *a, const PositionStream *b) const
+  {
+    return a->position > b->position;
+  }
+};
+
+void Importer::sort(void) MAYFAIL
+{
+  size_t n = _partitions.size();
+  std::vector<PositionStream> streams(n);
+  std::priority_queue<PositionStream *, std::vector<PositionStream *>, LaterPosition> queue;
+  for (size_t i = 0; i < n; i++)
+    delete _partitions[i];
+  _partitions.clear();
+  for (size_t i = 0; i < n; i++) {
+    _partitions.push_back(new TempFile(tempPath((i + 1 < n) ? "ids" : "terms", i), false));
+    streams[i].file = _partitions[i];
+    if (streams[i].next())
+      queue.push(&streams[i]);
+  }
+  std::vector<Quad> quads;
+  quads.reserve(_working / sizeof(Quad));
+  size_t source = 0;
+  uint64_t current = (uint64_t)-1;
+  Quad q = { { 0, 0, 0, 0 } };
+  while (!queue.empty()) {
+    PositionStream *s = queue.top();
+    queue.pop();
+    uint64_t triple = s->position >> 2;
+    if (triple != current) {
+      if (current != (uint64_t)-1) {
+        quads.push_back(q);
+        if (quads.size() == quads.capacity())
+          sortRun(quads);
+      }
+      current = triple;
+      while ((source + 1 < _sources.size()) && (_sources[source + 1].first <= triple))
+        source++;
+      q.k[0] = q.k[1] = q.k[2] = 0;
+      q.k[3] = _sources[source].id;
+    }
+    if (((s->position & 3) == 3) && (s->id != q.k[3])) // a graph other than the source
+      _graphs.insert(std::make_pair(q.k[3], s->id));
+    q.k[s->position & 3] = s->id;
+    if (s->next())
+      queue.push(s);
+  }
+  if (current != (uint64_t)-1)
+    quads.push_back(q);
+  if (!quads.empty())
+    sortRun(quads);
+  for (size_t i = 0; i < n; i++) {
+    delete _partitions[i];
+    unlink(tempPath((i + 1 < n) ? "ids" : "terms", i).c_str());
+  }
+  _partitions.clear();
+}
+
+// A full buffer is cut into one piece per thread; the pieces are sorted in
+// parallel and written as runs of their own
+
+void Importer::sortRun(std::vector<Quad> &quads) MAYFAIL
+{
+  size_t pieces = _pool ? (size_t)_pool->size() : 1;
+  size_t size = (quads.size() + pieces - 1) / pieces;
+  std::vector<SortTask> sorts;
+  for (size_t i = 0; i < quads.size(); i += size)
+    sorts.push_back(SortTask(&quads[i], &quads[0] + std::min(i + size, quads.size())));
+  if (_pool) {
+    std::vector<Task *> tasks;
+    for (size_t i = 0; i < sorts.size(); i++)
+      tasks.push_back(&sorts[i]);
+    _pool->run(tasks);
+  }
+  else
+    sorts[0].run();
+  for (size_t i = 0; i < quads.size(); i += size)
+    writeRun(&quads[i], &quads[0] + std::min(i + size, quads.size()));
+  quads.clear();
+}
+
+void Importer::writeRun(const Quad *begin, const Quad *end) MAYFAIL
+{
+  std::string path(tempPath("run", _runCount++));
+  TempFile run(path, true);
+  for (const Quad *q = begin; q < end; q++)
+    if ((q == begin) || !sameQuad(q[-1], *q))
+      run.write(q, sizeof(Quad));
+  run.close();
+  _runs.push_back(path);
+}
+
+struct RunStream {
+  TempFile *file;
+  Quad quad;
+  bool next(void) MAYFAIL { return file->read(&quad, sizeof(quad)); }
+};
+
+struct LaterQuad {
+  bool operator()(const RunStream *a, const RunStream *b) const
+  {
+    return QuadLess()(b->quad, a->quad);
+  }
+};
+
+// Merges runs into another run, or into the triple table if output is NULL
+
+void Importer::mergeRuns(const std::vector<std::string> &runs, TempFile *output) MAYFAIL
+{
+  std::vector<RunStream> streams(runs.size());
+  std::priority_queue<RunStream *, std::vector<RunStream *>, LaterQuad> queue;
+  SQL::Statement *insert = NULL;
+  try {
+    for (size_t i = 0; i < runs.size(); i++) {
+      streams[i].file = new TempFile(runs[i], false);
+      if (streams[i].next())
+        queue.push(&streams[i]);
+    }
+    if (output == NULL)
+      insert = new SQL::Statement(_db, "INSERT INTO triple VALUES(?1, ?2, ?3, ?4)");
+    bool first = true;
+    Quad last = { { 0, 0, 0, 0 } };
+    while (!queue.empty()) {
+      RunStream *s = queue.top();
+      queue.pop();
+      if (first || !sameQuad(s->quad, last)) {
+        last = s->quad;
+        first = false;
+        if (output)
+          output->write(&last, sizeof(last));
+        else {
+          for (int i = 0; i < 4; i++)
+            insert->bind(i + 1, last.k[i]);
+          insert->step("Unable to insert triple");
+          insert->reset();
+        }
+      }
+      if (s->next())
+        queue.push(s);
+    }
+  }
+  catch (Condition &c) {
+    delete insert;
+    for (size_t i = 0; i < streams.size(); i++)
+      delete streams[i].file;
+    throw;
+  }
+  delete insert;
+  for (size_t i = 0; i < streams.size(); i++) {
+    delete streams[i].file;
+    unlink(runs[i].c_str());
+  }
+}
+
+void Importer::merge(void) MAYFAIL
+{
+  size_t fanin = std::min(MAX_FANIN, openFileLimit() - 1); // and the output
+  while (_runs.size() > fanin) {
+    std::vector<std::string> runs(_runs.begin(), _runs.begin() + fanin);
+    _runs.erase(_runs.begin(), _runs.begin() + fanin);
+    std::string path(tempPath("run", _runCount++));
+    TempFile output(path, true);
+    mergeRuns(runs, &output);
+    output.close();
+    _runs.push_back(path);
+  }
+  mergeRuns(_runs, NULL);
+  _runs.clear();
+}
+
+void import(const char *path, const std::vector<std::string> &files,
+            const ImportOptions *options) MAYFAIL
+{
+  ImportOptions defaults = { 0, 0, "", false };
+  Importer importer(path, options ? *options : defaults);
+  importer.run(files);
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  Importer.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Condition.h"
+
+namespace Piglet {
+
+// Zero or empty members of ImportOptions take the defaults
+
+struct ImportOptions {
+  size_t memory;       // bytes in all; SQLite's cache gets a quarter, the rest goes to
+                       // one dictionary partition or triple run at a time (256 MB)
+  int threads;         // threads to parse and sort on (one per processor)
+  std::string tempDir; // where partitions and runs are written ($TMPDIR, or /tmp)
+  bool verbose;
+};
+
+// Builds a new store at path from local N-Triples, N-Quads and RDF/XML files,
+// given as paths or file: URIs, without going through DB. Terms are encoded
+// a hash partition at a time, triples are sorted in runs on disk, and the
+// tables are written in key order with indexes built last, so memory stays
+// bounded whatever the size of the input. The store is written under a
+// temporary name and only renamed into place once complete; path must not
+// exist already. Each file becomes a source, as if loaded with DB::load().
+
+void import(const char *path, const std::vector<std::string> &files,
+            const ImportOptions *options = NULL) MAYFAIL;
+
+}
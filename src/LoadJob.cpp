@@ -0,0 +1,232 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  LoadJob.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include "LoadJob.h"
+#include "DB.h"
+#include "Parser.h"
+
+namespace Piglet {
+
+static const long PROGRESS_TRIPLES = 4096; // triples between progress reports
+
+LoadJob::LoadJob(DB *db, Node source, bool append, bool verbose, LoadProgress *progress)
+  : _db(db), _source(source), _append(append), _verbose(verbose), _progress(progress),
+    _stream(NULL), _unpublished(0), _state(RUNNING), _cancelled(false),
+    _started(false), _joined(false)
+{
+  LoadStatus zero = { 0, 0, 0 };
+  _counts = _status = zero;
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_ended, NULL);
+}
+
+LoadJob::~LoadJob(void)
+{
+  wait();
+  pthread_cond_destroy(&_ended);
+  pthread_mutex_destroy(&_lock);
+}
+
+void LoadJob::start(void) MAYFAIL
+{
+  if (pthread_create(&_thread, NULL, LoadJob::run, this) != 0)
+    FAIL("Unable to start load thread");
+  _started = true;
+}
+
+void *LoadJob::run(void *arg)
+{
+  LoadJob *job = (LoadJob *)arg;
+  CurrentDB use(job->_db);
+  State state;
+  std::string error;
+  try {
+    state = job->_db->loadSource(job->_source, job->_append, job->_verbose, NULL, NULL, job)
+      ? LOADED : FAILED;
+  }
+  catch (Condition &c) {
+    state = FAILED;
+    error = c.message();
+  }
+  job->publish();
+  pthread_mutex_lock(&job->_lock);
+  job->_state = (job->_cancelled && (state == FAILED)) ? CANCELLED : state;
+  job->_error = error;
+  pthread_cond_broadcast(&job->_ended);
+  pthread_mutex_unlock(&job->_lock);
+  return NULL;
+}
+
+bool LoadJob::poll(void)
+{
+  return state() != RUNNING;
+}
+
+LoadJob::State LoadJob::wait(void)
+{
+  if (!_started)
+    return state();
+  pthread_mutex_lock(&_lock);
+  while (_state == RUNNING)
+    pthread_cond_wait(&_ended, &_lock);
+  bool join = !_joined;
+  _joined = true;
+  State state = _state;
+  pthread_mutex_unlock(&_lock);
+  if (join)
+    pthread_join(_thread, NULL);
+  return state;
+}
+
+void LoadJob::cancel(void)
+{
+  pthread_mutex_lock(&_lock);
+  _cancelled = true;
+  pthread_mutex_unlock(&_lock);
+}
+
+LoadJob::State LoadJob::state(void)
+{
+  pthread_mutex_lock(&_lock);
+  State state = _state;
+  pthread_mutex_unlock(&_lock);
+  return state;
+}
+
+LoadStatus LoadJob::status(void)
+{
+  pthread_mutex_lock(&_lock);
+  LoadStatus status = _status;
+  pthread_mutex_unlock(&_lock);
+  return status;
+}
+
+std::string LoadJob::error(void)
+{
+  pthread_mutex_lock(&_lock);
+  std::string error = _error;
+  pthread_mutex_unlock(&_lock);
+  return error;
+}
+
+bool LoadJob::triple(bool inserted)
+{
+  return triples(1, inserted ? 1 : 0);
+}
+
+bool LoadJob::triples(long parsed, long inserted)
+{
+  _counts.parsed += parsed;
+  _counts.inserted += inserted;
+  _unpublished += parsed;
+  if (_unpublished >= PROGRESS_TRIPLES)
+    publish();
+  pthread_mutex_lock(&_lock);
+  bool cancelled = _cancelled;
+  pthread_mutex_unlock(&_lock);
+  return !cancelled;
+}
+
+void LoadJob::publish(void)
+{
+  if (_stream) {
+    long position = ftell(_stream);
+    if (position > 0)
+      _counts.bytes = position;
+  }
+  _unpublished = 0;
+  pthread_mutex_lock(&_lock);
+  _status = _counts;
+  pthread_mutex_unlock(&_lock);
+  if (_progress)
+    (*_progress)(_counts);
+}
+
+ChunkedLoad::ChunkedLoad(DB *db, Node source, Parser *parser, bool verbose)
+  : _db(db), _source(source), _parser(parser), _verbose(verbose), _open(true),
+    _thread(pthread_self())
+{
+}
+
+ChunkedLoad::~ChunkedLoad(void)
+{
+  try {
+    abort();
+  }
+  catch (Condition &c) {
+  }
+  delete _parser;
+}
+
+bool ChunkedLoad::chunk(const unsigned char *data, size_t length) MAYFAIL
+{
+  if (!_open)
+    FAIL("Load has ended");
+  if (!pthread_equal(_thread, pthread_self()))
+    FAIL("Load continued on another thread");
+  return _db->loadChunk(this, data, length);
+}
+
+bool ChunkedLoad::end(void) MAYFAIL
+{
+  if (!_open)
+    FAIL("Load has ended");
+  if (!pthread_equal(_thread, pthread_self()))
+    FAIL("Load continued on another thread");
+  _open = false;
+  return _db->loadEnd(this, true);
+}
+
+void ChunkedLoad::abort(void) MAYFAIL
+{
+  if (_open) {
+    if (!pthread_equal(_thread, pthread_self()))
+      FAIL("Load continued on another thread");
+    _open = false;
+    _db->loadEnd(this, false);
+  }
+}
+
+std::string ChunkedLoad::error(void)
+{
+  return _parser->error();
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  LoadJob.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <stdio.h>
+#include <pthread.h>
+#include "Node.h"
+#include "Condition.h"
+
+namespace Piglet {
+
+class DB;
+class Parser;
+
+struct LoadStatus {
+  long parsed;   // triples parsed so far
+  long inserted; // triples inserted so far (duplicates are not)
+  long bytes;    // bytes read so far; file: sources only, otherwise 0
+};
+
+// Called on the loading thread, every few thousand triples and once more
+// when the load ends
+
+class LoadProgress {
+public:
+  virtual ~LoadProgress(void) {}
+  virtual void operator()(const LoadStatus &status) = 0;
+};
+
+// A load running on a thread of its own (see DB::loadAsync()). cancel()
+// makes the parser terminate at the next triple, and the load is rolled back
+// as with any other terminated parse. Deleting a job waits for it to end.
+
+class LoadJob {
+public:
+  enum State { RUNNING, LOADED, FAILED, CANCELLED };
+  LoadJob(DB *db, Node source, bool append, bool verbose, LoadProgress *progress);
+  ~LoadJob(void);
+  void start(void) MAYFAIL;
+  bool poll(void);  // true once the load has ended
+  State wait(void);
+  void cancel(void);
+  State state(void);
+  LoadStatus status(void);
+  std::string error(void);
+  // reporting, from the loading thread
+  void setStream(FILE *stream) { _stream = stream; }
+  bool triple(bool inserted); // false once cancelled
+  bool triples(long parsed, long inserted);
+private:
+  static void *run(void *job);
+  void publish(void);
+  DB *_db;
+  Node _source;
+  bool _append;
+  bool _verbose;
+  LoadProgress *_progress;
+  FILE *_stream;
+  LoadStatus _counts;  // as seen by the loading thread
+  LoadStatus _status;  // as last published
+  long _unpublished;
+  State _state;
+  bool _cancelled;
+  bool _started;
+  bool _joined;
+  std::string _error;
+  pthread_t _thread;
+  pthread_mutex_t _lock;
+  pthread_cond_t _ended;
+};
+
+// A load fed by the caller a chunk at a time (see DB::loadBegin()), e.g. as
+// a payload arrives from the network; chunks are parsed as they come, and
+// need not be NUL-terminated. The load has a transaction of its own (nested,
+// if the calling thread has one open), which end() commits unless parsing
+// failed; deleting a load that has not ended rolls it back. Until it ends, the
+// load holds the store's write lock: writes from other threads wait for it,
+// while their reads see what was committed before it began. All calls must
+// come from the thread that began the load.
+
+class ChunkedLoad {
+public:
+  ~ChunkedLoad(void);
+  bool chunk(const unsigned char *data, size_t length) MAYFAIL; // false once parsing failed
+  bool end(void) MAYFAIL; // true if loaded
+  void abort(void) MAYFAIL;
+  std::string error(void);
+private:
+  friend class DB;
+  ChunkedLoad(DB *db, Node source, Parser *parser, bool verbose);
+  DB *_db;
+  Node _source;
+  Parser *_parser;
+  bool _verbose;
+  bool _open;
+  pthread_t _thread;
+};
+
+}
@@ -0,0 +1,242 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  LoadQueue.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include "LoadQueue.h"
+
+namespace Piglet {
+
+LoadQueue::LoadQueue(size_t sources, size_t capacity)
+  : _channels(sources), _capacity(capacity ? capacity : 1), _aborted(false)
+{
+  for (size_t i = 0; i < sources; i++) {
+    _channels[i].outcome = PENDING;
+    _channels[i].taken = false;
+  }
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_ready, NULL);
+  pthread_cond_init(&_space, NULL);
+}
+
+LoadQueue::~LoadQueue(void)
+{
+  for (size_t i = 0; i < _channels.size(); i++)
+    for (size_t j = 0; j < _channels[i].batches.size(); j++)
+      delete _channels[i].batches[j];
+  pthread_cond_destroy(&_space);
+  pthread_cond_destroy(&_ready);
+  pthread_mutex_destroy(&_lock);
+}
+
+bool LoadQueue::push(size_t source, ParsedBatch *batch)
+{
+  Channel &c = _channels[source];
+  pthread_mutex_lock(&_lock);
+  while (!_aborted && (c.batches.size() >= _capacity))
+    pthread_cond_wait(&_space, &_lock);
+  bool ok = !_aborted;
+  if (ok) {
+    c.batches.push_back(batch);
+    pthread_cond_broadcast(&_ready);
+  }
+  pthread_mutex_unlock(&_lock);
+  if (!ok)
+    delete batch;
+  return ok;
+}
+
+void LoadQueue::finish(size_t source, Outcome outcome, const Validators &validators,
+                       const std::string &error)
+{
+  Channel &c = _channels[source];
+  pthread_mutex_lock(&_lock);
+  c.validators = validators;
+  c.error = error;
+  c.outcome = outcome;
+  pthread_cond_broadcast(&_ready);
+  pthread_mutex_unlock(&_lock);
+}
+
+bool LoadQueue::aborted(void)
+{
+  pthread_mutex_lock(&_lock);
+  bool result = _aborted;
+  pthread_mutex_unlock(&_lock);
+  return result;
+}
+
+// Returns a source not taken before that has something to show; must not be
+// called more often than there are sources
+
+size_t LoadQueue::next(void)
+{
+  pthread_mutex_lock(&_lock);
+  for (;;) {
+    for (size_t i = 0; i < _channels.size(); i++) {
+      Channel &c = _channels[i];
+      if (!c.taken && (!c.batches.empty() || (c.outcome != PENDING))) {
+        c.taken = true;
+        pthread_mutex_unlock(&_lock);
+        return i;
+      }
+    }
+    pthread_cond_wait(&_ready, &_lock);
+  }
+}
+
+ParsedBatch *LoadQueue::pop(size_t source)
+{
+  Channel &c = _channels[source];
+  ParsedBatch *batch = NULL;
+  pthread_mutex_lock(&_lock);
+  while (c.batches.empty() && (c.outcome == PENDING))
+    pthread_cond_wait(&_ready, &_lock);
+  if (!c.batches.empty()) {
+    batch = c.batches.front();
+    c.batches.pop_front();
+    pthread_cond_broadcast(&_space);
+  }
+  pthread_mutex_unlock(&_lock);
+  return batch;
+}
+
+// Makes producers drop whatever they parse from now on, and stop as soon as
+// they notice
+
+void LoadQueue::abort(void)
+{
+  pthread_mutex_lock(&_lock);
+  _aborted = true;
+  pthread_cond_broadcast(&_space);
+  pthread_mutex_unlock(&_lock);
+}
+
+SourceParse::SourceParse(Parser *parser, Node source, const Validators &known,
+                         LoadQueue *queue, size_t index, size_t batchSize,
+                         const std::string &cacheDir)
+  : _parser(parser), _source(source), _known(known), _cacheDir(cacheDir),
+    _queue(queue), _index(index), _batchSize(batchSize), _batch(NULL),
+    _force(false), _script(NULL), _argv(NULL)
+{
+}
+
+// Called by the writing thread, which resolves the source URI here: a source
+// created in a transaction still open is not visible to the parsing threads
+
+void SourceParse::setParser(Parser *parser) MAYFAIL
+{
+  _parser = parser;
+  TemporaryString uri(parser->db()->info(_source));
+  _uri = uri.string();
+  parser->setSourceURI(_uri);
+}
+
+void SourceParse::force(const char *script, char *argv[])
+{
+  _force = true;
+  _script = script;
+  _argv = argv;
+}
+
+SourceParse::~SourceParse(void)
+{
+  delete _batch;
+  delete _parser;
+}
+
+void SourceParse::run(void) MAYFAIL
+{
+  Validators validators;
+  try {
+    if (_queue->aborted()) {
+      _queue->finish(_index, LoadQueue::FAILED, validators, "Load aborted");
+      return;
+    }
+    if (!_force) {
+      Fetch fetch(_uri, _cacheDir);
+      Fetch::Outcome outcome = fetch.run(_parser, _source, _known);
+      validators = fetch.validators();
+      if (outcome == Fetch::NOT_MODIFIED) {
+        _queue->finish(_index, LoadQueue::UNCHANGED, validators, "");
+        return;
+      }
+    }
+    else if (_script)
+      _parser->parseFromScript(_source, _script, _argv);
+    else
+      _parser->parse(_source);
+    flush();
+    if (_parser->terminated())
+      _queue->finish(_index, LoadQueue::FAILED, validators, _parser->error());
+    else
+      _queue->finish(_index, LoadQueue::PARSED, validators, "");
+  }
+  catch (Condition &c) {
+    _queue->finish(_index, LoadQueue::FAILED, validators, c.message());
+  }
+}
+
+void SourceParse::triple(const ParsedTriple &t) MAYFAIL
+{
+  if (_batch == NULL)
+    _batch = new ParsedBatch;
+  _batch->triples.push_back(t);
+  if (_batch->triples.size() >= _batchSize)
+    flush();
+}
+
+void SourceParse::addNamespace(const char *prefix, const char *uri) MAYFAIL
+{
+  if (_batch == NULL)
+    _batch = new ParsedBatch;
+  _batch->namespaces.push_back(std::make_pair(std::string(prefix ? prefix : ""),
+                                              std::string(uri)));
+}
+
+void SourceParse::flush(void)
+{
+  if (_batch) {
+    ParsedBatch *batch = _batch;
+    _batch = NULL;
+    if (!_queue->push(_index, batch) && !_parser->terminated())
+      _parser->terminate("Load aborted");
+  }
+}
+
+}
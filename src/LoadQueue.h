@@ -0,0 +1,157 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  LoadQueue.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <utility>
+#include <time.h>
+#include <pthread.h>
+#include "Parser.h"
+#include "Fetch.h"
+#include "ThreadPool.h"
+
+namespace Piglet {
+
+// Parsed triples travel from the parsing threads to the writing thread in
+// batches; namespace declarations travel along with the triples. A pipelined
+// load encodes a batch before it reaches the writer: the triples are then
+// given as node IDs, along with the nodes that have to be added first.
+
+struct NewNode {
+  int id;
+  bool bnode;
+  std::string str;
+  int datatype;
+  std::string lang;
+  bool unsettled; // the load may have added the node already, under another ID
+};
+
+struct EncodedTriple {
+  int s, p, o;
+  int g; // graph label, 0 if the triple belongs to the source
+  bool operator<(const EncodedTriple &t) const
+  {
+    return (s != t.s) ? (s < t.s) : (p != t.p) ? (p < t.p) : (o < t.o);
+  }
+};
+
+struct ParsedBatch {
+  std::vector<ParsedTriple> triples;
+  std::vector<std::pair<std::string, std::string> > namespaces;
+  std::vector<NewNode> nodes;
+  std::vector<EncodedTriple> encoded;
+};
+
+// Connects the parsers of several sources to the single thread writing them
+// into the database. Every source has a channel of its own, bounded so that a
+// fast parser cannot run ahead of the writer by more than a few batches. The
+// writer takes the sources one at a time, in the order in which they start
+// producing, and drains each before taking the next.
+
+class LoadQueue {
+public:
+  enum Outcome { PENDING, UNCHANGED, PARSED, FAILED };
+  LoadQueue(size_t sources, size_t capacity);
+  ~LoadQueue(void);
+  // producer side
+  bool push(size_t source, ParsedBatch *batch); // false (and batch deleted) if aborted
+  void finish(size_t source, Outcome outcome, const Validators &validators,
+              const std::string &error);
+  bool aborted(void);
+  // consumer side
+  size_t next(void);
+  ParsedBatch *pop(size_t source); // NULL once the source is finished
+  void abort(void);
+  Outcome outcome(size_t source) const { return _channels[source].outcome; }
+  const Validators &validators(size_t source) const { return _channels[source].validators; }
+  const std::string &error(size_t source) const { return _channels[source].error; }
+private:
+  struct Channel {
+    std::deque<ParsedBatch *> batches;
+    Outcome outcome;
+    bool taken;
+    Validators validators;
+    std::string error;
+  };
+  std::vector<Channel> _channels;
+  size_t _capacity;
+  bool _aborted;
+  pthread_mutex_t _lock;
+  pthread_cond_t _ready;
+  pthread_cond_t _space;
+};
+
+// Parses one source into a LoadQueue, fetching it with a conditional GET (see
+// Fetch) so that a source not modified since it was last loaded with the known
+// validators is not parsed at all; force() parses it unconditionally, with the
+// parser fetching it. Failures are reported through the queue rather than
+// thrown.
+
+class SourceParse : public Task, public ParsedTripleSink {
+public:
+  SourceParse(Parser *parser, Node source, const Validators &known,
+              LoadQueue *queue, size_t index, size_t batchSize,
+              const std::string &cacheDir = std::string());
+  virtual ~SourceParse(void);
+  void setParser(Parser *parser) MAYFAIL; // owned from then on
+  void force(const char *script = NULL, char *argv[] = NULL);
+  virtual void run(void) MAYFAIL;
+  virtual void triple(const ParsedTriple &t) MAYFAIL;
+  virtual void addNamespace(const char *prefix, const char *uri) MAYFAIL;
+private:
+  void flush(void);
+  Parser *_parser;
+  Node _source;
+  std::string _uri;
+  Validators _known;
+  std::string _cacheDir;
+  LoadQueue *_queue;
+  size_t _index;
+  size_t _batchSize;
+  ParsedBatch *_batch;
+  bool _force;
+  const char *_script;
+  char **_argv;
+};
+
+}
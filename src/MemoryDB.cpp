@@ -0,0 +1,273 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  MemoryDB.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <algorithm>
+#include "MemoryDB.h"
+#include "Messages.h"
+
+namespace Piglet {
+
+MemoryDB::MemoryDB(char *name, bool verbose) MAYFAIL
+  : DB(name, verbose)
+{
+  mutex::MutexLock lock(&_mutex);
+  std::vector<Quad> quads;
+  SQL::Statement q(getDatabase(), "SELECT s, p, o, src FROM triple");
+  while (q.step(ERR_TRIPLE_FIND)) {
+    Quad quad = { { q.column(0), q.column(1), q.column(2), q.column(3) } };
+    quads.push_back(quad);
+  }
+  _triples.load(quads);
+  if (verboseOps())
+    std::cerr << "Indexed " << _triples.size() << " triples in memory\n";
+}
+
+TripleCursor *MemoryDB::cursor(Node subject, Node predicate, Node object, Node source) MAYFAIL
+{
+  QuadTripleCursor *c = new QuadTripleCursor();
+  std::vector<Quad> &rows = c->rows();
+  match(false, id(subject), id(predicate), id(object), id(source), &rows);
+  match(true, id(subject), id(predicate), id(object), id(source), &rows);
+  matchSnapshots(subject, predicate, object, source, &rows);
+  c->distinct();
+  return c;
+}
+
+bool MemoryDB::stored(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  if (!writing()) {
+    mutex::ReadLock lock(&_indexLock);
+    return triples(temporary).exists(id(s), id(p), id(o), id(source));
+  }
+  return match(temporary, id(s), id(p), id(o), id(source), NULL) > 0;
+}
+
+bool MemoryDB::storedQuad(const Quad &quad) MAYFAIL
+{
+  std::vector<Quad> rows;
+  match(false, quad.k[0], quad.k[1], quad.k[2], 0, &rows);
+  for (size_t i = 0; i < rows.size(); i++)
+    if (rows[i].k[3] == quad.k[3])
+      return true;
+  return false;
+}
+
+int MemoryDB::count(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  int n = (int)match(temporary, id(s), id(p), id(o), id(source), NULL);
+  return temporary ? n : n + (int)countSnapshotOnly(s, p, o, source, n > 0);
+}
+
+bool MemoryDB::sources(Triple *triple, NodeAction *action) MAYFAIL
+{
+  std::vector<int> sources;
+  {
+    std::vector<Quad> rows;
+    match(false, id(triple->s()), id(triple->p()), id(triple->o()), 0, &rows);
+    matchSnapshots(triple->s(), triple->p(), triple->o(), NULL_NODE, &rows);
+    for (std::vector<Quad>::const_iterator q = rows.begin(); q != rows.end(); q++)
+      sources.push_back(q->k[3]);
+  }
+  std::sort(sources.begin(), sources.end());
+  sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+  for (std::vector<int>::const_iterator s = sources.begin(); s != sources.end(); s++)
+    if (!(*action)(Node(*s)))
+      return false;
+  return true;
+}
+
+// Matches in the indexes and, for the thread writing, among the changes of the
+// open transaction; removed quads are always in the indexes, added ones never
+
+size_t MemoryDB::match(bool temporary, int s, int p, int o, int src,
+                       std::vector<Quad> *out) MAYFAIL
+{
+  size_t first = out ? out->size() : 0;
+  size_t n;
+  {
+    mutex::ReadLock lock(&_indexLock);
+    n = triples(temporary).match(s, p, o, src, out);
+  }
+  if (!writing())
+    return n;
+  mutex::MutexLock lock(&_mutex, "match");
+  const TripleIndex &removed = pending(temporary, REMOVED);
+  if (removed.size() > 0) {
+    if (out) {
+      std::vector<Quad>::iterator kept = out->begin() + first;
+      for (std::vector<Quad>::iterator q = kept; q != out->end(); q++)
+        if (!removed.exists(q->k[0], q->k[1], q->k[2], q->k[3]))
+          *kept++ = *q;
+      out->erase(kept, out->end());
+      n = out->size() - first;
+    }
+    else
+      n -= removed.match(s, p, o, src, NULL);
+  }
+  return n + pending(temporary, ADDED).match(s, p, o, src, out);
+}
+
+// Outside of a transaction SQLite has already committed the change, and the
+// indexes take it at once
+
+bool MemoryDB::insertTriple(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "insertTriple");
+  if (!DB::insertTriple(s, p, o, source, temporary))
+    return false;
+  Quad quad = { { id(s), id(p), id(o), id(source) } };
+  if (!getDatabase()->inTransaction()) {
+    mutex::WriteLock lock(&_indexLock);
+    triples(temporary).insert(id(s), id(p), id(o), id(source));
+  }
+  else if (pending(temporary, REMOVED).exists(id(s), id(p), id(o), id(source)))
+    change(temporary, REMOVED, false, quad);
+  else if (match(temporary, id(s), id(p), id(o), id(source), NULL) == 0)
+    change(temporary, ADDED, true, quad);
+  return true;
+}
+
+void MemoryDB::deleteTriples(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "deleteTriples");
+  DB::deleteTriples(s, p, o, source, temporary);
+  std::vector<Quad> rows;
+  if (!getDatabase()->inTransaction()) {
+    mutex::WriteLock lock(&_indexLock);
+    triples(temporary).match(id(s), id(p), id(o), id(source), &rows);
+    for (std::vector<Quad>::const_iterator q = rows.begin(); q != rows.end(); q++)
+      triples(temporary).remove(q->k[0], q->k[1], q->k[2], q->k[3]);
+    return;
+  }
+  match(temporary, id(s), id(p), id(o), id(source), &rows);
+  for (std::vector<Quad>::const_iterator q = rows.begin(); q != rows.end(); q++) {
+    if (pending(temporary, ADDED).exists(q->k[0], q->k[1], q->k[2], q->k[3]))
+      change(temporary, ADDED, false, *q);
+    else
+      change(temporary, REMOVED, true, *q);
+  }
+}
+
+void MemoryDB::change(bool temporary, int set, bool insert, const Quad &quad)
+{
+  const int *k = quad.k;
+  if (insert)
+    pending(temporary, set).insert(k[0], k[1], k[2], k[3]);
+  else
+    pending(temporary, set).remove(k[0], k[1], k[2], k[3]);
+  Change change = { temporary, set, insert, quad };
+  _undo.push_back(change);
+}
+
+// Called once the transaction has committed, with the database lock held
+
+void MemoryDB::committed(void)
+{
+  DB::committed();
+  {
+    mutex::WriteLock lock(&_indexLock);
+    for (int t = 0; t < 2; t++) {
+      std::vector<Quad> rows;
+      pending(t, REMOVED).match(0, 0, 0, 0, &rows);
+      for (std::vector<Quad>::const_iterator q = rows.begin(); q != rows.end(); q++)
+        triples(t).remove(q->k[0], q->k[1], q->k[2], q->k[3]);
+      rows.clear();
+      pending(t, ADDED).match(0, 0, 0, 0, &rows);
+      for (std::vector<Quad>::const_iterator q = rows.begin(); q != rows.end(); q++)
+        triples(t).insert(q->k[0], q->k[1], q->k[2], q->k[3]);
+    }
+  }
+  discard();
+}
+
+void MemoryDB::rolledBack(void)
+{
+  DB::rolledBack();
+  discard();
+}
+
+void MemoryDB::discard(void)
+{
+  for (int t = 0; t < 2; t++)
+    for (int set = ADDED; set <= REMOVED; set++)
+      pending(t, set) = TripleIndex();
+  _undo.clear();
+  _savepoints.clear();
+}
+
+// Savepoints are expected to be released or rolled back to in the reverse
+// order of their creation
+
+void MemoryDB::savepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "savepoint");
+  DB::savepoint(name);
+  _savepoints.push_back(_undo.size());
+}
+
+void MemoryDB::releaseSavepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "releaseSavepoint");
+  DB::releaseSavepoint(name);
+  if (!_savepoints.empty())
+    _savepoints.pop_back();
+}
+
+void MemoryDB::rollbackToSavepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "rollbackToSavepoint");
+  DB::rollbackToSavepoint(name);
+  undo(_savepoints.empty() ? 0 : _savepoints.back());
+}
+
+void MemoryDB::undo(size_t mark)
+{
+  while (_undo.size() > mark) {
+    const Change &c = _undo.back();
+    const int *k = c.quad.k;
+    if (c.inserted)
+      pending(c.temporary, c.set).remove(k[0], k[1], k[2], k[3]);
+    else
+      pending(c.temporary, c.set).insert(k[0], k[1], k[2], k[3]);
+    _undo.pop_back();
+  }
+}
+
+}
@@ -0,0 +1,99 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  MemoryDB.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include "DB.h"
+#include "TripleIndex.h"
+
+namespace Piglet {
+
+// A DB that answers triple queries (query, cursor, exists, count, sources)
+// from in-memory SPO/POS/OSP indexes. Writes still go through to SQLite,
+// which remains the persistent snapshot and log and serves the node
+// dictionary and SQL-level queries; the indexes are rebuilt from the triple
+// table when the database is opened. Changes made within a transaction are
+// kept apart, as quads added and quads removed, which only the thread writing
+// sees; they are merged into the indexes once the transaction has committed,
+// and a log of them lets a savepoint be rolled back to. Readers take a shared
+// lock of the indexes, and do not wait for the database lock.
+
+class MemoryDB : public DB {
+public:
+  MemoryDB(char *name, bool verbose = false) MAYFAIL;
+  virtual ~MemoryDB(void) MAYFAIL { shutdown(); }
+  using DB::sources;
+  virtual TripleCursor *cursor(Node subject, Node predicate, Node object, Node source = NULL_NODE) MAYFAIL;
+  virtual int count(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual bool sources(Triple *triple, NodeAction *action) MAYFAIL;
+protected:
+  virtual bool stored(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual bool storedQuad(const Quad &quad) MAYFAIL;
+  virtual bool insertTriple(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual void deleteTriples(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual void committed(void);
+  virtual void rolledBack(void);
+  virtual void savepoint(const char *name) MAYFAIL;
+  virtual void releaseSavepoint(const char *name) MAYFAIL;
+  virtual void rollbackToSavepoint(const char *name) MAYFAIL;
+private:
+  enum { ADDED, REMOVED };
+  struct Change {
+    bool temporary;
+    int set;       // ADDED or REMOVED
+    bool inserted; // into the set, or else erased from it
+    Quad quad;
+  };
+  TripleIndex &triples(bool temporary) { return temporary ? _temporary : _triples; }
+  TripleIndex &pending(bool temporary, int set) { return _pending[temporary ? 1 : 0][set]; }
+  size_t match(bool temporary, int s, int p, int o, int src, std::vector<Quad> *out) MAYFAIL;
+  void change(bool temporary, int set, bool insert, const Quad &quad);
+  void undo(size_t mark);
+  void discard(void);
+  TripleIndex _triples;
+  TripleIndex _temporary;
+  mutex::RWLock _indexLock; // of _triples and _temporary
+  TripleIndex _pending[2][2]; // [temporary][ADDED or REMOVED], of the open transaction
+  std::vector<Change> _undo;
+  std::vector<size_t> _savepoints; // undo log length at each open savepoint
+};
+
+}
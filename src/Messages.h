@@ -45,6 +45,7 @@ namespace Piglet {
 #define Message(v, s) static const char *v = s
 
 Message(ERR_DB_OPEN,      "Unable to open database");
+Message(ERR_DB_CURRENT,   "No current database in this thread");
 Message(ERR_NODE_ID,      "Unable to create a new node ID");
 Message(ERR_NODE_DETAILS, "Unable to query for node details");
 Message(ERR_NODE_NEW,     "Unable to insert a new node");
@@ -59,7 +60,15 @@ Message(ERR_SRC_FIND,     "Unable to determine if source has been loaded before"
 Message(ERR_SRC_TIME,     "Unable to update load time");
 Message(ERR_SRC_DEL,      "Unable to update load time");
 Message(ERR_SRC_QUERY,    "Unable to find sources");
+Message(ERR_SRC_GRAPH,    "Unable to record the graphs of a source");
 Message(ERR_TRANSACTION,  "Transaction-related error");
+Message(ERR_DB_MIGRATE,   "Unable to upgrade database schema");
+Message(ERR_BULK,         "Unable to drop or rebuild triple indexes");
+Message(ERR_SNAPSHOT_OPEN,  "Unable to open snapshot");
+Message(ERR_SNAPSHOT_WRITE, "Unable to write snapshot");
+Message(ERR_SNAPSHOT_MISMATCH, "Snapshot was compiled from a different store");
+Message(ERR_SHARDS,       "Database was created with a different number of shards");
+Message(ERR_SHARDED_SQL,  "SQL queries over triples are not supported by sharded databases");
 
 #define PIGLET_DEBUG 0
 
@@ -38,37 +38,139 @@
  *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
  */
 
+#include <string.h>
+#include <sys/time.h>
 #include "Mutex.h"
 
 namespace mutex {
 
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000.0 + tv.tv_usec;
+}
+
 Mutex::Mutex(void) MAYFAIL
 {
   pthread_mutexattr_init(&_mutexattr);
   pthread_mutexattr_settype(&_mutexattr, PTHREAD_MUTEX_RECURSIVE);
   Piglet::check(pthread_mutex_init(&_mutex, &_mutexattr) == 0, "Mutex error");
+  _depth = 0;
+  _stats = NULL;
+  _site = NULL;
+  _since = 0;
 }
 
 Mutex::~Mutex(void) MAYFAIL
 {
+  delete _stats;
   Piglet::check(pthread_mutex_destroy(&_mutex) == 0, "Mutex error");
   pthread_mutexattr_destroy(&_mutexattr);
 }
 
-void Mutex::lock(void) MAYFAIL
+// Whether to time the wait is decided before the mutex is taken, and may
+// disagree with _stats by then; the counters themselves are only touched
+// while holding the mutex
+
+void Mutex::lock(const char *site) MAYFAIL
 {
-  Piglet::check(pthread_mutex_lock(&_mutex) == 0, "Mutex error");
+  if (_stats == NULL)
+    Piglet::check(pthread_mutex_lock(&_mutex) == 0, "Mutex error");
+  else if (pthread_mutex_trylock(&_mutex) == 0) {
+    if (_depth == 0)
+      acquired(site, false, 0);
+  }
+  else {
+    double start = now();
+    Piglet::check(pthread_mutex_lock(&_mutex) == 0, "Mutex error");
+    acquired(site, true, now() - start);
+  }
+  if (_depth == 0)
+    _owner = pthread_self();
+  _depth++;
 }
 
 void Mutex::unlock(void) MAYFAIL
 {
+  _depth--;
+  if ((_depth == 0) && (_site != NULL))
+    releasing();
+  Piglet::check(pthread_mutex_unlock(&_mutex) == 0, "Mutex error");
+}
+
+bool Mutex::held(void)
+{
+  return (_depth > 0) && pthread_equal(_owner, pthread_self());
+}
+
+void Mutex::acquired(const char *site, bool contended, double wait)
+{
+  if (_stats == NULL)
+    return;
+  std::vector<LockStats>::iterator i;
+  for (i = _stats->begin(); i != _stats->end(); i++)
+    if ((i->site == site) || (i->site && site && (strcmp(i->site, site) == 0)))
+      break;
+  if (i == _stats->end()) {
+    LockStats s = { site, 0, 0, 0, 0, 0, 0 };
+    i = _stats->insert(i, s);
+  }
+  i->acquisitions++;
+  if (contended) {
+    i->contended++;
+    i->waitTime += wait;
+    if (wait > i->maxWait)
+      i->maxWait = wait;
+  }
+  _site = &*i;
+  _since = now();
+}
+
+void Mutex::releasing(void)
+{
+  if (_stats != NULL) {
+    double hold = now() - _since;
+    _site->holdTime += hold;
+    if (hold > _site->maxHold)
+      _site->maxHold = hold;
+  }
+  _site = NULL;
+}
+
+// These lock the mutex without counting it, or naming themselves its owner
+
+void Mutex::instrument(bool on) MAYFAIL
+{
+  Piglet::check(pthread_mutex_lock(&_mutex) == 0, "Mutex error");
+  if (on) {
+    if (_stats == NULL)
+      _stats = new std::vector<LockStats>;
+    else
+      _stats->clear();
+  }
+  else {
+    delete _stats;
+    _stats = NULL;
+  }
+  _site = NULL; // an acquisition under way is not counted
   Piglet::check(pthread_mutex_unlock(&_mutex) == 0, "Mutex error");
 }
 
-MutexLock::MutexLock(Mutex *mutex) MAYFAIL
+void Mutex::stats(std::vector<LockStats> &stats) MAYFAIL
+{
+  Piglet::check(pthread_mutex_lock(&_mutex) == 0, "Mutex error");
+  if (_stats)
+    stats = *_stats;
+  else
+    stats.clear();
+  Piglet::check(pthread_mutex_unlock(&_mutex) == 0, "Mutex error");
+}
+
+MutexLock::MutexLock(Mutex *mutex, const char *site) MAYFAIL
 {
   _mutex = mutex;
-  _mutex->lock();
+  _mutex->lock(site);
 }
 
 MutexLock::~MutexLock(void) MAYFAIL
@@ -76,4 +178,51 @@ MutexLock::~MutexLock(void) MAYFAIL
   _mutex->unlock();
 }
 
+RWLock::RWLock(void) MAYFAIL
+{
+  Piglet::check(pthread_rwlock_init(&_lock, NULL) == 0, "Mutex error");
+}
+
+RWLock::~RWLock(void) MAYFAIL
+{
+  Piglet::check(pthread_rwlock_destroy(&_lock) == 0, "Mutex error");
+}
+
+void RWLock::readLock(void) MAYFAIL
+{
+  Piglet::check(pthread_rwlock_rdlock(&_lock) == 0, "Mutex error");
+}
+
+void RWLock::writeLock(void) MAYFAIL
+{
+  Piglet::check(pthread_rwlock_wrlock(&_lock) == 0, "Mutex error");
+}
+
+void RWLock::unlock(void) MAYFAIL
+{
+  Piglet::check(pthread_rwlock_unlock(&_lock) == 0, "Mutex error");
+}
+
+ReadLock::ReadLock(RWLock *lock) MAYFAIL
+{
+  _lock = lock;
+  _lock->readLock();
+}
+
+ReadLock::~ReadLock(void) MAYFAIL
+{
+  _lock->unlock();
+}
+
+WriteLock::WriteLock(RWLock *lock) MAYFAIL
+{
+  _lock = lock;
+  _lock->writeLock();
+}
+
+WriteLock::~WriteLock(void) MAYFAIL
+{
+  _lock->unlock();
+}
+
 }
@@ -41,27 +41,85 @@
 #pragma once
 
 #include <pthread.h>
+#include <vector>
 #include "Condition.h"
 
 namespace mutex {
 
+// Counters of an instrumented mutex for one call site, i.e. the site named
+// when it was locked at the outermost level (NULL if none was); times are in
+// microseconds
+
+struct LockStats {
+  const char *site;
+  unsigned long acquisitions;
+  unsigned long contended;
+  double waitTime;
+  double maxWait;
+  double holdTime;
+  double maxHold;
+};
+
+// Instrumentation is off by default, and then costs a test per lock and
+// unlock. Sites are compared as strings, but must stay valid (use literals).
+
 class Mutex {
 public:
   Mutex(void) MAYFAIL;
   ~Mutex(void) MAYFAIL;
-  void lock(void) MAYFAIL;
+  void lock(const char *site = NULL) MAYFAIL;
   void unlock(void) MAYFAIL;
+  bool held(void); // true if locked by the calling thread
+  void instrument(bool on) MAYFAIL; // turning it on clears the counters
+  bool instrumented(void) const { return _stats != NULL; }
+  void stats(std::vector<LockStats> &stats) MAYFAIL;
 private:
+  void acquired(const char *site, bool contended, double wait);
+  void releasing(void);
   pthread_mutex_t _mutex;
+  pthread_t _owner;
+  int _depth;
   pthread_mutexattr_t _mutexattr;
+  std::vector<LockStats> *_stats;
+  LockStats *_site; // of the current outermost acquisition, if instrumented
+  double _since;
 };
 
 class MutexLock {
 public:
-  MutexLock(Mutex *mutex) MAYFAIL;
+  MutexLock(Mutex *mutex, const char *site = NULL) MAYFAIL;
   ~MutexLock(void) MAYFAIL;
 private:
   Mutex *_mutex;
 };
 
+// Many readers or one writer; not recursive, so keep the locked regions short
+
+class RWLock {
+public:
+  RWLock(void) MAYFAIL;
+  ~RWLock(void) MAYFAIL;
+  void readLock(void) MAYFAIL;
+  void writeLock(void) MAYFAIL;
+  void unlock(void) MAYFAIL;
+private:
+  pthread_rwlock_t _lock;
+};
+
+class ReadLock {
+public:
+  ReadLock(RWLock *lock) MAYFAIL;
+  ~ReadLock(void) MAYFAIL;
+private:
+  RWLock *_lock;
+};
+
+class WriteLock {
+public:
+  WriteLock(RWLock *lock) MAYFAIL;
+  ~WriteLock(void) MAYFAIL;
+private:
+  RWLock *_lock;
+};
+
 }
@@ -0,0 +1,592 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  NTriplesParser.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <iostream>
+#include "NTriplesParser.h"
+#include "ThreadPool.h"
+#include "LoadJob.h"
+#include "Curl.h"
+
+namespace Piglet {
+
+static const size_t SEGMENT_BYTES = 1 << 20; // tokenized as one task
+static const size_t READ_BYTES = 1 << 16;    // read at a time from streams
+
+static inline bool blank(char c)
+{
+  return (c == ' ') || (c == '\t') || (c == '\r');
+}
+
+static int hex(char c)
+{
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  if ((c >= 'a') && (c <= 'f')) return c - 'a' + 10;
+  if ((c >= 'A') && (c <= 'F')) return c - 'A' + 10;
+  return -1;
+}
+
+// Decodes the hex digits of \u or \U at r into UTF-8 at w; an escape is always
+// longer than its encoding, so w never overtakes r
+
+static bool unicode(char *&r, char *eol, int digits, char *&w)
+{
+  if (eol - r < digits)
+    return false;
+  unsigned long c = 0;
+  for (int i = 0; i < digits; i++) {
+    int h = hex(r[i]);
+    if (h < 0)
+      return false;
+    c = (c << 4) | h;
+  }
+  r += digits;
+  if (c < 0x80)
+    *w++ = (char)c;
+  else if (c < 0x800) {
+    *w++ = (char)(0xC0 | (c >> 6));
+    *w++ = (char)(0x80 | (c & 0x3F));
+  }
+  else if (c < 0x10000) {
+    *w++ = (char)(0xE0 | (c >> 12));
+    *w++ = (char)(0x80 | ((c >> 6) & 0x3F));
+    *w++ = (char)(0x80 | (c & 0x3F));
+  }
+  else if (c < 0x110000) {
+    *w++ = (char)(0xF0 | (c >> 18));
+    *w++ = (char)(0x80 | ((c >> 12) & 0x3F));
+    *w++ = (char)(0x80 | ((c >> 6) & 0x3F));
+    *w++ = (char)(0x80 | (c & 0x3F));
+  }
+  else
+    return false;
+  return true;
+}
+
+// Scans the terms of one line. IRIs and literals end in a delimiter that the
+// terminating NUL can take the place of; labels and language tags do not, so
+// they are moved back over their prefix first, keeping the next token intact.
+
+class NTriplesLine {
+public:
+  NTriplesLine(char *line, char *eol) : p(line), eol(eol), error(NULL) {}
+  void skip(void) { while ((p < eol) && blank(*p)) p++; }
+  bool at(char c) { return (p < eol) && (*p == c); }
+  bool term(NTerm &t, bool bnode, bool literal);
+  bool fail(const char *message) { error = message; return false; }
+  char *p;
+  char *eol;
+  const char *error;
+private:
+  bool iri(const char *&str);
+  bool label(const char *&str);
+  bool literal(NTerm &t);
+};
+
+bool NTriplesLine::term(NTerm &t, bool bnode, bool literal)
+{
+  skip();
+  t.datatype = NULL;
+  t.lang = NULL;
+  if (at('<')) {
+    t.kind = ParsedTerm::RESOURCE;
+    return iri(t.str);
+  }
+  else if (bnode && at('_')) {
+    t.kind = ParsedTerm::BNODE;
+    return label(t.str);
+  }
+  else if (literal && at('"')) {
+    t.kind = ParsedTerm::LITERAL;
+    return this->literal(t);
+  }
+  else
+    return fail(p < eol ? "Unexpected character" : "Unexpected end of line");
+}
+
+bool NTriplesLine::iri(const char *&str)
+{
+  char *w = ++p;
+  str = w;
+  while (p < eol) {
+    char c = *p++;
+    if (c == '>') {
+      *w = 0;
+      return true;
+    }
+    else if (c == '\\') {
+      if (!at('u') && !at('U'))
+        return fail("Bad escape in IRI");
+      int digits = (*p++ == 'u') ? 4 : 8;
+      if (!unicode(p, eol, digits, w))
+        return fail("Bad escape in IRI");
+    }
+    else if (((unsigned char)c <= ' ') || (c == '<') || (c == '"'))
+      return fail("Bad character in IRI");
+    else
+      *w++ = c;
+  }
+  return fail("Unterminated IRI");
+}
+
+bool NTriplesLine::label(const char *&str)
+{
+  if ((eol - p < 2) || (p[1] != ':'))
+    return fail("Bad blank node");
+  char *start = p + 2, *end = start;
+  while ((end < eol) && !blank(*end) && (*end != '<') && (*end != '"') && (*end != '#'))
+    end++;
+  while ((end > start) && (end[-1] == '.')) // a label does not end in a period
+    end--;
+  if (end == start)
+    return fail("Empty blank node label");
+  memmove(p, start, end - start);
+  p[end - start] = 0;
+  str = p;
+  p = end;
+  return true;
+}
+
+bool NTriplesLine::literal(NTerm &t)
+{
+  char *w = ++p;
+  t.str = w;
+  for (;;) {
+    if (p >= eol)
+      return fail("Unterminated literal");
+    char c = *p++;
+    if (c == '"')
+      break;
+    else if (c == '\\') {
+      if (p >= eol)
+        return fail("Unterminated literal");
+      switch (c = *p++) {
+        case 't': *w++ = '\t'; break;
+        case 'b': *w++ = '\b'; break;
+        case 'n': *w++ = '\n'; break;
+        case 'r': *w++ = '\r'; break;
+        case 'f': *w++ = '\f'; break;
+        case '"': case '\'': case '\\': *w++ = c; break;
+        case 'u': case 'U':
+          if (!unicode(p, eol, (c == 'u') ? 4 : 8, w))
+            return fail("Bad escape in literal");
+          break;
+        default:
+          return fail("Bad escape in literal");
+      }
+    }
+    else
+      *w++ = c;
+  }
+  *w = 0;
+  if ((eol - p >= 2) && (p[0] == '^') && (p[1] == '^')) {
+    p += 2;
+    if (!at('<'))
+      return fail("Datatype must be an IRI");
+    return iri(t.datatype);
+  }
+  else if (at('@')) {
+    char *start = p + 1, *end = start;
+    while ((end < eol) && (isalnum((unsigned char)*end) || (*end == '-')))
+      end++;
+    if (end == start)
+      return fail("Empty language tag");
+    memmove(p, start, end - start);
+    p[end - start] = 0;
+    t.lang = p;
+    p = end;
+  }
+  return true;
+}
+
+bool NTriplesParser::tokenize(char *begin, char *end, bool quads,
+                              std::vector<NStatement> &statements, size_t &lines,
+                              std::string &error)
+{
+  lines = 0;
+  for (char *p = begin; p < end; ) {
+    char *eol = (char *)memchr(p, '\n', end - p);
+    if (eol == NULL)
+      eol = end;
+    lines++;
+    NTriplesLine line(p, eol);
+    line.skip();
+    if ((line.p < eol) && (*line.p != '#')) {
+      NStatement s;
+      s.g.str = NULL;
+      bool ok = (line.term(s.s, true, false) &&
+                 line.term(s.p, false, false) &&
+                 line.term(s.o, true, true));
+      if (ok) {
+        line.skip();
+        if (!line.at('.')) {
+          if (!quads)
+            ok = line.fail("Expected '.'");
+          else if (line.term(s.g, true, false))
+            line.skip();
+          else
+            ok = false;
+        }
+      }
+      if (ok && !line.at('.'))
+        ok = line.fail("Expected '.'");
+      if (ok) {
+        line.p++;
+        line.skip();
+        if ((line.p < eol) && (*line.p != '#'))
+          ok = line.fail("Unexpected text after statement");
+      }
+      if (!ok) {
+        error = line.error;
+        return false;
+      }
+      statements.push_back(s);
+    }
+    p = eol + 1;
+  }
+  return true;
+}
+
+// One line-aligned piece of a buffer, tokenized on a thread of the pool
+
+class NTriplesSegment : public Task {
+public:
+  NTriplesSegment(char *begin, char *end, bool quads)
+    : begin(begin), end(end), quads(quads), ok(true), lines(0) {}
+  void run(void) MAYFAIL
+  {
+    ok = NTriplesParser::tokenize(begin, end, quads, statements, lines, error);
+  }
+  char *begin;
+  char *end;
+  bool quads;
+  bool ok;
+  size_t lines;
+  std::string error;
+  std::vector<NStatement> statements;
+};
+
+NTriplesParser::NTriplesParser(DB *db, Syntax syntax, ParsedTripleSink *sink, int threads)
+  : Parser(db, sink)
+{
+  _syntax = syntax;
+  _threads = threads;
+  _pool = NULL;
+  _lines = 0;
+}
+
+NTriplesParser::~NTriplesParser(void)
+{
+  delete _pool;
+}
+
+NTriplesParser::Syntax NTriplesParser::syntax(const char *uri)
+{
+  if (uri == NULL)
+    return NONE;
+  size_t n = strcspn(uri, "?#");
+  if ((n >= 3) && (strncasecmp(uri + n - 3, ".nt", 3) == 0))
+    return NTRIPLES;
+  else if ((n >= 3) && (strncasecmp(uri + n - 3, ".nq", 3) == 0))
+    return NQUADS;
+  else
+    return NONE;
+}
+
+ThreadPool *NTriplesParser::pool(void) MAYFAIL
+{
+  if ((_pool == NULL) && (_threads > 0)) {
+    _pool = new ThreadPool(_threads);
+    if (_pool->size() == 0) { // tokenize on the calling thread instead
+      delete _pool;
+      _pool = NULL;
+      _threads = 0;
+    }
+  }
+  return _pool;
+}
+
+static size_t received(char *data, size_t size, size_t n, NTriplesParser *parser)
+{
+  try {
+    return parser->parseChunk((const unsigned char *)data, size * n) ? size * n : 0;
+  }
+  catch (Condition &c) {
+    parser->terminate(c.message());
+    return 0;
+  }
+}
+
+bool NTriplesParser::parse(Node source) MAYFAIL
+{
+  std::string u(sourceURI(source));
+  if (strncmp(u.c_str(), "file://", 7) == 0) {
+    FILE *stream = fopen(u.c_str() + 7, "r");
+    if (stream == NULL) {
+      _source = source;
+      terminate(("Unable to open " + u).c_str());
+      return false;
+    }
+    bool result = parse(source, stream);
+    fclose(stream);
+    return result;
+  }
+  parseBegin(source);
+  libcurl::Curl curl;
+  curl.setURL(u.c_str());
+  curl.setOption(libcurl::CURLOPT_FOLLOWLOCATION, (void *)1);
+  curl.setOption(libcurl::CURLOPT_FAILONERROR, (void *)1);
+  curl.setOption(libcurl::CURLOPT_NOSIGNAL, (void *)1);
+  curl.setOption(libcurl::CURLOPT_WRITEFUNCTION, (void *)received);
+  curl.setOption(libcurl::CURLOPT_WRITEDATA, this);
+  if (!curl.perform() && !_terminated)
+    terminate(("Unable to retrieve " + u).c_str());
+  return parseEnd();
+}
+
+// Regular files are mapped copy-on-write, so tokenizing in place leaves them
+// untouched; pipes and the like are read a chunk at a time. The stream is
+// kept positioned after what has been written, for LoadJob to report.
+
+bool NTriplesParser::parse(Node source, FILE *stream) MAYFAIL
+{
+  parseBegin(source);
+  struct stat st;
+  long offset = ftell(stream);
+  bool regular = ((offset >= 0) && (fstat(fileno(stream), &st) == 0) && S_ISREG(st.st_mode));
+  if (regular && (st.st_size <= offset))
+    return parseEnd(); // nothing left to read
+  if (regular) {
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(stream), 0);
+    if (map != MAP_FAILED) {
+      madvise(map, size, MADV_SEQUENTIAL);
+      try {
+        parseBuffer((char *)map + offset, (char *)map + size, stream);
+      }
+      catch (Condition &c) {
+        munmap(map, size);
+        throw;
+      }
+      munmap(map, size);
+      return !_terminated;
+    }
+  }
+  char buffer[READ_BYTES];
+  size_t n;
+  while (!_terminated && ((n = fread(buffer, 1, sizeof(buffer), stream)) > 0))
+    parseChunk((const unsigned char *)buffer, n);
+  return parseEnd();
+}
+
+bool NTriplesParser::parse(Node source, unsigned char *content) MAYFAIL
+{
+  return (parseBegin(source) &&
+          parseChunk(content, strlen((const char *)content)) &&
+          parseEnd());
+}
+
+bool NTriplesParser::parseBegin(Node source) MAYFAIL
+{
+  begin(source);
+  _lines = 0;
+  _pending.clear();
+  return true;
+}
+
+bool NTriplesParser::parseChunk(const unsigned char *data, size_t length) MAYFAIL
+{
+  if (_terminated)
+    return false;
+  _pending.append((const char *)data, length);
+  size_t last = _pending.rfind('\n');
+  if (last != std::string::npos) {
+    parseBuffer(&_pending[0], &_pending[0] + last + 1, NULL);
+    _pending.erase(0, last + 1);
+  }
+  return !_terminated;
+}
+
+bool NTriplesParser::parseEnd(void) MAYFAIL
+{
+  if (!_terminated && !_pending.empty())
+    parseBuffer(&_pending[0], &_pending[0] + _pending.size(), NULL);
+  _pending.clear();
+  return !_terminated;
+}
+
+void NTriplesParser::terminate(const char *message)
+{
+  _terminated = true;
+  _error = message;
+  std::cout << "Parser terminated with message\n" << message;
+}
+
+// Cuts as many segments off the front of [begin, end) as there are threads to
+// tokenize them; returns where the next segment begins
+
+char *NTriplesParser::cut(char *begin, char *end, std::vector<NTriplesSegment *> &segments)
+{
+  size_t n = (_pool != NULL) ? (size_t)_pool->size() : 1;
+  while ((begin < end) && (segments.size() < n)) {
+    char *stop = end;
+    if ((size_t)(end - begin) > SEGMENT_BYTES) {
+      stop = (char *)memchr(begin + SEGMENT_BYTES, '\n', end - begin - SEGMENT_BYTES);
+      stop = (stop != NULL) ? stop + 1 : end;
+    }
+    segments.push_back(new NTriplesSegment(begin, stop, _syntax == NQUADS));
+    begin = stop;
+  }
+  return begin;
+}
+
+bool NTriplesParser::parseBuffer(char *begin, char *end, FILE *stream) MAYFAIL
+{
+  ThreadPool *threads = pool();
+  std::vector<NTriplesSegment *> current, next;
+  std::vector<Task *> tasks;
+  ThreadPool::Batch *running = NULL;
+  long offset = stream ? ftell(stream) : 0;
+  char *p = cut(begin, end, current);
+  try {
+    if (threads) {
+      tasks.assign(current.begin(), current.end());
+      running = threads->submit(tasks);
+    }
+    while (!current.empty()) {
+      if (threads) {
+        ThreadPool::Batch *batch = running;
+        running = NULL;
+        threads->wait(batch);
+      }
+      else
+        current[0]->run();
+      char *written = p;
+      if (!_terminated) {
+        p = cut(p, end, next);
+        if (threads && !next.empty()) {
+          tasks.assign(next.begin(), next.end());
+          running = threads->submit(tasks);
+        }
+      }
+      for (size_t i = 0; i < current.size(); i++) {
+        if (!_terminated)
+          emit(current[i]);
+        delete current[i];
+        current[i] = NULL;
+      }
+      current.swap(next);
+      next.clear();
+      if (stream && !_terminated)
+        fseek(stream, offset + (written - begin), SEEK_SET);
+    }
+  }
+  catch (Condition &c) {
+    if (running) {
+      try { threads->wait(running); } catch (Condition &) {}
+    }
+    for (size_t i = 0; i < current.size(); i++)
+      delete current[i];
+    for (size_t i = 0; i < next.size(); i++)
+      delete next[i];
+    throw;
+  }
+  return !_terminated;
+}
+
+void NTriplesParser::emit(NTriplesSegment *segment) MAYFAIL
+{
+  for (size_t i = 0; (i < segment->statements.size()) && !_terminated; i++)
+    emit(segment->statements[i]);
+  if (!segment->ok && !_terminated) {
+    char message[256];
+    snprintf(message, sizeof(message), "Syntax error at line %lu: %s",
+             (unsigned long)(_lines + segment->lines), segment->error.c_str());
+    terminate(message);
+  }
+  _lines += segment->lines;
+}
+
+static void parsed_term(ParsedTerm &term, const NTerm &from)
+{
+  term.kind = from.kind;
+  term.str = from.str;
+  term.datatype = from.datatype ? from.datatype : "";
+  term.lang = from.lang ? from.lang : "";
+}
+
+Node NTriplesParser::node(const NTerm &term) MAYFAIL
+{
+  switch (term.kind) {
+    case ParsedTerm::RESOURCE:
+      return db()->node(term.str);
+    case ParsedTerm::BNODE:
+      return bnode(term.str);
+    default:
+      return db()->literal(term.str, term.datatype ? db()->node(term.datatype) : NULL_NODE,
+                           term.lang);
+  }
+}
+
+void NTriplesParser::emit(const NStatement &statement) MAYFAIL
+{
+  if (_sink) {
+    ParsedTriple t;
+    parsed_term(t.s, statement.s);
+    parsed_term(t.p, statement.p);
+    parsed_term(t.o, statement.o);
+    if (statement.g.str)
+      parsed_term(t.g, statement.g);
+    _sink->triple(t);
+    return;
+  }
+  Triple t(node(statement.s), node(statement.p), node(statement.o));
+  bool inserted = (db()->addToGraph(&t, statement.g.str ? node(statement.g) : _source,
+                                    _source) != NULL);
+  if (_job && !_job->triple(inserted) && !_terminated)
+    terminate("Load cancelled");
+}
+
+}
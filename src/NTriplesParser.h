@@ -0,0 +1,105 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  NTriplesParser.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include "Parser.h"
+
+namespace Piglet {
+
+class ThreadPool;
+class NTriplesSegment;
+
+// A term as it lies in the buffer it was parsed from: the buffer is unescaped
+// and NUL-terminated in place, so terms reach the dictionary uncopied.
+
+struct NTerm {
+  ParsedTerm::Kind kind;
+  const char *str;
+  const char *datatype; // literals only, NULL if none
+  const char *lang;     // literals only, NULL if none
+};
+
+struct NStatement {
+  NTerm s, p, o;
+  NTerm g; // graph label of a quad, str NULL if none
+};
+
+// Parses N-Triples and N-Quads without Raptor. Files are mapped privately and
+// tokenized where they lie, in line-aligned segments: with threads, segments
+// are tokenized on a pool while the calling thread writes the statements of
+// the previous ones, in file order. Other content is tokenized as it arrives.
+// The graph label of a quad becomes the source of its triple.
+
+class NTriplesParser : public Parser {
+public:
+  enum Syntax { NONE, NTRIPLES, NQUADS };
+  NTriplesParser(DB *db, Syntax syntax, ParsedTripleSink *sink = NULL, int threads = 0);
+  ~NTriplesParser(void);
+  bool parse(Node source) MAYFAIL;
+  bool parse(Node source, FILE *stream) MAYFAIL;
+  bool parse(Node source, unsigned char *content) MAYFAIL;
+  bool parseBegin(Node source) MAYFAIL;
+  bool parseChunk(const unsigned char *data, size_t length) MAYFAIL;
+  bool parseEnd(void) MAYFAIL;
+  void terminate(const char *message);
+  static Syntax syntax(const char *uri); // from the extension, NONE if neither
+  // Tokenizes the lines in [begin, end), the last of which need not end in a
+  // newline. Returns false at the first syntax error; lines is the number of
+  // lines tokenized, that one included.
+  static bool tokenize(char *begin, char *end, bool quads, std::vector<NStatement> &statements,
+                       size_t &lines, std::string &error);
+private:
+  bool parseBuffer(char *begin, char *end, FILE *stream) MAYFAIL;
+  char *cut(char *begin, char *end, std::vector<NTriplesSegment *> &segments);
+  void emit(NTriplesSegment *segment) MAYFAIL;
+  void emit(const NStatement &statement) MAYFAIL;
+  Node node(const NTerm &term) MAYFAIL;
+  ThreadPool *pool(void) MAYFAIL;
+  Syntax _syntax;
+  int _threads;
+  ThreadPool *_pool;
+  size_t _lines;        // lines written so far
+  std::string _pending; // incomplete last line of the chunks so far
+};
+
+}
@@ -40,17 +40,22 @@
 
 #include "Node.h"
 #include "DB.h"
+#include "Messages.h"
 
 namespace Piglet {
 
 Node::Node(const char *uri) MAYFAIL
 {
-  _id = id(DB::current()->node(uri));
+  DB *db = DB::current();
+  check(db != NULL, ERR_DB_CURRENT);
+  _id = id(db->node(uri));
 }
 
-std::ostream& operator<<(std::ostream& os, const Node n)
+std::ostream& operator<<(std::ostream& os, const Node n) MAYFAIL
 {
-  os << temp(DB::current()->toString(n));
+  DB *db = DB::current();
+  check(db != NULL, ERR_DB_CURRENT);
+  os << temp(db->toString(n));
   return os;
 }
 
@@ -63,7 +63,7 @@ public:
   int _id;
 };
 
-std::ostream& operator<<(std::ostream& os, const Node n);
+std::ostream& operator<<(std::ostream& os, const Node n) MAYFAIL; // prints with DB::current()
 
 static const Node NULL_NODE = 0;
 
@@ -0,0 +1,200 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  NodeCache.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include "NodeCache.h"
+
+namespace Piglet {
+
+NodeCache::NodeCache(size_t capacity)
+{
+  _capacity = capacity;
+  _epoch = 0;
+  _stale = false;
+  _hits = 0;
+  _misses = 0;
+}
+
+int NodeCache::find(const std::string &key, bool uncommitted)
+{
+  {
+    mutex::ReadLock lock(&_lock);
+    Map::iterator i;
+    if (uncommitted && ((i = _pending.find(key)) != _pending.end()))
+      return hit(i->second);
+    if ((i = _current.find(key)) != _current.end())
+      return hit(i->second);
+    if (_previous.find(key) == _previous.end())
+      return miss();
+  }
+  // promoting needs the lock to ourselves, and the entry may have moved since
+  mutex::WriteLock lock(&_lock);
+  Map::iterator i = _previous.find(key);
+  if (i == _previous.end()) {
+    i = _current.find(key);
+    return (i != _current.end()) ? hit(i->second) : miss();
+  }
+  int id = i->second;
+  _previous.erase(i);
+  store(key, id);
+  return hit(id);
+}
+
+void NodeCache::store(const std::string &key, int id)
+{
+  if (_current.size() >= (_capacity + 1) / 2) {
+    _previous.clear();
+    _previous.swap(_current);
+  }
+  _current[key] = id;
+}
+
+void NodeCache::insert(const std::string &key, int id, bool pending)
+{
+  mutex::WriteLock lock(&_lock);
+  if (_capacity == 0)
+    return;
+  if (pending) {
+    if (_pending.size() < _capacity) // beyond that, simply not cached
+      _pending[key] = id;
+  }
+  else {
+    _previous.erase(key);
+    store(key, id);
+  }
+}
+
+// A thread that is not writing may fill in an entry it looked up in committed
+// data. Any erase since it took the epoch (or the commit following one) means
+// that what it read may already be out of date, and the entry is dropped.
+
+unsigned long NodeCache::epoch(void)
+{
+  mutex::ReadLock lock(&_lock);
+  return _epoch;
+}
+
+void NodeCache::fill(const std::string &key, int id, unsigned long epoch)
+{
+  mutex::WriteLock lock(&_lock);
+  if ((_capacity == 0) || (epoch != _epoch))
+    return;
+  _previous.erase(key);
+  store(key, id);
+}
+
+void NodeCache::erase(const std::string &key)
+{
+  mutex::WriteLock lock(&_lock);
+  _current.erase(key);
+  _previous.erase(key);
+  _pending.erase(key);
+  _epoch++;
+  _stale = true;
+}
+
+void NodeCache::clear(void)
+{
+  mutex::WriteLock lock(&_lock);
+  reset();
+}
+
+void NodeCache::reset(void)
+{
+  _current.clear();
+  _previous.clear();
+  _pending.clear();
+  _epoch++;
+  _stale = false;
+}
+
+void NodeCache::commit(void)
+{
+  mutex::WriteLock lock(&_lock);
+  for (Map::iterator i = _pending.begin(); i != _pending.end(); i++) {
+    _previous.erase(i->first);
+    store(i->first, i->second);
+  }
+  _pending.clear();
+  if (_stale) {
+    _epoch++;
+    _stale = false;
+  }
+}
+
+void NodeCache::rollback(void)
+{
+  mutex::WriteLock lock(&_lock);
+  _pending.clear();
+}
+
+void NodeCache::setCapacity(size_t capacity)
+{
+  mutex::WriteLock lock(&_lock);
+  _capacity = capacity;
+  reset();
+}
+
+size_t NodeCache::size(void) const
+{
+  mutex::ReadLock lock(&_lock);
+  return _current.size() + _previous.size() + _pending.size();
+}
+
+std::string NodeCache::uriKey(const char *uri)
+{
+  return std::string(uri);
+}
+
+std::string NodeCache::literalKey(const char *str, int datatype, const char *lang)
+{
+  // The datatype and language go first, terminated by NUL, so that no
+  // literal string can make two different keys collide
+  char prefix[24];
+  sprintf(prefix, "%d@", datatype);
+  std::string key(prefix);
+  if (lang)
+    key.append(lang);
+  key.append(1, '\0');
+  key.append(str);
+  return key;
+}
+
+}
@@ -0,0 +1,98 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  NodeCache.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <tr1/unordered_map>
+#include "Mutex.h"
+
+namespace Piglet {
+
+// Bounded, write-through map from dictionary keys (URIs, literals, blank node
+// labels) to node IDs. Two generations approximate LRU: when the current one
+// fills up it becomes the previous one, and entries still in use get promoted.
+// Insertions made while a transaction is open are kept apart until it is
+// committed, and only finds asking for uncommitted entries (i.e. those of the
+// writing thread) see them; a rollback forgets them. The cache may be used
+// from several threads at once, finds that hit only take a shared lock.
+
+class NodeCache {
+public:
+  NodeCache(size_t capacity = 100000);
+  int find(const std::string &key, bool uncommitted = true);
+  void insert(const std::string &key, int id, bool pending = false);
+  unsigned long epoch(void);
+  void fill(const std::string &key, int id, unsigned long epoch);
+  void erase(const std::string &key);
+  void clear(void);
+  void commit(void);
+  void rollback(void);
+  size_t capacity(void) const { return _capacity; }
+  void setCapacity(size_t capacity);
+  size_t size(void) const;
+  unsigned long hits(void) const { return _hits; }
+  unsigned long misses(void) const { return _misses; }
+  static std::string uriKey(const char *uri);
+  static std::string literalKey(const char *str, int datatype, const char *lang);
+private:
+  typedef std::tr1::unordered_map<std::string, int> Map;
+  void store(const std::string &key, int id);
+  void reset(void);
+  int hit(int id) { __sync_fetch_and_add(&_hits, 1); return id; }
+  int miss(void) { __sync_fetch_and_add(&_misses, 1); return 0; }
+  Map _current;
+  Map _previous;
+  Map _pending;
+  size_t _capacity;
+  unsigned long _epoch;
+  bool _stale;
+  unsigned long _hits;
+  unsigned long _misses;
+  mutable mutex::RWLock _lock;
+};
+
+// Unbounded map from the blank node labels of one load to node IDs; labels are
+// local to a document, so loads keep their own instead of sharing a NodeCache
+
+typedef std::tr1::unordered_map<std::string, int> BNodeMap;
+
+}
@@ -0,0 +1,125 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  NodeSequence.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include "NodeSequence.h"
+
+namespace Piglet {
+
+NodeSequence::NodeSequence(void)
+{
+  _high = _highLimit = 0;
+  _low = _lowLimit = 0;
+  _leased = false;
+}
+
+int NodeSequence::reserveNodes(int n) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  if (!_leased && (_high + n > _highLimit))
+    return 0;
+  int first = _high + 1;
+  _high += n;
+  return first;
+}
+
+int NodeSequence::reserveLiterals(int n) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  if (!_leased && (_low - n < _lowLimit))
+    return 0;
+  int first = _low - 1;
+  _low -= n;
+  return first;
+}
+
+void NodeSequence::raise(int high, int low) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  if (high > _high)
+    _high = high;
+  if (low < _low)
+    _low = low;
+}
+
+void NodeSequence::grant(int high, int low, int blockSize) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  _high = high - blockSize;
+  _highLimit = high;
+  _low = low + blockSize;
+  _lowLimit = low;
+}
+
+void NodeSequence::lease(int high, int low) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  if (high > _high)
+    _high = high;
+  if (low < _low)
+    _low = low;
+  _leased = true;
+}
+
+// What is left of a block before the lease began is not returned to it
+
+void NodeSequence::endLease(void) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  if (_leased) {
+    _leased = false;
+    _highLimit = _high;
+    _lowLimit = _low;
+  }
+}
+
+bool NodeSequence::leased(void) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  return _leased;
+}
+
+void NodeSequence::watermarks(int *high, int *low) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex);
+  *high = _high;
+  *low = _low;
+}
+
+}
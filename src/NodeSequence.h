@@ -0,0 +1,78 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  NodeSequence.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include "Mutex.h"
+
+namespace Piglet {
+
+// Hands out node IDs from memory. Resources and blank nodes count upwards,
+// literals count downwards. The IDs come from the watermarks kept in the
+// sequence table, which the DB reserves them from in one of two ways: outside
+// of a transaction a block at a time, committed right away; within one by a
+// lease that lasts until the transaction ends, the watermarks being written
+// back just before it commits. An allocation that finds neither a block nor a
+// lease returns 0, and the DB reserves more. IDs taken by rolled back
+// transactions are simply never reused by this sequence.
+
+class NodeSequence {
+public:
+  NodeSequence(void);
+  int nextNode(void) MAYFAIL { return reserveNodes(1); }
+  int nextLiteral(void) MAYFAIL { return reserveLiterals(1); }
+  int reserveNodes(int n) MAYFAIL;    // block is [first, first + n)
+  int reserveLiterals(int n) MAYFAIL; // block is (first - n, first]
+  void raise(int high, int low) MAYFAIL; // never hand out IDs in [low, high]
+  void grant(int high, int low, int blockSize) MAYFAIL; // block ending at the new watermarks
+  void lease(int high, int low) MAYFAIL;
+  void endLease(void) MAYFAIL;
+  bool leased(void) MAYFAIL;
+  void watermarks(int *high, int *low) MAYFAIL;
+private:
+  mutex::Mutex _mutex;
+  int _high;      // last ID handed out
+  int _low;
+  int _highLimit; // last ID of the block
+  int _lowLimit;
+  bool _leased;
+};
+
+}
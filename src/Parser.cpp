@@ -39,27 +39,66 @@
  */
 
 #include "Parser.h"
+#include "LoadJob.h"
 #include <cstdio>
 #include <iostream>
 #include <unistd.h>
 
 namespace Piglet {
 
-Parser::Parser(DB *db)
+Parser::Parser(DB *db, ParsedTripleSink *sink)
 {
   _source = NULL_NODE;
   _db = db;
+  _sink = sink;
+  _job = NULL;
+  _terminated = false;
+}
+
+// Called as a parse begins; labels of an earlier parse name other nodes
+
+void Parser::begin(Node source)
+{
+  _terminated = false;
+  _error.clear();
+  _source = source;
+  _bnodes.clear();
+}
+
+Node Parser::bnode(const char *label) MAYFAIL
+{
+  std::string key(label);
+  BNodeMap::iterator i = _bnodes.find(key);
+  if (i != _bnodes.end())
+    return Node(i->second);
+  Node n = db()->node(NULL); // a new ID from the sequence, and a node without a string
+  _bnodes[key] = id(n);
+  return n;
+}
+
+std::string Parser::sourceURI(Node source) MAYFAIL
+{
+  if (!_sourceURI.empty())
+    return _sourceURI;
+  TemporaryString uri(db()->info(source));
+  return uri.string();
 }
 
 void Parser::addNamespace(const char *prefix, const char *uri) MAYFAIL
 {
-  db()->addNamespace(prefix, uri);
+  if (_sink)
+    _sink->addNamespace(prefix, uri);
+  else
+    db()->addNamespace(prefix, uri);
 }
 
 bool ParserTripleAction::operator()(Node s, Node p, Node o) MAYFAIL
 {
   Triple t(s, p, o);
-  db()->add(&t, parser()->source());
+  bool inserted = (db()->add(&t, parser()->source()) != NULL);
+  LoadJob *job = parser()->job();
+  if (job && !job->triple(inserted) && !parser()->terminated())
+    parser()->terminate("Load cancelled");
   return true;
 }
 
@@ -40,28 +40,78 @@
 
 #pragma once
 
+#include <string>
 #include "Node.h"
+#include "NodeCache.h"
 #include "DB.h"
 
 namespace Piglet {
 
+class LoadJob;
+
+// A statement as the parser saw it, before any of its nodes have been looked
+// up in (or added to) the database. Lets parsing run on threads other than
+// the one writing to the database.
+
+struct ParsedTerm {
+  enum Kind { RESOURCE, BNODE, LITERAL };
+  Kind kind;
+  std::string str;
+  std::string datatype; // literals only, empty if none
+  std::string lang;     // literals only, empty if none
+};
+
+struct ParsedTriple {
+  ParsedTerm s, p, o;
+  ParsedTerm g; // graph label, str empty if the triple belongs to the source
+};
+
+class ParsedTripleSink {
+public:
+  virtual ~ParsedTripleSink(void) {}
+  virtual void triple(const ParsedTriple &t) MAYFAIL = 0;
+  virtual void addNamespace(const char *prefix, const char *uri) MAYFAIL = 0;
+};
+
+// A parser with a sink hands everything it parses to the sink instead of
+// the database; the database is then only read to find the source URI, and
+// not at all if that has been given with setSourceURI(). Without a sink, the
+// parser maps blank node labels to nodes itself, for one parse at a time.
+
 class Parser {
 public:
-  Parser(DB *db);
+  Parser(DB *db, ParsedTripleSink *sink = NULL);
   virtual ~Parser(void) {}
   virtual bool parse(Node source) MAYFAIL = 0;
   virtual bool parse(Node source, FILE *stream) MAYFAIL = 0;
   virtual bool parse(Node source, unsigned char *content) MAYFAIL = 0;
+  // content supplied a chunk at a time; the chunks need not be NUL-terminated
+  virtual bool parseBegin(Node source) MAYFAIL = 0;
+  virtual bool parseChunk(const unsigned char *data, size_t length) MAYFAIL = 0;
+  virtual bool parseEnd(void) MAYFAIL = 0;
   virtual bool parseFromScript(Node base, const char *path, char *argv[]) MAYFAIL;
   virtual void addNamespace(const char *prefix, const char *uri) MAYFAIL;
   virtual void terminate(const char *message) = 0;
   virtual bool terminated(void) { return _terminated; }
+  const std::string &error(void) const { return _error; }
   DB *db(void) { return _db; }
+  ParsedTripleSink *sink(void) { return _sink; }
+  LoadJob *job(void) { return _job; }
+  void setJob(LoadJob *job) { _job = job; }
   Node source(void) { return _source; }
+  void setSourceURI(const std::string &uri) { _sourceURI = uri; }
+  Node bnode(const char *label) MAYFAIL;
 protected:
+  void begin(Node source);
+  std::string sourceURI(Node source) MAYFAIL;
   DB *_db;
+  ParsedTripleSink *_sink;
+  LoadJob *_job;
   Node _source;
   bool _terminated;
+  std::string _error;
+  std::string _sourceURI;
+  BNodeMap _bnodes;
 };
 
 class ParserTripleAction : public TripleAction {
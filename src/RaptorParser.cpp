@@ -38,6 +38,7 @@
  *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
  */
 
+#include <pthread.h>
 #include "RaptorParser.h"
 #include "Useful.h"
 
@@ -71,7 +72,7 @@ static void parser_triples_handler(ParserTripleAction *action, const raptor_stat
       s = action->db()->node((char *)(triple->subject));
       break;
     case RAPTOR_IDENTIFIER_TYPE_ANONYMOUS:
-      s = action->db()->node((char *)(triple->subject), true);
+      s = action->parser()->bnode((char *)(triple->subject));
       break;
     default:
       FAIL("Unhandled subject_type");
@@ -91,7 +92,7 @@ static void parser_triples_handler(ParserTripleAction *action, const raptor_stat
                                 (char *)triple->object_literal_language);
       break;
     case RAPTOR_IDENTIFIER_TYPE_ANONYMOUS:
-      o = action->db()->node((char *)(triple->object), true);
+      o = action->parser()->bnode((char *)(triple->object));
       break;
     default:
       FAIL("Unhandled object_type");
@@ -100,15 +101,57 @@ static void parser_triples_handler(ParserTripleAction *action, const raptor_stat
   (*action)(s, p, o);
 }
 
-RaptorParser::RaptorParser(DB *db) : Parser(db)
+static void parsed_term(ParsedTerm &term, raptor_identifier_type type, const void *value,
+                        raptor_uri *datatype = NULL, const unsigned char *lang = NULL)
 {
+  switch (type) {
+    case RAPTOR_IDENTIFIER_TYPE_RESOURCE:
+    case RAPTOR_IDENTIFIER_TYPE_PREDICATE:
+      term.kind = ParsedTerm::RESOURCE;
+      break;
+    case RAPTOR_IDENTIFIER_TYPE_ANONYMOUS:
+      term.kind = ParsedTerm::BNODE;
+      break;
+    case RAPTOR_IDENTIFIER_TYPE_LITERAL:
+      term.kind = ParsedTerm::LITERAL;
+      break;
+    default:
+      FAIL("Unhandled term type");
+  }
+  if (value == NULL) FAIL("NULL term in triple");
+  term.str = (const char *)value;
+  term.datatype = datatype ? (const char *)datatype : "";
+  term.lang = lang ? (const char *)lang : "";
+}
+
+static void parser_sink_handler(Parser *parser, const raptor_statement* triple)
+{
+  ParsedTriple t;
+  parsed_term(t.s, triple->subject_type, triple->subject);
+  if (t.s.kind == ParsedTerm::LITERAL) FAIL("Unhandled subject_type");
+  parsed_term(t.p, RAPTOR_IDENTIFIER_TYPE_RESOURCE, triple->predicate);
+  parsed_term(t.o, triple->object_type, triple->object,
+              triple->object_literal_datatype, triple->object_literal_language);
+  parser->sink()->triple(t);
+}
+
+RaptorParser::RaptorParser(DB *db, ParsedTripleSink *sink) : Parser(db, sink)
+{
+  baseURI = NULL;
   nativeParser = raptor_new_parser_for_content(NULL, "application/rdf+xml", NULL, 0, NULL);
   raptor_set_error_handler(nativeParser, this, (raptor_message_handler)parser_error_handler);
   raptor_set_namespace_handler(nativeParser, this,
                                (void (*)(void *, raptor_namespace *))parser_namespaces_handler);
-  tripleAction = new ParserTripleAction(this, db);
-  raptor_set_statement_handler(nativeParser, tripleAction,
-                               (raptor_statement_handler)parser_triples_handler);
+  if (sink) {
+    tripleAction = NULL;
+    raptor_set_statement_handler(nativeParser, this,
+                                 (raptor_statement_handler)parser_sink_handler);
+  }
+  else {
+    tripleAction = new ParserTripleAction(this, db);
+    raptor_set_statement_handler(nativeParser, tripleAction,
+                                 (raptor_statement_handler)parser_triples_handler);
+  }
   raptor_set_feature(nativeParser, RAPTOR_FEATURE_SCANNING, 1);
   raptor_set_feature(nativeParser, RAPTOR_FEATURE_ALLOW_NON_NS_ATTRIBUTES, 1);
   // raptor_parser_set_feature_string(nativeParser, RAPTOR_FEATURE_WWW_HTTP_USER_AGENT,
@@ -121,14 +164,15 @@ RaptorParser::~RaptorParser(void)
     delete tripleAction;
   if (nativeParser)
     raptor_free_parser(nativeParser);
+  if (baseURI)
+    raptor_free_uri(baseURI);
 }
 
 bool RaptorParser::parse(Node source) MAYFAIL
 {
-  _terminated = false;
-  _source = source;
-  TemporaryString u(db()->info(source));
-  raptor_uri *uri = raptor_new_uri((unsigned char *)u.string());
+  begin(source);
+  std::string u(sourceURI(source));
+  raptor_uri *uri = raptor_new_uri((unsigned char *)u.c_str());
   int result = raptor_parse_uri(nativeParser, uri, NULL);
   raptor_free_uri(uri);
   return (result == 0);
@@ -136,10 +180,9 @@ bool RaptorParser::parse(Node source) MAYFAIL
 
 bool RaptorParser::parse(Node source, FILE *stream) MAYFAIL
 {
-  _terminated = false;
-  _source = source;
-  TemporaryString u(db()->info(source));
-  raptor_uri *uri = raptor_new_uri((unsigned char *)u.string());
+  begin(source);
+  std::string u(sourceURI(source));
+  raptor_uri *uri = raptor_new_uri((unsigned char *)u.c_str());
   int result = raptor_parse_file_stream(nativeParser, stream, NULL, uri);
   raptor_free_uri(uri);
   return (result == 0);
@@ -152,14 +195,34 @@ bool RaptorParser::parse(Node source, FILE *stream) MAYFAIL
    */
 bool RaptorParser::parse(Node source, unsigned char *content) MAYFAIL
 {
-  _terminated = false;
-  _source = source;
-  size_t length = strlen((const char *)content);
-  TemporaryString u(db()->info(source));
-  raptor_uri *uri = raptor_new_uri((unsigned char *)u.string());
-  raptor_start_parse(nativeParser, uri);
-  int result = raptor_parse_chunk(nativeParser, content, length, 1);
-  raptor_free_uri(uri);
+  return (parseBegin(source) &&
+          parseChunk(content, strlen((const char *)content)) &&
+          parseEnd());
+}
+
+bool RaptorParser::parseBegin(Node source) MAYFAIL
+{
+  begin(source);
+  std::string u(sourceURI(source));
+  if (baseURI)
+    raptor_free_uri(baseURI);
+  baseURI = raptor_new_uri((unsigned char *)u.c_str());
+  return (raptor_start_parse(nativeParser, baseURI) == 0);
+}
+
+bool RaptorParser::parseChunk(const unsigned char *data, size_t length) MAYFAIL
+{
+  if (length == 0)
+    return true;
+  return (raptor_parse_chunk(nativeParser, data, length, 0) == 0);
+}
+
+bool RaptorParser::parseEnd(void) MAYFAIL
+{
+  int result = raptor_parse_chunk(nativeParser, NULL, 0, 1);
+  if (baseURI)
+    raptor_free_uri(baseURI);
+  baseURI = NULL;
   return (result == 0);
 }
 
@@ -168,19 +231,31 @@ void RaptorParser::terminate(const char *message)
   // This is a bit of a hack, but gets us through some common broken schemata
   if (strcmp(message, "Using an element 'RDF' without a namespace is forbidden.") != 0) {
     _terminated = true;
+    _error = message;
     std::cout << "Parser terminated with message\n" << message;
     raptor_parse_abort(nativeParser);
   }
 }
 
+// Raptor is initialized once per process, however many databases are open
+
+static pthread_mutex_t raptorMutex = PTHREAD_MUTEX_INITIALIZER;
+static int raptorUsers = 0;
+
 void RaptorParser::init(void)
 {
-  raptor_init();
+  pthread_mutex_lock(&raptorMutex);
+  if (raptorUsers++ == 0)
+    raptor_init();
+  pthread_mutex_unlock(&raptorMutex);
 }
 
 void RaptorParser::finish(void)
 {
-  raptor_finish();
+  pthread_mutex_lock(&raptorMutex);
+  if ((raptorUsers > 0) && (--raptorUsers == 0))
+    raptor_finish();
+  pthread_mutex_unlock(&raptorMutex);
 }
 
 }
@@ -48,17 +48,21 @@ namespace Piglet {
   
 class RaptorParser : public Parser {
 public:
-  RaptorParser(DB *db);
+  RaptorParser(DB *db, ParsedTripleSink *sink = NULL);
   ~RaptorParser(void);
   bool parse(Node source) MAYFAIL;
   bool parse(Node source, FILE *stream) MAYFAIL;
   bool parse(Node source, unsigned char *content) MAYFAIL;
+  bool parseBegin(Node source) MAYFAIL;
+  bool parseChunk(const unsigned char *data, size_t length) MAYFAIL;
+  bool parseEnd(void) MAYFAIL;
   void terminate(const char *message);
   static void init(void);
   static void finish(void);
 private:
   raptor_parser *nativeParser;
   ParserTripleAction *tripleAction;
+  raptor_uri *baseURI; // of a chunked parse under way
 };
   
 }
@@ -0,0 +1,186 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  RefreshScheduler.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include "RefreshScheduler.h"
+#include "DB.h"
+
+namespace Piglet {
+
+RefreshScheduler::RefreshScheduler(DB *db, long interval) MAYFAIL
+  : _db(db), _interval(interval), _stop(false)
+{
+  RefreshStats zero = { 0, 0, 0, 0, 0 };
+  _stats = zero;
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_wake, NULL);
+  if (pthread_create(&_thread, NULL, RefreshScheduler::refresher, this) != 0) {
+    pthread_cond_destroy(&_wake);
+    pthread_mutex_destroy(&_lock);
+    FAIL("Unable to start source refresher");
+  }
+}
+
+RefreshScheduler::~RefreshScheduler(void)
+{
+  pthread_mutex_lock(&_lock);
+  _stop = true;
+  pthread_cond_broadcast(&_wake);
+  pthread_mutex_unlock(&_lock);
+  pthread_join(_thread, NULL);
+  pthread_cond_destroy(&_wake);
+  pthread_mutex_destroy(&_lock);
+}
+
+void RefreshScheduler::configure(long interval)
+{
+  pthread_mutex_lock(&_lock);
+  _interval = interval;
+  pthread_cond_signal(&_wake);
+  pthread_mutex_unlock(&_lock);
+}
+
+void RefreshScheduler::setInterval(Node source, long interval)
+{
+  pthread_mutex_lock(&_lock);
+  if (interval < 0)
+    _intervals.erase(id(source));
+  else
+    _intervals[id(source)] = interval;
+  pthread_cond_signal(&_wake);
+  pthread_mutex_unlock(&_lock);
+}
+
+RefreshStats RefreshScheduler::stats(void)
+{
+  pthread_mutex_lock(&_lock);
+  RefreshStats stats = _stats;
+  pthread_mutex_unlock(&_lock);
+  return stats;
+}
+
+// The sources are listed, and refreshed, without the scheduler's lock held,
+// so that changing intervals never waits on the database
+
+void *RefreshScheduler::refresher(void *scheduler)
+{
+  RefreshScheduler *rs = (RefreshScheduler *)scheduler;
+  DB *db = rs->_db;
+  CurrentDB use(db);
+  std::vector<Node> sources, due;
+  pthread_mutex_lock(&rs->_lock);
+  while (!rs->_stop) {
+    pthread_mutex_unlock(&rs->_lock);
+    bool listed = true;
+    sources.clear();
+    try {
+      mutex::MutexLock lock(&db->_mutex, "refresh");
+      Nodes *all = db->allSources();
+      sources.assign(all->begin(), all->end());
+      delete all;
+    }
+    catch (Condition &c) {
+      listed = false;
+    }
+    pthread_mutex_lock(&rs->_lock);
+    time_t now = time(NULL);
+    time_t next = now + rs->_interval;
+    due.clear();
+    if (listed)
+      rs->collect(sources, now, due, next);
+    else
+      rs->_stats.failed++;
+    if (!due.empty() && !rs->_stop) {
+      pthread_mutex_unlock(&rs->_lock);
+      RefreshResult result = { 0, 0, 0, 0 };
+      bool ok = true;
+      try {
+        db->refresh(due, &result);
+      }
+      catch (Condition &c) {
+        ok = false;
+      }
+      pthread_mutex_lock(&rs->_lock);
+      rs->_stats.rounds++;
+      rs->_stats.checked += result.checked;
+      rs->_stats.stale += result.stale;
+      rs->_stats.loaded += result.loaded;
+      if (!ok)
+        rs->_stats.failed++;
+      continue; // the refresh may have taken a while, so look again
+    }
+    if (!rs->_stop) {
+      struct timespec until;
+      until.tv_sec = next;
+      until.tv_nsec = 0;
+      pthread_cond_timedwait(&rs->_wake, &rs->_lock, &until);
+    }
+  }
+  pthread_mutex_unlock(&rs->_lock);
+  return NULL;
+}
+
+// Called with the lock held; takes the sources that are due, and moves next
+// back to when the first of the others will be. Sources no longer in the
+// database are forgotten.
+
+void RefreshScheduler::collect(const std::vector<Node> &sources, time_t now,
+                               std::vector<Node> &due, time_t &next)
+{
+  std::map<int, time_t> checked;
+  for (size_t i = 0; i < sources.size(); i++) {
+    int src = id(sources[i]);
+    std::map<int, time_t>::iterator c = _checked.find(src);
+    time_t last = (c == _checked.end()) ? now : c->second;
+    std::map<int, long>::iterator own = _intervals.find(src);
+    long interval = (own == _intervals.end()) ? _interval : own->second;
+    if (interval > 0) {
+      if (last + interval <= now) {
+        due.push_back(sources[i]);
+        last = now;
+      }
+      if (last + interval < next)
+        next = last + interval;
+    }
+    checked[src] = last;
+  }
+  _checked.swap(checked);
+}
+
+}
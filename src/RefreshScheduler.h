@@ -0,0 +1,91 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  RefreshScheduler.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <time.h>
+#include <pthread.h>
+#include "Node.h"
+#include "Condition.h"
+
+namespace Piglet {
+
+class DB;
+
+struct RefreshStats {
+  unsigned long rounds;  // times due sources were refreshed
+  unsigned long checked; // sources checked
+  unsigned long stale;   // of those, changed since they were last loaded
+  unsigned long loaded;  // of those, reloaded
+  unsigned long failed;  // rounds that failed altogether
+};
+
+// Refreshes the sources of a database on a thread of its own. A source is
+// checked every interval seconds, unless it has been given an interval of its
+// own (0 leaves it alone); it is first due one interval after the scheduler
+// first sees it. Sources due at the same time are refreshed together with
+// DB::refresh(), so they are checked concurrently and only the stale ones are
+// loaded.
+
+class RefreshScheduler {
+public:
+  RefreshScheduler(DB *db, long interval) MAYFAIL;
+  ~RefreshScheduler(void); // waits for a refresh under way to finish
+  void configure(long interval);
+  void setInterval(Node source, long interval); // negative for the default
+  RefreshStats stats(void);
+private:
+  static void *refresher(void *scheduler);
+  void collect(const std::vector<Node> &sources, time_t now,
+               std::vector<Node> &due, time_t &next);
+  DB *_db;
+  long _interval;
+  std::map<int, long> _intervals;
+  std::map<int, time_t> _checked;
+  RefreshStats _stats;
+  bool _stop;
+  pthread_t _thread;
+  pthread_mutex_t _lock;
+  pthread_cond_t _wake;
+};
+
+}
@@ -52,15 +52,22 @@ TemporaryString::~TemporaryString(void)
   }
 }
 
-Database::Database(const char *name, bool debug)
+Database::Database(const char *name, bool debug, bool readOnly)
 {
   _debug = debug;
-  if (sqlite3_open(name, (sqlite3 **)&_database) != SQLITE_OK)
+  int flags = SQLITE_OPEN_URI | (readOnly ? SQLITE_OPEN_READONLY
+                                          : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE));
+  if (sqlite3_open_v2(name, (sqlite3 **)&_database, flags, NULL) != SQLITE_OK) {
+    sqlite3_close((sqlite3 *)_database);
     _database = NULL;
+  }
 }
 
 Database::~Database(void)
 {
+  for (std::map<int, Statement *>::iterator i = _statements.begin(); i != _statements.end(); i++)
+    delete i->second;
+  _statements.clear();
   if ((_database != NULL) && (sqlite3_close((sqlite3 *)_database) == SQLITE_OK))
     _database = NULL;
 }
@@ -100,6 +107,203 @@ Database::Status Database::exec(const char *query, void *arg, Callback callback,
   return status;
 }
 
+bool Database::inTransaction(void)
+{
+  return (_database != NULL) && !sqlite3_get_autocommit((sqlite3 *)_database);
+}
+
+int Database::changes(void)
+{
+  return (_database != NULL) ? sqlite3_changes((sqlite3 *)_database) : 0;
+}
+
+void Database::setBusyTimeout(int ms)
+{
+  if (_database != NULL)
+    sqlite3_busy_timeout((sqlite3 *)_database, ms);
+}
+
+void Database::setCommitHook(int (*hook)(void *), void *arg)
+{
+  if (_database != NULL)
+    sqlite3_commit_hook((sqlite3 *)_database, hook, arg);
+}
+
+void Database::setRollbackHook(void (*hook)(void *), void *arg)
+{
+  if (_database != NULL)
+    sqlite3_rollback_hook((sqlite3 *)_database, hook, arg);
+}
+
+Statement::Statement(Database *database, const char *sql) MAYFAIL
+{
+  sqlite3 *handle = (sqlite3 *)database->getDbHandle();
+  _database = database;
+  _statement = NULL;
+  inUse = false;
+  if (database->debug())
+    std::cout << "Prepare: " << sql << "\n";
+  if (sqlite3_prepare_v2(handle, sql, -1, (sqlite3_stmt **)&_statement, NULL) != SQLITE_OK)
+    FAIL(sqlite3_errmsg(handle));
+}
+
+Statement::~Statement(void)
+{
+  if (_statement)
+    sqlite3_finalize((sqlite3_stmt *)_statement);
+}
+
+void Statement::bind(int i, int value)
+{
+  sqlite3_bind_int((sqlite3_stmt *)_statement, i, value);
+}
+
+void Statement::bind(int i, const char *value)
+{
+  if (value)
+    sqlite3_bind_text((sqlite3_stmt *)_statement, i, value, -1, SQLITE_TRANSIENT);
+  else
+    sqlite3_bind_null((sqlite3_stmt *)_statement, i);
+}
+
+bool Statement::step(const char *msg) MAYFAIL
+{
+  switch (sqlite3_step((sqlite3_stmt *)_statement)) {
+    case SQLITE_ROW:  return true;
+    case SQLITE_DONE: return false;
+    default:
+      sqlite3_reset((sqlite3_stmt *)_statement);
+      FAIL(msg ? msg : sqlite3_errmsg((sqlite3 *)_database->getDbHandle()));
+  }
+}
+
+void Statement::reset(void)
+{
+  sqlite3_reset((sqlite3_stmt *)_statement);
+  sqlite3_clear_bindings((sqlite3_stmt *)_statement);
+}
+
+int Statement::column(int i)
+{
+  return sqlite3_column_int((sqlite3_stmt *)_statement, i);
+}
+
+const char *Statement::text(int i)
+{
+  return (const char *)sqlite3_column_text((sqlite3_stmt *)_statement, i);
+}
+
+bool Statement::isNull(int i)
+{
+  return sqlite3_column_type((sqlite3_stmt *)_statement, i) == SQLITE_NULL;
+}
+
+CachedStatement::CachedStatement(Database *database, int key)
+{
+  mutex::MutexLock lock(&database->_statementsMutex);
+  _database = database;
+  _key = key;
+  _statement = NULL;
+  _private = false;
+  std::map<int, Statement *>::iterator i = database->_statements.find(key);
+  if (i != database->_statements.end() && !i->second->inUse) {
+    _statement = i->second;
+    _statement->inUse = true;
+  }
+}
+
+void CachedStatement::prepare(const char *sql) MAYFAIL
+{
+  Statement *statement = new Statement(_database, sql);
+  mutex::MutexLock lock(&_database->_statementsMutex);
+  if (_database->_statements.find(_key) == _database->_statements.end())
+    _database->_statements[_key] = statement;
+  else
+    _private = true;
+  _statement = statement;
+  _statement->inUse = true;
+}
+
+CachedStatement::~CachedStatement(void)
+{
+  if (_statement) {
+    if (_private)
+      delete _statement;
+    else {
+      _statement->reset();
+      mutex::MutexLock lock(&_database->_statementsMutex);
+      _statement->inUse = false;
+    }
+  }
+}
+
+ReaderPool::ReaderPool(const char *name, const char *setup, bool debug)
+  : _name(name), _setup(setup ? setup : ""), _debug(debug)
+{
+  pthread_key_create(&_key, ReaderPool::threadExit);
+}
+
+ReaderPool::~ReaderPool(void)
+{
+  pthread_key_delete(_key); // no more thread exit callbacks
+  mutex::MutexLock lock(&_mutex);
+  for (size_t i = 0; i < _readers.size(); i++) {
+    delete _readers[i]->database;
+    delete _readers[i];
+  }
+  _readers.clear();
+}
+
+Database *ReaderPool::connection(void) MAYFAIL
+{
+  Reader *reader = (Reader *)pthread_getspecific(_key);
+  if (reader)
+    return reader->database;
+  Database *database = new Database(_name.c_str(), _debug, true);
+  char *msg = NULL;
+  if (!database->isOpen() ||
+      (!_setup.empty() && (database->exec(_setup.c_str(), NULL, NULL, &msg) != Database::OK))) {
+    delete database;
+    TemporaryString m(msg);
+    FAIL(msg ? msg : "Cannot open a reader connection");
+  }
+  database->setBusyTimeout(5000);
+  reader = new Reader;
+  reader->pool = this;
+  reader->database = database;
+  {
+    mutex::MutexLock lock(&_mutex);
+    _readers.push_back(reader);
+  }
+  pthread_setspecific(_key, reader);
+  return database;
+}
+
+size_t ReaderPool::size(void)
+{
+  mutex::MutexLock lock(&_mutex);
+  return _readers.size();
+}
+
+void ReaderPool::threadExit(void *reader)
+{
+  ((Reader *)reader)->pool->close((Reader *)reader);
+}
+
+void ReaderPool::close(Reader *reader)
+{
+  {
+    mutex::MutexLock lock(&_mutex);
+    for (std::vector<Reader *>::iterator i = _readers.begin(); i != _readers.end(); i++)
+      if (*i == reader) {
+        _readers.erase(i);
+        break;
+      }
+  }
+  delete reader->database;
+  delete reader;
+}
+
 char *query(const char *format, ...)
 {
   va_list args;
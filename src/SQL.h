@@ -42,7 +42,13 @@
 
 #include <stdarg.h>
 #include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
 #include "Useful.h"
+#include "Condition.h"
+#include "Mutex.h"
 
 namespace SQL {
 
@@ -56,17 +62,92 @@ public:
 
 typedef int (*Callback)(void *, int, char **, char **);
 
+class Database;
+
+class Statement {
+public:
+  Statement(Database *database, const char *sql) MAYFAIL;
+  ~Statement(void);
+  void bind(int i, int value);
+  void bind(int i, const char *value); // NULL binds an SQL NULL
+  bool step(const char *msg = NULL) MAYFAIL; // true if a row is available
+  void reset(void);
+  int column(int i);
+  const char *text(int i);
+  bool isNull(int i);
+  bool inUse;
+private:
+  Database *_database;
+  void *_statement;
+};
+
 class Database {
 public:
-  Database(const char *name, bool debug = false);
+  Database(const char *name, bool debug = false, bool readOnly = false);
   ~Database(void);
   bool isOpen(void) { return _database != NULL; }
   enum Status { OK, ABORT, FAILURE };
   Status exec(const char *query, void *arg, Callback callback, char **msg);
+  bool inTransaction(void);
+  int changes(void); // rows modified by the last completed statement
+  void setBusyTimeout(int ms);
+  void setCommitHook(int (*hook)(void *), void *arg);
+  void setRollbackHook(void (*hook)(void *), void *arg);
   void *getDbHandle() { return _database; }
+  bool debug(void) const { return _debug; }
 private:
+  friend class CachedStatement;
   void *_database;
   bool _debug;
+  std::map<int, Statement *> _statements;
+  mutex::Mutex _statementsMutex;
+};
+
+// Checks a prepared statement out of the database's cache for one execution,
+// and resets it when done. Keys identify the shape of the SQL; if the cached
+// statement is already being stepped (e.g. a query issued from within the
+// callback of another query) a private statement is prepared instead.
+
+class CachedStatement {
+public:
+  CachedStatement(Database *database, int key);
+  ~CachedStatement(void);
+  bool prepared(void) const { return _statement != NULL; }
+  void prepare(const char *sql) MAYFAIL;
+  Statement *operator->(void) { return _statement; }
+  Statement *statement(void) { return _statement; }
+private:
+  Database *_database;
+  int _key;
+  Statement *_statement;
+  bool _private;
+};
+
+// Read-only connections to a database file, one per thread, for readers that
+// run alongside a writer connection (in WAL mode they see the last committed
+// state and do not block on, or block, the writer). A connection runs the
+// setup SQL when opened, and is closed when its thread exits or when the
+// pool is deleted; it must only be used by the thread it was handed to.
+
+class ReaderPool {
+public:
+  ReaderPool(const char *name, const char *setup, bool debug = false);
+  ~ReaderPool(void);
+  Database *connection(void) MAYFAIL;
+  size_t size(void);
+private:
+  struct Reader {
+    ReaderPool *pool;
+    Database *database;
+  };
+  static void threadExit(void *reader);
+  void close(Reader *reader);
+  std::string _name;
+  std::string _setup;
+  bool _debug;
+  pthread_key_t _key;
+  std::vector<Reader *> _readers;
+  mutex::Mutex _mutex;
 };
 
 char *query(const char *format, ...);
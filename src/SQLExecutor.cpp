@@ -99,7 +99,7 @@ public:
     }
 
     // error condition
-    sqlite3 *dbhandle=static_cast<sqlite3 *>(DB::current()->getDatabase()->getDbHandle());
+    sqlite3 *dbhandle=sqlite3_db_handle(stmt);
     throw Condition("Error retrieving row: %s (%d)", sqlite3_errmsg(dbhandle), result);
   }
 
@@ -111,7 +111,7 @@ public:
       valid=true;
     }
     else {
-      sqlite3 *dbhandle=static_cast<sqlite3 *>(DB::current()->getDatabase()->getDbHandle());
+      sqlite3 *dbhandle=sqlite3_db_handle(stmt);
       throw Condition("Error resetting statement: %s (%d)", sqlite3_errmsg(dbhandle), result);
     }
   }
@@ -129,11 +129,11 @@ public:
 
   void close()
   {
+    sqlite3 *dbhandle=sqlite3_db_handle(stmt);
     int result=sqlite3_finalize(stmt);
 
     if (result!=SQLITE_OK)
     {
-      sqlite3 *dbhandle=static_cast<sqlite3 *>(DB::current()->getDatabase()->getDbHandle());
       throw Condition("Error finalizing statement: %s (%d)", sqlite3_errmsg(dbhandle), result);
     }
 
@@ -154,11 +154,12 @@ SQLResult::~SQLResult() {}
 
 SQLResult *SQLQueryExecutor::execute(const SQLQuery &sqlQuery)
 {
-  if (!DB::current())
+  DB *database=db ? db : DB::current();
+  if (!database)
   {
     throw Condition("Current database not open");
   }
-  sqlite3 *dbhandle=static_cast<sqlite3 *>(DB::current()->getDatabase()->getDbHandle());
+  sqlite3 *dbhandle=static_cast<sqlite3 *>(database->getDatabase()->getDbHandle());
   sqlite3_stmt *stmt=0;
   int result=sqlite3_prepare_v2(dbhandle, sqlQuery.sqlQuery.c_str(), -1, &stmt, NULL);
   if (result!=SQLITE_OK)
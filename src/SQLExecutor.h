@@ -80,10 +80,17 @@ public:
   virtual void reexecute() = 0; // reexecute statement, don't call prepare after calling this
 };
 
+class DB;
+
 class SQLQueryExecutor
 {
 public:
+  SQLQueryExecutor(DB *_db = 0) : db(_db) {} // 0: the current database of the calling thread
+
   SQLResult *execute(const SQLQuery &sqlQuery);
+
+private:
+  DB *db;
 };
 
 
@@ -0,0 +1,493 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  ShardedDB.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include "Messages.h"
+#include "ShardedDB.h"
+#include "sqlconst.h"
+
+namespace Piglet {
+
+enum ShardOp { SHARD_EXISTS = 1, SHARD_COUNT, SHARD_SOURCES, SHARD_QUADS,
+               SHARD_INSERT, SHARD_DELETE, SHARD_SORTED };
+
+static inline int shardMask(Node s, Node p, Node o, Node source)
+{
+  return (((s != NULL_NODE) ? 1 : 0) | ((p != NULL_NODE) ? 2 : 0) |
+          ((o != NULL_NODE) ? 4 : 0) | ((source != NULL_NODE) ? 8 : 0));
+}
+
+static void shardExec(SQL::Database *db, const char *sql, const char *msg) MAYFAIL
+{
+  char *errmsg = NULL;
+  if (db->exec(sql, NULL, NULL, &errmsg) != SQL::Database::OK)
+    FAIL(msg ? msg : tempsql(errmsg));
+}
+
+// One shard's part of a pattern query. The connection is picked when the
+// task runs, since readers have a connection per thread
+
+class ShardMatch : public Task {
+public:
+  ShardMatch(ShardedDB *db, int shard, bool writing, int op, Node s, Node p, Node o, Node source)
+    : _db(db), _shard(shard), _writing(writing), _op(op), _s(s), _p(p), _o(o), _source(source)
+  { count = 0; }
+  void run(void) MAYFAIL;
+  size_t count;
+  std::vector<Quad> rows;
+private:
+  ShardedDB *_db;
+  int _shard;
+  bool _writing;
+  int _op;
+  Node _s, _p, _o, _source;
+};
+
+void ShardMatch::run(void) MAYFAIL
+{
+  int mask = shardMask(_s, _p, _o, _source);
+  SQL::CachedStatement q(_db->connection(_shard, _writing), (_op << 5) | (mask << 1));
+  if (!q.prepared()) {
+    const char *select[] = { NULL, "SELECT 1 FROM triple",
+                             "SELECT count(*) FROM triple", "SELECT DISTINCT src FROM triple",
+                             "SELECT s,p,o,src FROM triple" };
+    q.prepare((_db->makeWildcardQuery(select[_op], mask) +
+               ((_op == SHARD_EXISTS) ? " LIMIT 1" : "")).c_str());
+  }
+  _db->bindWildcard(q.statement(), _s, _p, _o, _source);
+  while (q->step(ERR_TRIPLE_FIND)) {
+    switch (_op) {
+      case SHARD_EXISTS:
+        count = 1;
+        return;
+      case SHARD_COUNT:
+        count = q->column(0);
+        return;
+      case SHARD_SOURCES:
+        if (q->isNull(0))
+          continue;
+        break;
+    }
+    Quad quad = { { 0, 0, 0, 0 } };
+    if (_op == SHARD_SOURCES)
+      quad.k[3] = q->column(0);
+    else
+      for (int i = 0; i < ((_op == SHARD_QUADS) ? 4 : 3); i++)
+        quad.k[i] = q->column(i);
+    rows.push_back(quad);
+    count++;
+  }
+}
+
+static int shardsCallback(int *n, int argc, char **argv, char **cols)
+{
+  *n = argv[0] ? atoi(argv[0]) : 0;
+  return 0;
+}
+
+ShardedDB::ShardedDB(char *name, int shards, bool verbose) MAYFAIL
+  : DB(name, verbose)
+{
+  _pool = NULL;
+  int n = 0;
+  db("SELECT count(*) FROM (SELECT 1 FROM triple LIMIT 1);", ERR_TRIPLE_FIND, &n,
+     (SQL::Callback)shardsCallback);
+  _unsharded = (n > 0);
+  n = 0;
+  db("CREATE TABLE IF NOT EXISTS shards (n INTEGER);", ERR_SHARDS);
+  db("SELECT n FROM shards;", ERR_SHARDS, &n, (SQL::Callback)shardsCallback);
+  if (n == 0) {
+    check(shards > 0, ERR_SHARDS);
+    db(tempsql(SQL::query("INSERT INTO shards VALUES (%d);", shards)), ERR_SHARDS);
+    n = shards;
+  }
+  else check((shards <= 0) || (shards == n), ERR_SHARDS);
+  bool memory = (strcmp(name, ":memory:") == 0);
+  for (int i = 0; i < n; i++) {
+    char suffix[32];
+    sprintf(suffix, ".shard%d", i);
+    std::string file = memory ? std::string(name) : std::string(name) + suffix;
+    Shard shard;
+    shard.db = new SQL::Database(file.c_str(), PIGLET_DEBUG);
+    shard.readers = NULL;
+    _shards.push_back(shard);
+    check(shard.db->isOpen(), ERR_DB_OPEN);
+    char *mode = NULL;
+    char *msg = NULL;
+    shard.db->exec("PRAGMA journal_mode=WAL;", &mode, (SQL::Callback)SQL::oneStringCallback, &msg);
+    SQL::TemporaryString error(msg);
+    if (mode && (strcmp(mode, "wal") == 0))
+      _shards.back().readers = new SQL::ReaderPool(file.c_str(), NULL, PIGLET_DEBUG);
+    free(mode);
+    shardExec(shard.db, SQL_CREATE_SHARD, ERR_DB_OPEN);
+    shardExec(shard.db, SQL_CREATE_INDEXES, ERR_BULK);
+  }
+  if (n > 1)
+    _pool = new ThreadPool(n - 1); // the calling thread takes a share as well
+}
+
+ShardedDB::~ShardedDB(void) MAYFAIL
+{
+  shutdown();
+  delete _pool;
+  for (size_t i = 0; i < _shards.size(); i++) {
+    delete _shards[i].readers;
+    delete _shards[i].db;
+  }
+}
+
+int ShardedDB::shardOf(Node subject) const
+{
+  unsigned int h = (unsigned int)id(subject) * 2654435761u;
+  return (int)((h ^ (h >> 16)) % _shards.size());
+}
+
+SQL::Database *ShardedDB::connection(int shard, bool writing) MAYFAIL
+{
+  const Shard &s = _shards[shard];
+  return ((s.readers == NULL) || writing) ? s.db : s.readers->connection();
+}
+
+// Runs a pattern against the shards that can hold matches, appending rows
+// if asked to; returns the total count (matching rows, or count(*))
+
+size_t ShardedDB::match(int op, Node s, Node p, Node o, Node source, std::vector<Quad> *rows) MAYFAIL
+{
+  bool w = writing();
+  std::vector<ShardMatch *> matches;
+  if (s != NULL_NODE)
+    matches.push_back(new ShardMatch(this, shardOf(s), w, op, s, p, o, source));
+  else
+    for (size_t i = 0; i < _shards.size(); i++)
+      matches.push_back(new ShardMatch(this, (int)i, w, op, s, p, o, source));
+  size_t count = 0;
+  try {
+    if ((matches.size() > 1) && _pool) {
+      std::vector<Task *> tasks(matches.begin(), matches.end());
+      _pool->run(tasks);
+    }
+    else
+      for (size_t i = 0; i < matches.size(); i++)
+        matches[i]->run();
+  }
+  catch (Condition &c) {
+    for (size_t i = 0; i < matches.size(); i++)
+      delete matches[i];
+    throw;
+  }
+  for (size_t i = 0; i < matches.size(); i++) {
+    count += matches[i]->count;
+    if (rows)
+      rows->insert(rows->end(), matches[i]->rows.begin(), matches[i]->rows.end());
+    delete matches[i];
+  }
+  return count;
+}
+
+// The main file can still hold triples (of a store opened as sharded later
+// on); those, temporary triples and attached snapshots are all covered by the
+// DB implementation. Every part is queried in the same order, and the
+// cursors merged as results are asked for.
+
+TripleCursor *ShardedDB::cursor(Node subject, Node predicate, Node object, Node source) MAYFAIL
+{
+  QuadOrder order = planPattern(id(subject), id(predicate), id(object), id(source)).order;
+  std::vector<TripleCursor *> cursors;
+  snapshotCursors(subject, predicate, object, source, cursors);
+  try {
+    cursors.push_back(tripleCursor(subject, predicate, object, source, true));
+    for (size_t i = 0; i < _shards.size(); i++)
+      if ((subject == NULL_NODE) || ((int)i == shardOf(subject)))
+        cursors.push_back(shardCursor((int)i, subject, predicate, object, source, order));
+  }
+  catch (Condition &c) {
+    for (size_t i = 0; i < cursors.size(); i++)
+      delete cursors[i];
+    throw;
+  }
+  return new MergeTripleCursor(cursors, order);
+}
+
+TripleCursor *ShardedDB::shardCursor(int shard, Node s, Node p, Node o, Node source,
+                                     QuadOrder order) MAYFAIL
+{
+  int mask = shardMask(s, p, o, source);
+  SQL::CachedStatement *q =
+    new SQL::CachedStatement(connection(shard, writing()), (SHARD_SORTED << 5) | (mask << 1));
+  try {
+    if (!q->prepared())
+      q->prepare((makeWildcardQuery("SELECT DISTINCT s,p,o FROM triple", mask) +
+                  orderBy(order)).c_str());
+    bindWildcard(q->statement(), s, p, o, source);
+  }
+  catch (Condition &c) {
+    delete q;
+    throw;
+  }
+  return new SQLTripleCursor(q);
+}
+
+bool ShardedDB::queryUsingSQL(char *condition, GenericAction *action) MAYFAIL
+{
+  FAIL(ERR_SHARDED_SQL);
+}
+
+bool ShardedDB::stored(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  if (temporary)
+    return DB::stored(s, p, o, source, true);
+  return ((match(SHARD_EXISTS, s, p, o, source, NULL) > 0) ||
+          (_unsharded && DB::stored(s, p, o, source, false)));
+}
+
+bool ShardedDB::storedQuad(const Quad &quad) MAYFAIL
+{
+  std::vector<Quad> rows;
+  match(SHARD_QUADS, Node(quad.k[0]), Node(quad.k[1]), Node(quad.k[2]), NULL_NODE, &rows);
+  for (size_t i = 0; i < rows.size(); i++)
+    if (rows[i].k[3] == quad.k[3])
+      return true;
+  return (_unsharded && DB::storedQuad(quad));
+}
+
+int ShardedDB::count(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  if (temporary)
+    return DB::count(s, p, o, source, true);
+  int n = ((_unsharded ? DB::storedCount(s, p, o, source, false) : 0) +
+           (int)match(SHARD_COUNT, s, p, o, source, NULL));
+  return n + (int)countSnapshotOnly(s, p, o, source, n > 0);
+}
+
+bool ShardedDB::sources(Triple *triple, NodeAction *action) MAYFAIL
+{
+  std::vector<Quad> rows;
+  std::vector<int> sources;
+  match(SHARD_SOURCES, triple->s(), triple->p(), triple->o(), NULL_NODE, &rows);
+  for (std::vector<Quad>::const_iterator r = rows.begin(); r != rows.end(); r++)
+    sources.push_back(r->k[3]);
+  Nodes local(this);
+  DB::sources(triple, &local);
+  for (Nodes::const_iterator i = local.begin(); i != local.end(); i++)
+    sources.push_back(id(*i));
+  std::sort(sources.begin(), sources.end());
+  sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+  for (std::vector<int>::const_iterator i = sources.begin(); i != sources.end(); i++)
+    if (!(*action)(Node(*i)))
+      return false;
+  return true;
+}
+
+bool ShardedDB::insertTriple(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  if (temporary)
+    return DB::insertTriple(s, p, o, source, true);
+  SQL::Database *shard = _shards[shardOf(s)].db;
+  SQL::CachedStatement q(shard, SHARD_INSERT << 5);
+  if (!q.prepared())
+    q.prepare("INSERT OR IGNORE INTO triple VALUES (?1, ?2, ?3, ?4)");
+  q->bind(1, id(s));
+  q->bind(2, id(p));
+  q->bind(3, id(o));
+  q->bind(4, id(source));
+  q->step(ERR_TRIPLE_ADD);
+  return (shard->changes() > 0);
+}
+
+void ShardedDB::deleteTriples(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL
+{
+  DB::deleteTriples(s, p, o, source, temporary);
+  if (temporary)
+    return;
+  int mask = shardMask(s, p, o, source);
+  for (size_t i = 0; i < _shards.size(); i++)
+    if ((s == NULL_NODE) || ((int)i == shardOf(s))) {
+      SQL::CachedStatement q(_shards[i].db, (SHARD_DELETE << 5) | (mask << 1));
+      if (!q.prepared())
+        q.prepare(makeWildcardQuery("DELETE FROM triple", mask).c_str());
+      bindWildcard(q.statement(), s, p, o, source);
+      q->step(ERR_TRIPLE_DEL);
+    }
+}
+
+void ShardedDB::collectQuads(Node source, std::vector<Quad> &quads) MAYFAIL
+{
+  DB::collectQuads(source, quads);
+  match(SHARD_QUADS, NULL_NODE, NULL_NODE, NULL_NODE, source, &quads);
+}
+
+void ShardedDB::execAll(const char *sql, const char *msg) MAYFAIL
+{
+  for (size_t i = 0; i < _shards.size(); i++)
+    shardExec(_shards[i].db, sql, msg);
+}
+
+// Nested transactions are savepoints, which DB turns into savepoint() and
+// friends below; only the outermost level begins and ends the shards' own
+
+bool ShardedDB::transaction(void) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "transaction");
+  bool nested = (transactionDepth() > 0);
+  bool ok = DB::transaction();
+  if (!nested) {
+    try {
+      execAll("BEGIN", ERR_TRANSACTION);
+    }
+    catch (Condition &c) {
+      rollback();
+      throw;
+    }
+  }
+  return ok;
+}
+
+// The main file commits first, then the shards; should one of them fail,
+// those committed already stay so, the rest are rolled back, and the sources
+// loaded are not recorded (see the class comment)
+
+bool ShardedDB::commit(void) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "commit");
+  if (transactionDepth() > 1)
+    return DB::commit();
+  std::vector<Loaded> loaded;
+  loaded.swap(_loaded);
+  _loadedMarks.clear();
+  bool ok = DB::commit();
+  for (size_t i = 0; i < _shards.size(); i++) {
+    try {
+      if (_shards[i].db->inTransaction())
+        shardExec(_shards[i].db, "COMMIT", ERR_TRANSACTION);
+    }
+    catch (Condition &c) {
+      for (size_t j = i; j < _shards.size(); j++)
+        if (_shards[j].db->inTransaction())
+          _shards[j].db->exec("ROLLBACK", NULL, NULL, NULL);
+      throw;
+    }
+  }
+  if (!loaded.empty()) {
+    DB::transaction();
+    try {
+      for (size_t i = 0; i < loaded.size(); i++)
+        DB::markLoaded(loaded[i].source, loaded[i].filetime, loaded[i].etag);
+    }
+    catch (Condition &c) {
+      DB::rollback();
+      throw;
+    }
+    DB::commit();
+  }
+  return ok;
+}
+
+bool ShardedDB::rollback(void) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "rollback");
+  if (transactionDepth() > 1)
+    return DB::rollback();
+  _loaded.clear();
+  _loadedMarks.clear();
+  for (size_t i = 0; i < _shards.size(); i++)
+    if (_shards[i].db->inTransaction())
+      shardExec(_shards[i].db, "ROLLBACK", ERR_TRANSACTION);
+  return DB::rollback();
+}
+
+void ShardedDB::savepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "savepoint");
+  DB::savepoint(name);
+  execAll(tempsql(SQL::query("SAVEPOINT %Q", name)), ERR_TRANSACTION);
+  _loadedMarks.push_back(_loaded.size());
+}
+
+void ShardedDB::releaseSavepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "releaseSavepoint");
+  DB::releaseSavepoint(name);
+  execAll(tempsql(SQL::query("RELEASE %Q", name)), ERR_TRANSACTION);
+  if (!_loadedMarks.empty())
+    _loadedMarks.pop_back();
+}
+
+void ShardedDB::rollbackToSavepoint(const char *name) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "rollbackToSavepoint");
+  DB::rollbackToSavepoint(name);
+  execAll(tempsql(SQL::query("ROLLBACK TO %Q", name)), ERR_TRANSACTION);
+  if (!_loadedMarks.empty())
+    _loaded.resize(_loadedMarks.back());
+}
+
+// Within a transaction the source is recorded by commit(), after the shards
+// holding its triples
+
+void ShardedDB::markLoaded(Node source, time_t filetime, const std::string &etag) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "markLoaded");
+  if (transactionDepth() == 0)
+    DB::markLoaded(source, filetime, etag);
+  else {
+    Loaded l = { source, filetime, etag };
+    _loaded.push_back(l);
+  }
+}
+
+void ShardedDB::beginBulk(bool dropIndexes) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "beginBulk");
+  DB::beginBulk(dropIndexes);
+  if (dropIndexes)
+    execAll(SQL_DROP_INDEXES, ERR_BULK);
+}
+
+void ShardedDB::endBulk(void) MAYFAIL
+{
+  mutex::MutexLock lock(&_mutex, "endBulk");
+  DB::endBulk();
+  if (!indexesDropped())
+    execAll(SQL_CREATE_INDEXES, ERR_BULK); // no-op unless they were dropped
+}
+
+}
@@ -0,0 +1,119 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  ShardedDB.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include "DB.h"
+#include "ThreadPool.h"
+
+namespace Piglet {
+
+class ShardMatch;
+
+// A DB that partitions its triples by subject over a number of SQLite files
+// next to the main one (<name>.shard0, <name>.shard1, ...). The main file
+// keeps the node dictionary, namespaces, sources and temporary triples. A
+// pattern with a bound subject is answered by one shard, other patterns are
+// fanned out to all shards in parallel and the results merged. Shards commit
+// after the main file, so a crash in between can lose the triples of the
+// last transaction but never leaves triples that refer to unknown nodes; the
+// sources loaded in a transaction are recorded only once all shards have
+// committed, so a source whose triples were lost is simply loaded again.
+//
+// Commits are best effort across files: should a shard fail to commit, the
+// ones before it keep their part of the transaction, the rest are rolled
+// back, and commit() throws. (Attaching the shards to one connection would
+// not help, since SQLite commits a transaction over several WAL files
+// atomically only file by file.) Running the transaction again repairs the
+// store: a load replaces the triples of its source, and adding or deleting a
+// triple a second time changes nothing.
+
+class ShardedDB : public DB {
+public:
+  ShardedDB(char *name, int shards, bool verbose = false) MAYFAIL;
+  virtual ~ShardedDB(void) MAYFAIL;
+  using DB::sources;
+  virtual TripleCursor *cursor(Node subject, Node predicate, Node object, Node source = NULL_NODE) MAYFAIL;
+  virtual bool queryUsingSQL(char *condition, GenericAction *action) MAYFAIL;
+  virtual int count(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual bool sources(Triple *triple, NodeAction *action) MAYFAIL;
+  virtual bool transaction(void) MAYFAIL;
+  virtual bool commit(void) MAYFAIL;
+  virtual bool rollback(void) MAYFAIL;
+  virtual void beginBulk(bool dropIndexes = false) MAYFAIL;
+  virtual void endBulk(void) MAYFAIL;
+  int shards(void) const { return (int)_shards.size(); }
+  int shardOf(Node subject) const;
+protected:
+  virtual bool stored(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual bool storedQuad(const Quad &quad) MAYFAIL;
+  virtual bool insertTriple(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual void deleteTriples(Node s, Node p, Node o, Node source, bool temporary) MAYFAIL;
+  virtual void collectQuads(Node source, std::vector<Quad> &quads) MAYFAIL;
+  virtual void markLoaded(Node source, time_t filetime,
+                          const std::string &etag = std::string()) MAYFAIL;
+  virtual void savepoint(const char *name) MAYFAIL;
+  virtual void releaseSavepoint(const char *name) MAYFAIL;
+  virtual void rollbackToSavepoint(const char *name) MAYFAIL;
+private:
+  friend class ShardMatch;
+  struct Shard {
+    SQL::Database *db;
+    SQL::ReaderPool *readers;
+  };
+  struct Loaded {
+    Node source;
+    time_t filetime;
+    std::string etag;
+  };
+  size_t match(int op, Node s, Node p, Node o, Node source, std::vector<Quad> *rows) MAYFAIL;
+  SQL::Database *connection(int shard, bool writing) MAYFAIL;
+  TripleCursor *shardCursor(int shard, Node s, Node p, Node o, Node source,
+                            QuadOrder order) MAYFAIL;
+  void execAll(const char *sql, const char *msg) MAYFAIL;
+  std::vector<Shard> _shards;
+  ThreadPool *_pool;
+  bool _unsharded; // the main file has triples of its own
+  std::vector<Loaded> _loaded; // markLoaded() calls waiting for the shards to commit
+  std::vector<size_t> _loadedMarks; // size of _loaded at each open savepoint
+};
+
+}
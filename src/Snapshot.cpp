@@ -0,0 +1,453 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  Snapshot.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "Snapshot.h"
+#include "Messages.h"
+
+namespace Piglet {
+
+static const char SNAPSHOT_MAGIC[8] = { 'P', 'I', 'G', 'S', 'N', 'A', 'P', '1' };
+static const size_t NODES_PER_BLOCK = 16;
+static const size_t QUADS_PER_BLOCK = 128;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t nodes;
+  uint32_t dictBlocks;
+  uint64_t triples;
+  int32_t high;
+  int32_t low;
+  uint64_t dictIndex; // uint32_t offset of each block, relative to dictData
+  uint64_t dictData;
+  uint64_t idIndex;   // int32_t ids[nodes], then uint32_t blocks[nodes]
+  uint64_t orders[3]; // QuadBlock directory, followed by the coded quads
+  uint32_t quadBlocks[3];
+  uint32_t reserved;
+  uint64_t size;
+};
+
+struct QuadBlock {
+  int32_t first[4];
+  uint64_t offset; // relative to the end of the directory
+  uint32_t count;
+  uint32_t reserved;
+};
+
+static inline uint32_t zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static void putVarint(std::string &b, uint32_t v)
+{
+  while (v >= 0x80) {
+    b.push_back((char)(v | 0x80));
+    v >>= 7;
+  }
+  b.push_back((char)v);
+}
+
+static inline uint32_t getVarint(const unsigned char *&p)
+{
+  uint32_t v = 0;
+  for (int shift = 0; ; shift += 7) {
+    unsigned char c = *p++;
+    v |= (uint32_t)(c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return v;
+  }
+}
+
+static void align(std::string &b)
+{
+  while (b.size() % 8)
+    b.push_back('\0');
+}
+
+static bool nodeLess(const SnapshotNode &a, const SnapshotNode &b)
+{
+  return a.key < b.key;
+}
+
+static bool nodeIDLess(const std::pair<int, uint32_t> &a, const std::pair<int, uint32_t> &b)
+{
+  return a.first < b.first;
+}
+
+static bool quadEqual(const Quad &a, const Quad &b)
+{
+  return !QuadLess()(a, b) && !QuadLess()(b, a);
+}
+
+void Snapshot::write(const char *path, std::vector<SnapshotNode> &nodes,
+                     std::vector<Quad> &quads) MAYFAIL
+{
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  std::string b((const char *)&header, sizeof(header));
+
+  std::sort(nodes.begin(), nodes.end(), nodeLess);
+  std::vector<uint32_t> blockOffsets;
+  std::vector<std::pair<int, uint32_t> > ids;
+  std::string dict;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const std::string &key = nodes[i].key;
+    size_t shared = 0;
+    if (i % NODES_PER_BLOCK == 0)
+      blockOffsets.push_back((uint32_t)dict.size());
+    else
+      while ((shared < key.size()) && (shared < nodes[i - 1].key.size()) &&
+             (key[shared] == nodes[i - 1].key[shared]))
+        shared++;
+    putVarint(dict, (uint32_t)shared);
+    putVarint(dict, (uint32_t)(key.size() - shared));
+    dict.append(key, shared, std::string::npos);
+    putVarint(dict, zigzag(nodes[i].id));
+    ids.push_back(std::make_pair(nodes[i].id, (uint32_t)(i / NODES_PER_BLOCK)));
+    header.high = std::max(header.high, (int32_t)nodes[i].id);
+    header.low = std::min(header.low, (int32_t)nodes[i].id);
+  }
+  header.nodes = (uint32_t)nodes.size();
+  header.dictBlocks = (uint32_t)blockOffsets.size();
+  header.dictIndex = b.size();
+  if (!blockOffsets.empty())
+    b.append((const char *)&blockOffsets[0], blockOffsets.size() * sizeof(uint32_t));
+  header.dictData = b.size();
+  b.append(dict);
+  align(b);
+  header.idIndex = b.size();
+  std::sort(ids.begin(), ids.end(), nodeIDLess);
+  for (size_t i = 0; i < ids.size(); i++)
+    b.append((const char *)&ids[i].first, sizeof(int32_t));
+  for (size_t i = 0; i < ids.size(); i++)
+    b.append((const char *)&ids[i].second, sizeof(uint32_t));
+  align(b);
+
+  for (std::vector<Quad>::const_iterator q = quads.begin(); q != quads.end(); q++)
+    for (int i = 0; i < 4; i++) { // includes blank nodes, which have no key
+      header.high = std::max(header.high, (int32_t)q->k[i]);
+      header.low = std::min(header.low, (int32_t)q->k[i]);
+    }
+  for (int order = ORDER_SPO; order <= ORDER_OSP; order++) {
+    std::vector<Quad> sorted;
+    sorted.reserve(quads.size());
+    for (std::vector<Quad>::const_iterator q = quads.begin(); q != quads.end(); q++)
+      sorted.push_back(permuteQuad(*q, (QuadOrder)order));
+    std::sort(sorted.begin(), sorted.end(), QuadLess());
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), quadEqual), sorted.end());
+    header.triples = sorted.size();
+    std::vector<QuadBlock> directory;
+    std::string data;
+    for (size_t i = 0; i < sorted.size(); i++) {
+      const int *k = sorted[i].k;
+      if (i % QUADS_PER_BLOCK == 0) {
+        QuadBlock block;
+        memset(&block, 0, sizeof(block));
+        memcpy(block.first, k, sizeof(block.first));
+        block.offset = data.size();
+        block.count = (uint32_t)std::min(QUADS_PER_BLOCK, sorted.size() - i);
+        directory.push_back(block);
+      }
+      else {
+        const int *prev = sorted[i - 1].k;
+        int d = 0;
+        while (k[d] == prev[d])
+          d++;
+        data.push_back((char)d);
+        putVarint(data, (uint32_t)k[d] - (uint32_t)prev[d]);
+        for (int j = d + 1; j < 4; j++)
+          putVarint(data, zigzag(k[j]));
+      }
+    }
+    header.orders[order] = b.size();
+    header.quadBlocks[order] = (uint32_t)directory.size();
+    if (!directory.empty())
+      b.append((const char *)&directory[0], directory.size() * sizeof(QuadBlock));
+    b.append(data);
+    align(b);
+  }
+  header.size = b.size();
+  memcpy(&b[0], &header, sizeof(header));
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL)
+    FAIL(ERR_SNAPSHOT_WRITE);
+  bool ok = (fwrite(b.data(), 1, b.size(), f) == b.size());
+  ok = (fclose(f) == 0) && ok;
+  if (!ok)
+    FAIL(ERR_SNAPSHOT_WRITE);
+}
+
+Snapshot::Snapshot(const char *path) MAYFAIL
+  : _path(path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    FAIL(ERR_SNAPSHOT_OPEN);
+  struct stat st;
+  void *data = MAP_FAILED;
+  if ((fstat(fd, &st) == 0) && ((size_t)st.st_size >= sizeof(SnapshotHeader)))
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    FAIL(ERR_SNAPSHOT_OPEN);
+  _data = (const char *)data;
+  _size = st.st_size;
+  const SnapshotHeader *h = (const SnapshotHeader *)_data;
+  if ((memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0) || (h->size != _size)) {
+    munmap((void *)_data, _size);
+    FAIL(ERR_SNAPSHOT_OPEN);
+  }
+}
+
+Snapshot::~Snapshot(void)
+{
+  munmap((void *)_data, _size);
+}
+
+#define HEADER ((const SnapshotHeader *)_data)
+
+size_t Snapshot::nodes(void) const { return HEADER->nodes; }
+size_t Snapshot::size(void) const  { return HEADER->triples; }
+int Snapshot::high(void) const     { return HEADER->high; }
+int Snapshot::low(void) const      { return HEADER->low; }
+
+int Snapshot::nodeID(size_t i) const
+{
+  return ((const int32_t *)(_data + HEADER->idIndex))[i];
+}
+
+// Decodes the entries of a dictionary block in turn
+
+class DictionaryReader {
+public:
+  DictionaryReader(const char *data, const SnapshotHeader *h, uint32_t block) {
+    const uint32_t *offsets = (const uint32_t *)(data + h->dictIndex);
+    _p = (const unsigned char *)(data + h->dictData + offsets[block]);
+    _left = std::min((size_t)NODES_PER_BLOCK, (size_t)(h->nodes - block * NODES_PER_BLOCK));
+    id = 0;
+  }
+  bool next(void) {
+    if (_left == 0)
+      return false;
+    _left--;
+    uint32_t shared = getVarint(_p);
+    uint32_t length = getVarint(_p);
+    key.resize(shared);
+    key.append((const char *)_p, length);
+    _p += length;
+    id = unzigzag(getVarint(_p));
+    return true;
+  }
+  std::string key;
+  int id;
+private:
+  const unsigned char *_p;
+  size_t _left;
+};
+
+int Snapshot::find(const std::string &key) const
+{
+  // last block whose first key is not greater than key
+  uint32_t lo = 0, hi = HEADER->dictBlocks;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    DictionaryReader r(_data, HEADER, mid);
+    r.next();
+    if (key < r.key)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  if (lo == 0)
+    return 0;
+  DictionaryReader r(_data, HEADER, lo - 1);
+  while (r.next()) {
+    int c = r.key.compare(key);
+    if (c == 0)
+      return r.id;
+    else if (c > 0)
+      break;
+  }
+  return 0;
+}
+
+bool Snapshot::key(int id, std::string &key) const
+{
+  const int32_t *ids = (const int32_t *)(_data + HEADER->idIndex);
+  const int32_t *i = std::lower_bound(ids, ids + HEADER->nodes, (int32_t)id);
+  if ((i == ids + HEADER->nodes) || (*i != id))
+    return false;
+  const uint32_t *blocks = (const uint32_t *)(ids + HEADER->nodes);
+  DictionaryReader r(_data, HEADER, blocks[i - ids]);
+  while (r.next())
+    if (r.id == id) {
+      key.swap(r.key);
+      return true;
+    }
+  return false;
+}
+
+static bool blockLess(const QuadBlock &block, const Quad &key, int n)
+{
+  for (int i = 0; i < n; i++)
+    if (block.first[i] != key.k[i])
+      return block.first[i] < key.k[i];
+  return false;
+}
+
+#define DIRECTORY(order) ((const QuadBlock *)(_data + HEADER->orders[order]))
+
+uint32_t Snapshot::blocks(QuadOrder order) const
+{
+  return HEADER->quadBlocks[order];
+}
+
+// The block matches of a plan may begin in: the one before the first block
+// that starts at or after its key
+
+uint32_t Snapshot::firstBlock(const QuadPattern &plan) const
+{
+  const QuadBlock *directory = DIRECTORY(plan.order);
+  uint32_t lo = 0, hi = blocks(plan.order);
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (blockLess(directory[mid], plan.key, plan.n))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return (lo > 0) ? lo - 1 : 0;
+}
+
+// Counts (and appends to out, if not NULL) the matches in one block; false
+// once the range of the plan has been passed or limit matches found
+
+bool Snapshot::scan(const QuadPattern &plan, uint32_t b, std::vector<Quad> *out, size_t &count,
+                    size_t limit) const
+{
+  const QuadBlock *directory = DIRECTORY(plan.order);
+  const char *data = (const char *)(directory + blocks(plan.order));
+  const QuadBlock &block = directory[b];
+  const unsigned char *c = (const unsigned char *)(data + block.offset);
+  QuadLess prefix(plan.n);
+  Quad q;
+  memcpy(q.k, block.first, sizeof(q.k));
+  for (uint32_t i = 0; i < block.count; i++) {
+    if (i > 0) {
+      int d = *c++;
+      q.k[d] = (int)((uint32_t)q.k[d] + getVarint(c));
+      for (int j = d + 1; j < 4; j++)
+        q.k[j] = unzigzag(getVarint(c));
+    }
+    if (prefix(q, plan.key))
+      continue;
+    if (prefix(plan.key, q))
+      return false;
+    if ((plan.src == 0) || (q.k[3] == plan.src)) {
+      count++;
+      if (out)
+        out->push_back(unpermuteQuad(q, plan.order));
+      if (limit && (count >= limit))
+        return false;
+    }
+  }
+  return true;
+}
+
+size_t Snapshot::match(int s, int p, int o, int src, std::vector<Quad> *out, size_t limit) const
+{
+  QuadPattern plan = planPattern(s, p, o, src);
+  size_t count = 0;
+  for (uint32_t b = firstBlock(plan); b < blocks(plan.order); b++)
+    if (!scan(plan, b, out, count, limit))
+      break;
+  return count;
+}
+
+SnapshotCursor::SnapshotCursor(const Snapshot *snapshot, int s, int p, int o, int src)
+  : _snapshot(snapshot), _plan(planPattern(s, p, o, src)), _more(true), _next(0)
+{
+  _block = snapshot->firstBlock(_plan);
+  fill();
+}
+
+// Decodes blocks until one has matches, or the range has been passed
+
+void SnapshotCursor::fill(void)
+{
+  while ((_next >= _rows.size()) && _more && (_block < _snapshot->blocks(_plan.order))) {
+    _rows.clear();
+    _next = 0;
+    size_t count = 0;
+    _more = _snapshot->scan(_plan, _block++, &_rows, count, 0);
+  }
+}
+
+Triple SnapshotCursor::next(void) MAYFAIL
+{
+  if (_next >= _rows.size())
+    FAIL("Cursor is exhausted");
+  Quad q = _rows[_next++];
+  // the sources of a triple are last in every order, so its quads are adjacent
+  for (;;) {
+    fill();
+    if ((_next >= _rows.size()) || QuadLess(3)(q, _rows[_next]) || QuadLess(3)(_rows[_next], q))
+      break;
+    _next++;
+  }
+  return Triple(Node(q.k[0]), Node(q.k[1]), Node(q.k[2]));
+}
+
+}
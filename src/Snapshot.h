@@ -0,0 +1,118 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  Snapshot.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Condition.h"
+#include "TripleIndex.h"
+#include "TripleCursor.h"
+
+namespace Piglet {
+
+struct SnapshotNode {
+  std::string key; // NodeCache::uriKey() or NodeCache::literalKey()
+  int id;
+};
+
+// An immutable, memory-mapped set of triples together with the dictionary
+// entries of the nodes they use. The file holds
+//
+//   - a header (native byte order)
+//   - the dictionary: keys in sorted order, front-coded in blocks of 16, with
+//     an index of block offsets, and the node IDs in sorted order with the
+//     block of each
+//   - the quads in SPO, POS and OSP order, in blocks of 128 varint-coded
+//     deltas, each block listed in a directory with its first quad
+//
+// The mapping is shared and read-only, so opening is constant time and the
+// pages are shared by every process that attaches the same file.
+
+class Snapshot {
+public:
+  Snapshot(const char *path) MAYFAIL;
+  ~Snapshot(void);
+  static void write(const char *path, std::vector<SnapshotNode> &nodes,
+                    std::vector<Quad> &quads) MAYFAIL;
+  const std::string &path(void) const { return _path; }
+  int find(const std::string &key) const; // 0 if not in the dictionary
+  bool key(int id, std::string &key) const;
+  size_t nodes(void) const;
+  int nodeID(size_t i) const; // IDs in ascending order
+  size_t size(void) const;
+  int high(void) const;
+  int low(void) const;
+  // Quads matching a pattern (0 being a wildcard), stopping after limit
+  // matches unless limit is 0; matches are appended to out if not NULL
+  size_t match(int s, int p, int o, int src, std::vector<Quad> *out, size_t limit = 0) const;
+private:
+  uint32_t firstBlock(const QuadPattern &plan) const;
+  uint32_t blocks(QuadOrder order) const;
+  bool scan(const QuadPattern &plan, uint32_t block, std::vector<Quad> *out, size_t &count,
+            size_t limit) const;
+  std::string _path;
+  const char *_data;
+  size_t _size;
+  friend class SnapshotCursor;
+};
+
+// Iterates over the triples of a snapshot matching a pattern, decoding a
+// block of quads at a time as results are asked for. Triples come in the
+// order planPattern() picks for the pattern, each once whatever its sources.
+
+class SnapshotCursor : public TripleCursor {
+public:
+  SnapshotCursor(const Snapshot *snapshot, int s, int p, int o, int src);
+  bool hasNext(void) { return _next < _rows.size(); }
+  Triple next(void) MAYFAIL;
+  QuadOrder order(void) const { return _plan.order; }
+private:
+  void fill(void);
+  const Snapshot *_snapshot;
+  QuadPattern _plan;
+  uint32_t _block; // the next one to decode
+  bool _more;      // whether the range of the pattern may go on past it
+  std::vector<Quad> _rows;
+  size_t _next;
+};
+
+}
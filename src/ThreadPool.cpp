@@ -0,0 +1,147 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  ThreadPool.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include "ThreadPool.h"
+
+namespace Piglet {
+
+ThreadPool::ThreadPool(int threads) MAYFAIL
+{
+  _stop = false;
+  pthread_mutex_init(&_lock, NULL);
+  pthread_cond_init(&_work, NULL);
+  pthread_cond_init(&_done, NULL);
+  for (int i = 0; i < threads; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ThreadPool::worker, this) != 0)
+      break;
+    _threads.push_back(thread);
+  }
+}
+
+ThreadPool::~ThreadPool(void)
+{
+  pthread_mutex_lock(&_lock);
+  _stop = true;
+  pthread_cond_broadcast(&_work);
+  pthread_mutex_unlock(&_lock);
+  for (size_t i = 0; i < _threads.size(); i++)
+    pthread_join(_threads[i], NULL);
+  pthread_cond_destroy(&_done);
+  pthread_cond_destroy(&_work);
+  pthread_mutex_destroy(&_lock);
+}
+
+ThreadPool::Batch *ThreadPool::submit(std::vector<Task *> &tasks)
+{
+  Batch *batch = new Batch;
+  batch->pending = (int)tasks.size();
+  batch->failed = false;
+  pthread_mutex_lock(&_lock);
+  for (size_t i = 0; i < tasks.size(); i++) {
+    Job job = { tasks[i], batch };
+    _queue.push_back(job);
+  }
+  pthread_cond_broadcast(&_work);
+  pthread_mutex_unlock(&_lock);
+  return batch;
+}
+
+void ThreadPool::wait(Batch *batch) MAYFAIL
+{
+  pthread_mutex_lock(&_lock);
+  while (batch->pending > 0)
+    if (!_queue.empty()) {
+      Job job = _queue.front();
+      _queue.pop_front();
+      pthread_mutex_unlock(&_lock);
+      execute(job);
+      pthread_mutex_lock(&_lock);
+    }
+    else pthread_cond_wait(&_done, &_lock);
+  pthread_mutex_unlock(&_lock);
+  std::string error = batch->error;
+  bool failed = batch->failed;
+  delete batch;
+  if (failed)
+    FAIL(error);
+}
+
+void ThreadPool::execute(const Job &job)
+{
+  std::string error;
+  bool failed = false;
+  try {
+    job.task->run();
+  }
+  catch (Condition &c) {
+    failed = true;
+    error = c.message();
+  }
+  pthread_mutex_lock(&_lock);
+  if (failed && !job.batch->failed) {
+    job.batch->failed = true;
+    job.batch->error = error;
+  }
+  if (--job.batch->pending == 0)
+    pthread_cond_broadcast(&_done);
+  pthread_mutex_unlock(&_lock);
+}
+
+void *ThreadPool::worker(void *arg)
+{
+  ThreadPool *pool = (ThreadPool *)arg;
+  pthread_mutex_lock(&pool->_lock);
+  while (true) {
+    while (!pool->_stop && pool->_queue.empty())
+      pthread_cond_wait(&pool->_work, &pool->_lock);
+    if (pool->_stop)
+      break;
+    Job job = pool->_queue.front();
+    pool->_queue.pop_front();
+    pthread_mutex_unlock(&pool->_lock);
+    pool->execute(job);
+    pthread_mutex_lock(&pool->_lock);
+  }
+  pthread_mutex_unlock(&pool->_lock);
+  return NULL;
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  ThreadPool.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "Condition.h"
+
+namespace Piglet {
+
+class Task {
+public:
+  virtual ~Task(void) {}
+  virtual void run(void) MAYFAIL = 0;
+};
+
+// A fixed set of worker threads. run() hands a batch of tasks to the workers,
+// helps out with queued tasks while waiting, and returns when the whole batch
+// is done; if any task failed, the first failure is rethrown in the caller.
+// submit() and wait() do the same in two steps, so that the caller can do
+// other work meanwhile. Tasks are not owned by the pool.
+
+class ThreadPool {
+public:
+  struct Batch {
+    int pending;
+    bool failed;
+    std::string error;
+  };
+  ThreadPool(int threads) MAYFAIL;
+  ~ThreadPool(void);
+  void run(std::vector<Task *> &tasks) MAYFAIL { wait(submit(tasks)); }
+  Batch *submit(std::vector<Task *> &tasks);
+  void wait(Batch *batch) MAYFAIL; // also deletes the batch
+  int size(void) const { return (int)_threads.size(); }
+private:
+  struct Job {
+    Task *task;
+    Batch *batch;
+  };
+  static void *worker(void *pool);
+  void execute(const Job &job);
+  std::vector<pthread_t> _threads;
+  std::deque<Job> _queue;
+  pthread_mutex_t _lock;
+  pthread_cond_t _work;
+  pthread_cond_t _done;
+  bool _stop;
+};
+
+}
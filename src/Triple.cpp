@@ -40,6 +40,7 @@
 
 #include "Triple.h"
 #include "DB.h"
+#include "Messages.h"
 
 namespace Piglet {
 
@@ -50,9 +51,11 @@ Triple::Triple(Node s, Node p, Node o)
   _o = o;
 }
 
-std::ostream& operator<<(std::ostream& os, const Triple *t)
+std::ostream& operator<<(std::ostream& os, const Triple *t) MAYFAIL
 {
-  os << temp(DB::current()->toString(t));
+  DB *db = DB::current();
+  check(db != NULL, ERR_DB_CURRENT);
+  os << temp(db->toString(t));
   return os;
 }
 
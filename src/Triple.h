@@ -57,6 +57,6 @@ public:
   Node o(void) const { return _o; }
 };
 
-std::ostream& operator<<(std::ostream& os, const Triple *t);
+std::ostream& operator<<(std::ostream& os, const Triple *t) MAYFAIL; // prints with DB::current()
 
 }
@@ -0,0 +1,159 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  TripleCursor.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <algorithm>
+#include "TripleCursor.h"
+#include "Messages.h"
+
+namespace Piglet {
+
+SQLTripleCursor::SQLTripleCursor(SQL::CachedStatement *statement) MAYFAIL
+{
+  _statement = statement;
+  advance();
+}
+
+SQLTripleCursor::~SQLTripleCursor(void)
+{
+  if (_statement)
+    delete _statement;
+}
+
+void SQLTripleCursor::advance(void) MAYFAIL
+{
+  try {
+    if (!(*_statement)->step(ERR_TRIPLE_FIND)) {
+      delete _statement;
+      _statement = NULL;
+    }
+  }
+  catch (Condition &c) {
+    delete _statement;
+    _statement = NULL;
+    throw;
+  }
+}
+
+Triple SQLTripleCursor::next(void) MAYFAIL
+{
+  if (_statement == NULL)
+    FAIL("Cursor is exhausted");
+  Triple t((*_statement)->column(0), (*_statement)->column(1), (*_statement)->column(2));
+  advance();
+  return t;
+}
+
+Triple QuadTripleCursor::next(void) MAYFAIL
+{
+  if (_next >= _rows.size())
+    FAIL("Cursor is exhausted");
+  const Quad &q = _rows[_next++];
+  return Triple(Node(q.k[0]), Node(q.k[1]), Node(q.k[2]));
+}
+
+static bool tripleLess(const Quad &a, const Quad &b)
+{
+  return QuadLess(3)(a, b);
+}
+
+static bool tripleEqual(const Quad &a, const Quad &b)
+{
+  return !QuadLess(3)(a, b) && !QuadLess(3)(b, a);
+}
+
+void QuadTripleCursor::distinct(void)
+{
+  std::sort(_rows.begin(), _rows.end(), tripleLess);
+  _rows.erase(std::unique(_rows.begin(), _rows.end(), tripleEqual), _rows.end());
+}
+
+MergeTripleCursor::MergeTripleCursor(std::vector<TripleCursor *> &sorted, QuadOrder order) MAYFAIL
+{
+  _sorted.swap(sorted);
+  _order = order;
+  try {
+    for (size_t i = 0; i < _sorted.size(); i++)
+      pull(i);
+  }
+  catch (Condition &c) {
+    for (size_t i = 0; i < _sorted.size(); i++)
+      delete _sorted[i];
+    throw;
+  }
+}
+
+MergeTripleCursor::~MergeTripleCursor(void)
+{
+  for (size_t i = 0; i < _sorted.size(); i++)
+    delete _sorted[i];
+}
+
+void MergeTripleCursor::pull(size_t i) MAYFAIL
+{
+  if (_sorted[i]->hasNext()) {
+    Triple t = _sorted[i]->next();
+    Quad row = { { id(t.s()), id(t.p()), id(t.o()), 0 } };
+    _heads.push_back(std::make_pair(permuteQuad(row, _order), i));
+  }
+}
+
+// There are only a few cursors, so the least head is simply searched for
+
+Triple MergeTripleCursor::next(void) MAYFAIL
+{
+  if (_heads.empty())
+    FAIL("Cursor is exhausted");
+  size_t least = 0;
+  for (size_t h = 1; h < _heads.size(); h++)
+    if (tripleLess(_heads[h].first, _heads[least].first))
+      least = h;
+  Quad row = unpermuteQuad(_heads[least].first, _order);
+  std::vector<std::pair<Quad, size_t> > heads;
+  heads.swap(_heads);
+  for (size_t h = 0; h < heads.size(); h++) {
+    if (tripleEqual(heads[h].first, heads[least].first))
+      pull(heads[h].second);
+    else
+      _heads.push_back(heads[h]);
+  }
+  return Triple(Node(row.k[0]), Node(row.k[1]), Node(row.k[2]));
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  TripleCursor.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <vector>
+#include "Triple.h"
+#include "SQL.h"
+#include "TripleIndex.h"
+
+namespace Piglet {
+
+// Pull-style iteration over query results:
+//
+//   while (cursor->hasNext()) { Triple t = cursor->next(); ... }
+
+class TripleCursor {
+public:
+  virtual ~TripleCursor(void) {}
+  virtual bool hasNext(void) = 0;
+  virtual Triple next(void) MAYFAIL = 0;
+};
+
+// Steps a bound statement whose first three columns are s, p and o. The
+// statement is released as soon as the last row has been read.
+
+class SQLTripleCursor : public TripleCursor {
+public:
+  SQLTripleCursor(SQL::CachedStatement *statement) MAYFAIL;
+  ~SQLTripleCursor(void);
+  bool hasNext(void) { return _statement != NULL; }
+  Triple next(void) MAYFAIL;
+private:
+  void advance(void) MAYFAIL;
+  SQL::CachedStatement *_statement;
+};
+
+// Iterates over rows collected up front, so that actions are free to modify
+// the database while iterating
+
+class QuadTripleCursor : public TripleCursor {
+public:
+  QuadTripleCursor(void) { _next = 0; }
+  bool hasNext(void) { return _next < _rows.size(); }
+  Triple next(void) MAYFAIL;
+  std::vector<Quad> &rows(void) { return _rows; }
+  void distinct(void); // like SQL UNION, over (s, p, o)
+private:
+  std::vector<Quad> _rows;
+  size_t _next;
+};
+
+// Merges cursors whose results are each in the same order (one of those of
+// TripleIndex, as (s, p, o) permuted), dropping duplicates like distinct()
+// does; a cursor is only advanced as results are asked for. Takes over the
+// cursors.
+
+class MergeTripleCursor : public TripleCursor {
+public:
+  MergeTripleCursor(std::vector<TripleCursor *> &sorted, QuadOrder order = ORDER_SPO) MAYFAIL;
+  ~MergeTripleCursor(void);
+  bool hasNext(void) { return !_heads.empty(); }
+  Triple next(void) MAYFAIL;
+private:
+  void pull(size_t i) MAYFAIL;
+  std::vector<TripleCursor *> _sorted;
+  QuadOrder _order;
+  std::vector<std::pair<Quad, size_t> > _heads; // next row (permuted) of each cursor with one
+};
+
+}
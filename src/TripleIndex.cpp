@@ -0,0 +1,262 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  TripleIndex.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#include <algorithm>
+#include <limits.h>
+#include "TripleIndex.h"
+
+namespace Piglet {
+
+static bool quadEqual(const Quad &a, const Quad &b)
+{
+  return !QuadLess()(a, b) && !QuadLess()(b, a);
+}
+
+void QuadArray::load(std::vector<Quad> &quads)
+{
+  _base.swap(quads);
+  std::sort(_base.begin(), _base.end(), QuadLess());
+  _base.erase(std::unique(_base.begin(), _base.end(), quadEqual), _base.end());
+  _delta.clear();
+  _removed.clear();
+}
+
+bool QuadArray::contains(const Quad &q) const
+{
+  if (_delta.find(q) != _delta.end())
+    return true;
+  return (std::binary_search(_base.begin(), _base.end(), q, QuadLess()) &&
+          (_removed.find(q) == _removed.end()));
+}
+
+void QuadArray::insert(const Quad &q)
+{
+  std::set<Quad, QuadLess>::iterator i = _removed.find(q);
+  if (i != _removed.end())
+    _removed.erase(i); // still in the base
+  else {
+    _delta.insert(q);
+    mergeIfNeeded();
+  }
+}
+
+void QuadArray::remove(const Quad &q)
+{
+  if (_delta.erase(q) == 0) {
+    _removed.insert(q);
+    mergeIfNeeded();
+  }
+}
+
+void QuadArray::mergeIfNeeded(void)
+{
+  size_t pending = _delta.size() + _removed.size();
+  if ((pending < 1024) || (pending < _base.size() / 8))
+    return;
+  std::vector<Quad> merged;
+  merged.reserve(size());
+  QuadLess less;
+  std::vector<Quad>::const_iterator b = _base.begin();
+  std::set<Quad, QuadLess>::const_iterator d = _delta.begin();
+  std::set<Quad, QuadLess>::const_iterator r = _removed.begin();
+  while (b != _base.end()) {
+    if ((d != _delta.end()) && less(*d, *b))
+      merged.push_back(*d++);
+    else {
+      while ((r != _removed.end()) && less(*r, *b))
+        r++;
+      if ((r != _removed.end()) && !less(*b, *r))
+        r++; // removed
+      else
+        merged.push_back(*b);
+      b++;
+    }
+  }
+  merged.insert(merged.end(), d, _delta.end());
+  _base.swap(merged);
+  _delta.clear();
+  _removed.clear();
+}
+
+size_t QuadArray::scan(const Quad &key, int n, int src, std::vector<Quad> *out) const
+{
+  QuadLess prefix(n);
+  std::vector<Quad>::const_iterator b = std::lower_bound(_base.begin(), _base.end(), key, prefix);
+  std::vector<Quad>::const_iterator e = std::upper_bound(b, _base.end(), key, prefix);
+  if ((out == NULL) && (src == 0) && _removed.empty() && _delta.empty())
+    return e - b; // counting a range needs no scan
+  Quad low = key; // ids are negative for literals
+  for (int i = n; i < 4; i++)
+    low.k[i] = INT_MIN;
+  std::set<Quad, QuadLess>::const_iterator d = _delta.lower_bound(low);
+  std::set<Quad, QuadLess>::const_iterator r = _removed.lower_bound(low);
+  size_t count = 0;
+  QuadLess less;
+  for (; b != e; b++) {
+    while ((r != _removed.end()) && less(*r, *b))
+      r++;
+    if ((r != _removed.end()) && !less(*b, *r))
+      continue;
+    if ((src == 0) || (b->k[3] == src)) {
+      count++;
+      if (out)
+        out->push_back(*b);
+    }
+  }
+  for (; (d != _delta.end()) && !prefix(key, *d); d++)
+    if ((src == 0) || (d->k[3] == src)) {
+      count++;
+      if (out)
+        out->push_back(*d);
+    }
+  return count;
+}
+
+static inline Quad makeQuad(int a, int b, int c, int src)
+{
+  Quad q = { { a, b, c, src } };
+  return q;
+}
+
+Quad permuteQuad(const Quad &q, QuadOrder order)
+{
+  switch (order) {
+    case ORDER_POS: return makeQuad(q.k[1], q.k[2], q.k[0], q.k[3]);
+    case ORDER_OSP: return makeQuad(q.k[2], q.k[0], q.k[1], q.k[3]);
+    default:        return q;
+  }
+}
+
+Quad unpermuteQuad(const Quad &q, QuadOrder order)
+{
+  switch (order) {
+    case ORDER_POS: return makeQuad(q.k[2], q.k[0], q.k[1], q.k[3]);
+    case ORDER_OSP: return makeQuad(q.k[1], q.k[2], q.k[0], q.k[3]);
+    default:        return q;
+  }
+}
+
+QuadPattern planPattern(int s, int p, int o, int src)
+{
+  QuadPattern plan;
+  plan.src = src;
+  if (s && p && o) {
+    plan.order = ORDER_SPO;
+    plan.n = src ? 4 : 3;
+    plan.src = 0;
+  }
+  else if (s && o) {
+    plan.order = ORDER_OSP;
+    plan.n = 2;
+  }
+  else if (s) {
+    plan.order = ORDER_SPO;
+    plan.n = p ? 2 : 1;
+  }
+  else if (p) {
+    plan.order = ORDER_POS;
+    plan.n = o ? 2 : 1;
+  }
+  else if (o) {
+    plan.order = ORDER_OSP;
+    plan.n = 1;
+  }
+  else {
+    plan.order = ORDER_SPO;
+    plan.n = 0;
+  }
+  plan.key = permuteQuad(makeQuad(s, p, o, src), plan.order);
+  for (int i = plan.n; i < 4; i++)
+    plan.key.k[i] = 0;
+  return plan;
+}
+
+void TripleIndex::load(std::vector<Quad> &quads)
+{
+  std::vector<Quad> permuted[3];
+  for (int order = ORDER_POS; order <= ORDER_OSP; order++) {
+    permuted[order].reserve(quads.size());
+    for (std::vector<Quad>::const_iterator q = quads.begin(); q != quads.end(); q++)
+      permuted[order].push_back(permuteQuad(*q, (QuadOrder)order));
+  }
+  _orders[ORDER_SPO].load(quads);
+  _orders[ORDER_POS].load(permuted[ORDER_POS]);
+  _orders[ORDER_OSP].load(permuted[ORDER_OSP]);
+}
+
+bool TripleIndex::insert(int s, int p, int o, int src)
+{
+  Quad q = makeQuad(s, p, o, src);
+  if (_orders[ORDER_SPO].contains(q))
+    return false;
+  for (int order = ORDER_SPO; order <= ORDER_OSP; order++)
+    _orders[order].insert(permuteQuad(q, (QuadOrder)order));
+  return true;
+}
+
+bool TripleIndex::remove(int s, int p, int o, int src)
+{
+  Quad q = makeQuad(s, p, o, src);
+  if (!_orders[ORDER_SPO].contains(q))
+    return false;
+  for (int order = ORDER_SPO; order <= ORDER_OSP; order++)
+    _orders[order].remove(permuteQuad(q, (QuadOrder)order));
+  return true;
+}
+
+size_t TripleIndex::match(int s, int p, int o, int src, std::vector<Quad> *out) const
+{
+  QuadPattern plan = planPattern(s, p, o, src);
+  size_t first = out ? out->size() : 0;
+  size_t count = _orders[plan.order].scan(plan.key, plan.n, plan.src, out);
+  if (out && (plan.order != ORDER_SPO))
+    for (std::vector<Quad>::iterator q = out->begin() + first; q != out->end(); q++)
+      *q = unpermuteQuad(*q, plan.order);
+  return count;
+}
+
+bool TripleIndex::exists(int s, int p, int o, int src) const
+{
+  if (s && p && o && src)
+    return _orders[ORDER_SPO].contains(makeQuad(s, p, o, src));
+  return match(s, p, o, src, NULL) > 0;
+}
+
+}
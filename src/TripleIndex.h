@@ -0,0 +1,123 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  TripleIndex.h
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include <set>
+
+namespace Piglet {
+
+// An id quad (s, p, o, src), or some permutation of one
+
+struct Quad {
+  int k[4];
+};
+
+struct QuadLess {
+  QuadLess(int n = 4) : _n(n) {}
+  bool operator()(const Quad &a, const Quad &b) const {
+    for (int i = 0; i < _n; i++)
+      if (a.k[i] != b.k[i])
+        return a.k[i] < b.k[i];
+    return false;
+  }
+  int _n; // only the first _n positions are compared
+};
+
+// The orders quads are kept in, (s, p, o, src), (p, o, s, src) and
+// (o, s, p, src), and how a pattern (0 being a wildcard) maps onto a prefix
+// range of one of them; src is the last position of every order and is
+// filtered for unless s, p and o are all bound
+
+enum QuadOrder { ORDER_SPO, ORDER_POS, ORDER_OSP };
+
+struct QuadPattern {
+  QuadOrder order;
+  Quad key; // permuted
+  int n;    // length of the bound prefix of key
+  int src;  // source to filter for, or 0
+};
+
+QuadPattern planPattern(int s, int p, int o, int src);
+Quad permuteQuad(const Quad &q, QuadOrder order);   // (s, p, o, src) to order
+Quad unpermuteQuad(const Quad &q, QuadOrder order); // order to (s, p, o, src)
+
+// One sort order of a set of quads: a sorted base array, plus a delta of
+// quads inserted and a set of base quads removed since the last merge. The
+// delta is folded into the base when it grows past a fraction of it, so a
+// write costs O(log n) and merging amortizes to a constant per write.
+
+class QuadArray {
+public:
+  QuadArray(void) {}
+  void load(std::vector<Quad> &quads); // takes over the contents
+  bool contains(const Quad &q) const;
+  void insert(const Quad &q); // q must not be present
+  void remove(const Quad &q); // q must be present
+  // Quads whose first n positions equal key's and, unless src is 0, whose
+  // last position is src; matches are appended to out if it is not NULL
+  size_t scan(const Quad &key, int n, int src, std::vector<Quad> *out) const;
+  size_t size(void) const { return _base.size() - _removed.size() + _delta.size(); }
+private:
+  void mergeIfNeeded(void);
+  std::vector<Quad> _base;
+  std::set<Quad, QuadLess> _delta;
+  std::set<Quad, QuadLess> _removed;
+};
+
+// Triples with their sources, kept in all three orders so that every pattern
+// is a prefix range of one of them
+
+class TripleIndex {
+public:
+  TripleIndex(void) {}
+  void load(std::vector<Quad> &quads); // (s, p, o, src) quads, in any order
+  bool insert(int s, int p, int o, int src); // false if already present
+  bool remove(int s, int p, int o, int src); // false if not present
+  size_t match(int s, int p, int o, int src, std::vector<Quad> *out) const;
+  bool exists(int s, int p, int o, int src) const;
+  size_t size(void) const { return _orders[ORDER_SPO].size(); }
+private:
+  QuadArray _orders[3];
+};
+
+}
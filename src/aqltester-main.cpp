@@ -259,7 +259,7 @@ int processMain(int argc, char **argv)
        }
        case OM_RAW_RESULT: {
          print(OL_VERBOSE, "Executing SQL...\n");
-         SQLQueryExecutor queryExecutor;
+         SQLQueryExecutor queryExecutor(&pigletDb);
          sqlResult=queryExecutor.execute(*sqlQuery);
          break;
        }
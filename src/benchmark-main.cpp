@@ -0,0 +1,1199 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  benchmark-main.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ *
+ *  Micro-benchmarks for the triple store.
+ *
+ *  Usage: piglet-benchmark file [suite [n]]
+ *
+ *  ops     per-operation latency of the DB API (prepared statements) against
+ *          the same SQL formatted and run through sqlite3_exec, which is what
+ *          every operation used to do
+ *  bulk    add() in and out of bulk mode, with and without secondary indexes
+ *  memory  exists, count and query against the SQLite and in-memory backends
+ *  snapshot queries served from SQLite and from a compiled snapshot
+ *  sharded add throughput and query latency of a single file against a
+ *          store sharded over 4 files (bound-subject patterns go to one
+ *          shard, others fan out to all of them)
+ *  loadmany
+ *          loading 8 RDF/XML files one at a time with load() against
+ *          loadMany(), which parses them in parallel for a single writer
+ *  pipeline
+ *          load() of one large RDF/XML file, plain and pipelined (parsing,
+ *          encoding and inserting on separate threads)
+ *  groupcommit
+ *          single-triple add() from 8 threads, each call committed on its
+ *          own and with group commit
+ *  concurrency
+ *          query throughput by number of reader threads, with the store idle
+ *          and while another thread keeps a load transaction open
+ *  contention
+ *          dictionary lookups (node, literal, info, toString of nodes already
+ *          in the store) by number of threads, with the store idle and while
+ *          one thread keeps reloading a source and another adds new nodes
+ *  layout  insert throughput, file size and per-pattern query latency of the
+ *          triple table layouts of schema versions 0.1, 0.2 and 0.3 (raw
+ *          SQLite, in files named after the given one)
+ *  fetch   a load that fetches its source against one that finds it not
+ *          modified, and one answered from the fetch cache, from a file: URL
+ *          and, if PIGLET_STANDIN is set to the URL of fetch-standin.py
+ *          serving the directory of the given file, over HTTP; this suite
+ *          also checks that unchanged sources are neither transferred nor
+ *          parsed, and exits with 1 if they are
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <string>
+#include "piglet.h"
+#include "Curl.h"
+
+using namespace Piglet;
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void report(const char *op, double before, double after, int n)
+{
+  printf("%-24s %12.2f %12.2f %8.1fx\n", op, before * 1000000.0 / n, after * 1000000.0 / n,
+         (after > 0) ? before / after : 0.0);
+}
+
+static int countRows(int *rows, int argc, char **argv, char **cols)
+{
+  (*rows)++;
+  return 0;
+}
+
+static void legacy(SQL::Database *sql, char *query)
+{
+  SQL::TemporaryString q(query);
+  int rows = 0;
+  char *msg = NULL;
+  sql->exec(q.string(), &rows, (SQL::Callback)countRows, &msg);
+}
+
+class CountTriples : public TripleAction {
+public:
+  CountTriples(DB *db) : TripleAction(db) { n = 0; }
+  bool operator()(Node s, Node p, Node o) MAYFAIL { n++; return true; }
+  bool operator()(Triple *t) MAYFAIL { n++; return true; }
+  int n;
+};
+
+static void benchmarkOps(DB &db, int n)
+{
+  SQL::Database *sql = db.getDatabase();
+  char uri[64];
+  Node *subjects = new Node[n];
+  Node p = db.node("http://example.org/p");
+  Node srcA = db.node("http://example.org/a");
+  Node srcB = db.node("http://example.org/b");
+  db.transaction();
+  for (int i = 0; i < n; i++) {
+    sprintf(uri, "http://example.org/s%d", i);
+    subjects[i] = db.node(uri);
+  }
+  db.commit();
+
+  printf("%-24s %12s %12s %9s\n", "operation (us/op)", "sqlite3_exec", "prepared", "speedup");
+  double t0, before, after;
+
+  db.setNodeCacheSize(0); // measure the SQL, not the dictionary cache
+  t0 = now();
+  for (int i = 0; i < n; i++) {
+    sprintf(uri, "http://example.org/s%d", i);
+    legacy(sql, SQL::query("SELECT id FROM node WHERE str = %Q AND id > 0", uri));
+  }
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++) {
+    sprintf(uri, "http://example.org/s%d", i);
+    db.node(uri);
+  }
+  after = now() - t0;
+  report("node", before, after, n);
+  db.setNodeCacheSize(100000);
+
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    legacy(sql, SQL::query("SELECT str FROM node WHERE id = %d", id(subjects[i])));
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    free(db.info(subjects[i]));
+  after = now() - t0;
+  report("info", before, after, n);
+
+  db.transaction();
+  t0 = now();
+  for (int i = 0; i < n; i++) {
+    Node s = subjects[i];
+    legacy(sql, SQL::query("SELECT 1 FROM triple WHERE s=%d AND p=%d AND o=%d AND src=%d LIMIT 1",
+                           id(s), id(p), id(s), id(srcA)));
+    legacy(sql, SQL::query("INSERT INTO triple VALUES (%d, %d, %d, %d)",
+                           id(s), id(p), id(s), id(srcA)));
+  }
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++) {
+    Triple t(subjects[i], p, subjects[i]);
+    db.add(&t, srcB);
+  }
+  after = now() - t0;
+  db.commit();
+  report("add", before, after, n);
+
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    legacy(sql, SQL::query("SELECT 1 FROM triple WHERE s=%d AND p=%d AND o=%d LIMIT 1",
+                           id(subjects[i]), id(p), id(subjects[i])));
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    db.exists(subjects[i], p, subjects[i]);
+  after = now() - t0;
+  report("exists", before, after, n);
+
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    legacy(sql, SQL::query("SELECT count(*) FROM triple WHERE s=%d", id(subjects[i])));
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    db.count(subjects[i], NULL_NODE, NULL_NODE, NULL_NODE, false);
+  after = now() - t0;
+  report("count [s,*,*]", before, after, n);
+
+  CountTriples action(&db);
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    legacy(sql, SQL::query("SELECT s,p,o FROM triple WHERE s=%d UNION "
+                           "SELECT s,p,o FROM cache.triple WHERE s=%d",
+                           id(subjects[i]), id(subjects[i])));
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    db.query(subjects[i], NULL_NODE, NULL_NODE, NULL_NODE, &action);
+  after = now() - t0;
+  report("query [s,*,*]", before, after, n);
+
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    legacy(sql, SQL::query("SELECT s,p,o FROM triple WHERE o=%d UNION "
+                           "SELECT s,p,o FROM cache.triple WHERE o=%d",
+                           id(subjects[i]), id(subjects[i])));
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    db.query(NULL_NODE, NULL_NODE, subjects[i], NULL_NODE, &action);
+  after = now() - t0;
+  report("query [*,*,o]", before, after, n);
+
+  t0 = now();
+  for (int i = 0; i < n; i++)
+    db.query(subjects[i], NULL_NODE, NULL_NODE, NULL_NODE, &action);
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++) {
+    TripleCursor *c = db.cursor(subjects[i], NULL_NODE, NULL_NODE);
+    while (c->hasNext())
+      { Triple t = c->next(); action(t.s(), t.p(), t.o()); }
+    delete c;
+  }
+  after = now() - t0;
+  report("callback->cursor [s]", before, after, n);
+
+  db.transaction();
+  t0 = now();
+  for (int i = 0; i < n; i++) {
+    Node s = subjects[i];
+    legacy(sql, SQL::query("SELECT 1 FROM triple WHERE s=%d AND p=%d AND o=%d AND src=%d LIMIT 1",
+                           id(s), id(p), id(s), id(srcA)));
+    legacy(sql, SQL::query("DELETE FROM triple WHERE s=%d AND p=%d AND o=%d AND src=%d",
+                           id(s), id(p), id(s), id(srcA)));
+  }
+  before = now() - t0;
+  t0 = now();
+  for (int i = 0; i < n; i++) {
+    Triple t(subjects[i], p, subjects[i]);
+    db.del(&t, srcB);
+  }
+  after = now() - t0;
+  db.commit();
+  report("del", before, after, n);
+
+  delete [] subjects;
+}
+
+// Adds n triples (10 per subject, subjects in scattered order) to a source in
+// one transaction; callers remove the source again so that every run starts
+// out with the same table
+
+static double addTriples(DB &db, Node *subjects, Node *objects, int n, Node source)
+{
+  int m = n / 10 + 1;
+  double t0 = now();
+  db.transaction();
+  for (int i = 0; i < n; i++) {
+    Triple t(subjects[(int)(((long long)(i / 10) * 7919) % m)], objects[i % 7], objects[i % 10]);
+    db.add(&t, source);
+  }
+  db.commit();
+  return now() - t0;
+}
+
+static void benchmarkBulk(DB &db, int n)
+{
+  char uri[64];
+  Node *subjects = new Node[n / 10 + 1];
+  Node *objects = new Node[10];
+  Node source = db.node("http://example.org/a");
+  db.transaction();
+  for (int i = 0; i <= n / 10; i++) {
+    sprintf(uri, "http://example.org/s%d", i);
+    subjects[i] = db.node(uri);
+  }
+  for (int i = 0; i < 10; i++) {
+    sprintf(uri, "http://example.org/o%d", i);
+    objects[i] = db.node(uri);
+  }
+  db.commit();
+  addTriples(db, subjects, objects, n, source); // warm up
+  db.delSource(source);
+
+  printf("%-24s %12s %12s %9s\n", "operation (us/triple)", "add", "bulk", "speedup");
+  double before = addTriples(db, subjects, objects, n, source);
+  db.delSource(source);
+  db.beginBulk();
+  double after = addTriples(db, subjects, objects, n, source);
+  db.endBulk();
+  db.delSource(source);
+  report("bulk add", before, after, n);
+
+  double t0 = now();
+  db.beginBulk(true);
+  addTriples(db, subjects, objects, n, source);
+  db.endBulk();
+  after = now() - t0;
+  db.delSource(source);
+  report("bulk add, no indexes", before, after, n);
+
+  delete [] subjects;
+  delete [] objects;
+}
+
+static double timeReads(DB &db, Node *subjects, Node p, int n, int op)
+{
+  CountTriples action(&db);
+  double t0 = now();
+  for (int i = 0; i < n; i++) {
+    Node s = subjects[(int)(((long long)i * 7919) % n)];
+    switch (op) {
+      case 0: db.exists(s, p, s); break;
+      case 1: db.count(s, NULL_NODE, NULL_NODE, NULL_NODE, false); break;
+      case 2: db.query(s, NULL_NODE, NULL_NODE, NULL_NODE, &action); break;
+      case 3: db.query(NULL_NODE, NULL_NODE, s, NULL_NODE, &action); break;
+    }
+  }
+  return now() - t0;
+}
+
+static void benchmarkMemory(char *file, int n)
+{
+  static const char *ops[] = { "exists", "count [s,*,*]", "query [s,*,*]", "query [*,*,o]" };
+  char uri[64];
+  Node *subjects = new Node[n];
+  Node p, q;
+  {
+    DB db(file);
+    p = db.node("http://example.org/p");
+    q = db.node("http://example.org/q");
+    Node src = db.node("http://example.org/a");
+    db.transaction();
+    for (int i = 0; i < n; i++) {
+      sprintf(uri, "http://example.org/s%d", i);
+      subjects[i] = db.node(uri);
+    }
+    for (int i = 0; i < n; i++) {
+      Triple t1(subjects[i], p, subjects[(i + 1) % n]), t2(subjects[i], q, subjects[(i + 7) % n]);
+      db.add(&t1, src);
+      db.add(&t2, src);
+    }
+    db.commit();
+  }
+  double before[4], after[4];
+  {
+    DB db(file);
+    for (int op = 0; op < 4; op++)
+      before[op] = timeReads(db, subjects, p, n, op);
+  }
+  {
+    double t0 = now();
+    MemoryDB db(file);
+    printf("%-24s %12.2f\n", "open (us/triple)", (now() - t0) * 1000000.0 / (2 * n));
+    for (int op = 0; op < 4; op++)
+      after[op] = timeReads(db, subjects, p, n, op);
+  }
+  printf("%-24s %12s %12s %9s\n", "operation (us/op)", "sqlite", "memory", "speedup");
+  for (int op = 0; op < 4; op++)
+    report(ops[op], before[op], after[op], n);
+  delete [] subjects;
+}
+
+static void benchmarkSnapshot(DB &db, const char *file, int n)
+{
+  static const char *ops[] = { "exists", "count [s,*,*]", "query [s,*,*]", "query [*,*,o]" };
+  std::string path = std::string(file) + ".snap";
+  char uri[64];
+  Node *subjects = new Node[n];
+  Node p = db.node("http://example.org/p");
+  Node q = db.node("http://example.org/q");
+  Node src = db.node("http://example.org/a");
+  db.transaction();
+  for (int i = 0; i < n; i++) {
+    sprintf(uri, "http://example.org/s%d", i);
+    subjects[i] = db.node(uri);
+  }
+  for (int i = 0; i < n; i++) {
+    Triple t1(subjects[i], p, subjects[(i + 1) % n]), t2(subjects[i], q, subjects[(i + 7) % n]);
+    db.add(&t1, src);
+    db.add(&t2, src);
+  }
+  db.commit();
+  double before[4], after[4];
+  for (int op = 0; op < 4; op++)
+    before[op] = timeReads(db, subjects, p, n, op);
+  double t0 = now();
+  db.compileSnapshot(path.c_str(), src);
+  printf("%-24s %12.2f\n", "compile (us/triple)", (now() - t0) * 1000000.0 / (2 * n));
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0)
+    printf("%-24s %12.1f\n", "file (bytes/triple)", (double)st.st_size / (2 * n));
+  db.delSource(src);
+  t0 = now();
+  db.attachSnapshot(path.c_str());
+  printf("%-24s %12.2f\n", "attach (ms)", (now() - t0) * 1000.0);
+  for (int op = 0; op < 4; op++)
+    after[op] = timeReads(db, subjects, p, n, op);
+  printf("%-24s %12s %12s %9s\n", "operation (us/op)", "sqlite", "snapshot", "speedup");
+  for (int op = 0; op < 4; op++)
+    report(ops[op], before[op], after[op], n);
+  unlink(path.c_str());
+  delete [] subjects;
+}
+
+static double populate(DB &db, Node *subjects, Node p, Node q, int n)
+{
+  char uri[64];
+  Node src = db.node("http://example.org/a");
+  double t0 = now();
+  db.transaction();
+  for (int i = 0; i < n; i++) {
+    sprintf(uri, "http://example.org/s%d", i);
+    subjects[i] = db.node(uri);
+  }
+  for (int i = 0; i < n; i++) {
+    Triple t1(subjects[i], p, subjects[(i + 1) % n]), t2(subjects[i], q, subjects[(i + 7) % n]);
+    db.add(&t1, src);
+    db.add(&t2, src);
+  }
+  db.commit();
+  return now() - t0;
+}
+
+static void benchmarkSharded(const char *file, int n)
+{
+  static const char *ops[] = { "exists", "count [s,*,*]", "query [s,*,*]", "query [*,*,o]" };
+  std::string sharded = std::string(file) + "-sharded";
+  Node *subjects = new Node[n];
+  double before[5], after[5];
+  {
+    DB db((char *)file);
+    Node p = db.node("http://example.org/p");
+    before[4] = populate(db, subjects, p, db.node("http://example.org/q"), n);
+    for (int op = 0; op < 4; op++)
+      before[op] = timeReads(db, subjects, p, n, op);
+  }
+  {
+    ShardedDB db((char *)sharded.c_str(), 4);
+    Node p = db.node("http://example.org/p");
+    after[4] = populate(db, subjects, p, db.node("http://example.org/q"), n);
+    for (int op = 0; op < 4; op++)
+      after[op] = timeReads(db, subjects, p, n, op);
+  }
+  printf("%-24s %12s %12s %9s\n", "operation (us)", "1 file", "4 shards", "speedup");
+  report("add (per triple)", before[4] / 2, after[4] / 2, n);
+  for (int op = 0; op < 4; op++)
+    report(ops[op], before[op], after[op], n);
+  unlink(sharded.c_str());
+  for (int i = 0; i < 4; i++) {
+    char suffix[32];
+    sprintf(suffix, ".shard%d", i);
+    unlink((sharded + suffix).c_str());
+  }
+  delete [] subjects;
+}
+
+static std::string writeSource(const char *file, int k, int n)
+{
+  char suffix[32];
+  sprintf(suffix, "-src%d.rdf", k);
+  std::string path = std::string(file) + suffix;
+  FILE *out = fopen(path.c_str(), "w");
+  fprintf(out, "<?xml version=\"1.0\"?>\n"
+          "<rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\"\n"
+          "         xmlns:ex=\"http://example.org/\">\n");
+  for (int i = 0; i < n; i++)
+    fprintf(out, "  <rdf:Description rdf:about=\"http://example.org/s%d_%d\">"
+            "<ex:p rdf:resource=\"http://example.org/s%d_%d\"/><ex:q>value %d</ex:q>"
+            "</rdf:Description>\n", k, i, k, (i + 1) % n, i);
+  fprintf(out, "</rdf:RDF>\n");
+  fclose(out);
+  return path;
+}
+
+static void benchmarkLoadMany(const char *file, int n)
+{
+  static const int nSources = 8;
+  std::string paths[nSources];
+  for (int k = 0; k < nSources; k++)
+    paths[k] = writeSource(file, k, n / nSources);
+  std::string many = std::string(file) + "-many";
+  double before, after;
+  {
+    DB db((char *)file);
+    double t0 = now();
+    for (int k = 0; k < nSources; k++)
+      db.load(("file://" + paths[k]).c_str());
+    before = now() - t0;
+  }
+  {
+    DB db((char *)many.c_str());
+    std::vector<Node> sources;
+    std::vector<LoadResult> results;
+    for (int k = 0; k < nSources; k++)
+      sources.push_back(db.node(("file://" + paths[k]).c_str()));
+    double t0 = now();
+    db.loadMany(sources, results);
+    after = now() - t0;
+    for (int k = 0; k < nSources; k++)
+      if (!results[k].ok)
+        fprintf(stderr, "%s: %s\n", paths[k].c_str(), results[k].error.c_str());
+  }
+  printf("%-24s %12s %12s %9s\n", "operation (us)", "load", "loadMany", "speedup");
+  report("load (per triple)", before / 2, after / 2, n);
+  for (int k = 0; k < nSources; k++)
+    unlink(paths[k].c_str());
+  unlink(many.c_str());
+  unlink((many + "-wal").c_str());
+  unlink((many + "-shm").c_str());
+}
+
+static void benchmarkPipeline(const char *file, int n)
+{
+  std::string path = writeSource(file, 0, n);
+  std::string uri = "file://" + path;
+  std::string piped = std::string(file) + "-piped";
+  double before, after;
+  {
+    DB db((char *)file);
+    double t0 = now();
+    db.load(uri.c_str());
+    before = now() - t0;
+  }
+  {
+    DB db((char *)piped.c_str());
+    db.setPipelinedLoad(true);
+    double t0 = now();
+    db.load(uri.c_str());
+    after = now() - t0;
+  }
+  printf("%-24s %12s %12s %9s\n", "operation (us)", "plain", "pipelined", "speedup");
+  report("load (per triple)", before / 2, after / 2, n);
+  unlink(path.c_str());
+  unlink(piped.c_str());
+  unlink((piped + "-wal").c_str());
+  unlink((piped + "-shm").c_str());
+}
+
+// Readers query [s,*,*] until told to stop; the writer adds triples to a
+// source in one transaction (as load() does) until told to stop, then rolls
+// back so that every round starts out with the same table
+
+struct Workload {
+  DB *db;
+  Node *subjects;
+  int n;
+  volatile bool stop;
+  long queries;
+  pthread_mutex_t lock;
+};
+
+static void *readerThread(void *arg)
+{
+  Workload *w = (Workload *)arg;
+  CountTriples action(w->db);
+  unsigned int i = (unsigned int)(size_t)pthread_self();
+  long queries = 0;
+  try {
+    while (!w->stop) {
+      i = i * 1103515245 + 12345;
+      w->db->query(w->subjects[(i >> 8) % w->n], NULL_NODE, NULL_NODE, NULL_NODE, &action);
+      queries++;
+    }
+  }
+  catch (Condition &c) {
+    std::cerr << c;
+  }
+  pthread_mutex_lock(&w->lock);
+  w->queries += queries;
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+static void *writerThread(void *arg)
+{
+  Workload *w = (Workload *)arg;
+  Node source = w->db->node("http://example.org/load");
+  Node p = w->db->node("http://example.org/r");
+  try {
+    w->db->transaction();
+    for (int i = 0; !w->stop; i++) {
+      Triple t(w->subjects[i % w->n], p, w->subjects[(i * 7) % w->n]);
+      w->db->add(&t, source);
+    }
+    w->db->rollback();
+  }
+  catch (Condition &c) {
+    std::cerr << c;
+  }
+  return NULL;
+}
+
+static double throughput(DB &db, Node *subjects, int n, int readers, bool loading)
+{
+  Workload w;
+  w.db = &db;
+  w.subjects = subjects;
+  w.n = n;
+  w.stop = false;
+  w.queries = 0;
+  pthread_mutex_init(&w.lock, NULL);
+  pthread_t writer, threads[64];
+  if (loading) {
+    pthread_create(&writer, NULL, writerThread, &w);
+    usleep(100000);
+  }
+  double t0 = now();
+  for (int i = 0; i < readers; i++)
+    pthread_create(&threads[i], NULL, readerThread, &w);
+  usleep(1000000);
+  w.stop = true;
+  for (int i = 0; i < readers; i++)
+    pthread_join(threads[i], NULL);
+  double elapsed = now() - t0;
+  if (loading)
+    pthread_join(writer, NULL);
+  pthread_mutex_destroy(&w.lock);
+  return w.queries / elapsed;
+}
+
+struct Adder {
+  DB *db;
+  Node *subjects;
+  int first, n;
+};
+
+static void *adderThread(void *arg)
+{
+  Adder *a = (Adder *)arg;
+  Node p = a->db->node("http://example.org/g");
+  try {
+    for (int i = a->first; i < a->first + a->n; i++) {
+      Triple t(a->subjects[i], p, a->subjects[0]);
+      a->db->add(&t);
+    }
+  }
+  catch (Condition &c) {
+    std::cerr << c;
+  }
+  return NULL;
+}
+
+static double addConcurrently(DB &db, Node *subjects, int n, int threads)
+{
+  pthread_t ids[64];
+  Adder adders[64];
+  double t0 = now();
+  for (int i = 0; i < threads; i++) {
+    Adder a = { &db, subjects, i * (n / threads), n / threads };
+    adders[i] = a;
+    pthread_create(&ids[i], NULL, adderThread, &adders[i]);
+  }
+  for (int i = 0; i < threads; i++)
+    pthread_join(ids[i], NULL);
+  return now() - t0;
+}
+
+static void benchmarkGroupCommit(DB &db, int n)
+{
+  static const int threads = 8;
+  Node *subjects = new Node[2 * n];
+  char uri[64];
+  db.transaction();
+  for (int i = 0; i < 2 * n; i++) {
+    sprintf(uri, "http://example.org/g%d", i);
+    subjects[i] = db.node(uri);
+  }
+  db.commit();
+  db.node("http://example.org/g");
+  double before = addConcurrently(db, subjects, n, threads);
+  db.setGroupCommit(1024);
+  double after = addConcurrently(db, subjects + n, n, threads);
+  GroupCommitStats stats = db.groupCommitStats();
+  db.setGroupCommit(0);
+  printf("%-24s %12s %12s %9s\n", "operation (us)", "each", "grouped", "speedup");
+  report("add (8 threads)", before, after, n);
+  printf("%lu batches, %.1f calls per batch (at most %lu), %.0f us per commit, %.0f us waited\n",
+         stats.batches, stats.batches ? (double)stats.writes / stats.batches : 0.0,
+         stats.largest, stats.commitTime, stats.waitTime);
+  delete [] subjects;
+}
+
+static void benchmarkConcurrency(DB &db, int n)
+{
+  char uri[64];
+  Node *subjects = new Node[n];
+  Node p = db.node("http://example.org/p");
+  Node q = db.node("http://example.org/q");
+  Node src = db.node("http://example.org/a");
+  db.transaction();
+  for (int i = 0; i < n; i++) {
+    sprintf(uri, "http://example.org/s%d", i);
+    subjects[i] = db.node(uri);
+  }
+  for (int i = 0; i < n; i++) {
+    Triple t1(subjects[i], p, subjects[(i + 1) % n]), t2(subjects[i], q, subjects[(i + 7) % n]);
+    db.add(&t1, src);
+    db.add(&t2, src);
+  }
+  db.commit();
+  printf("%-24s %12s %12s\n", "readers (queries/s)", "idle", "loading");
+  for (int readers = 1; readers <= 8; readers *= 2) {
+    double idle = throughput(db, subjects, n, readers, false);
+    double loading = throughput(db, subjects, n, readers, true);
+    printf("%-24d %12.0f %12.0f\n", readers, idle, loading);
+  }
+  delete [] subjects;
+}
+
+static const char *layouts[][2] = {
+  { "0.1",
+    "CREATE TABLE triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER);"
+    "CREATE INDEX s ON triple (s);"
+    "CREATE INDEX o ON triple (o);"
+    "CREATE INDEX sp ON triple (s, p);"
+    "CREATE INDEX spo ON triple (s, p, o);"
+    "CREATE INDEX po ON triple (p, o);" },
+  { "0.2",
+    "CREATE TABLE triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER);"
+    "CREATE UNIQUE INDEX spos ON triple (s, p, o, src);"
+    "CREATE INDEX o ON triple (o);"
+    "CREATE INDEX po ON triple (p, o);" },
+  { "0.3",
+    "CREATE TABLE triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER,"
+    "                     PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;"
+    "CREATE INDEX pos ON triple (p, o);"
+    "CREATE INDEX osp ON triple (o, s);"
+    "CREATE INDEX srcspo ON triple (src);" }
+};
+static const int nLayouts = sizeof(layouts) / sizeof(layouts[0]);
+
+static const struct { const char *name; int mask; } shapes[] = {
+  { "[s,*,*]", 1 }, { "[*,p,*]", 2 }, { "[*,*,o]", 4 }, { "[s,p,*]", 3 },
+  { "[s,*,o]", 5 }, { "[*,p,o]", 6 }, { "[s,p,o]", 7 }, { "src", 8 },
+  { "[s,*,*] src", 9 }, { "[*,*,o] src", 12 }, { "[*,p,o] src", 14 },
+  { "[s,p,o] src", 15 }
+};
+static const int nShapes = sizeof(shapes) / sizeof(shapes[0]);
+
+static unsigned int lcg(unsigned int *seed)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 8);
+}
+
+static std::string shapeQuery(int mask)
+{
+  const char *conditions[] = { "s=?1", "p=?2", "o=?3", (mask == 8) ? "src=?4" : "+src=?4" };
+  std::string query("SELECT s, p, o FROM triple"); // as in DB::makeWildcardQuery()
+  const char *glue = " WHERE ";
+  for (int i = 0; i < 4; i++)
+    if (mask & (1 << i)) {
+      query.append(glue);
+      query.append(conditions[i]);
+      glue = " AND ";
+    }
+  return query;
+}
+
+static void benchmarkLayout(const char *file, int n)
+{
+  int *data = new int[4 * n];
+  unsigned int seed = 1;
+  for (int i = 0; i < n; i++) {
+    data[4 * i]     = lcg(&seed) % (n / 10 + 1) + 1000;
+    data[4 * i + 1] = lcg(&seed) % 50 + 1;
+    data[4 * i + 2] = lcg(&seed) % (n / 4 + 1) + 1000;
+    data[4 * i + 3] = lcg(&seed) % 20 + 100;
+  }
+  int queries = 200;
+  double results[2 + nShapes][nLayouts];
+  for (int l = 0; l < nLayouts; l++) {
+    std::string name = std::string(file) + "." + layouts[l][0];
+    unlink(name.c_str());
+    SQL::Database *sql = new SQL::Database(name.c_str());
+    char *msg = NULL;
+    if (sql->exec(layouts[l][1], NULL, NULL, &msg) != SQL::Database::OK)
+      FAIL(msg);
+    double t0 = now();
+    sql->exec("BEGIN", NULL, NULL, &msg);
+    SQL::Statement *insert = new SQL::Statement(sql, "INSERT OR IGNORE INTO triple VALUES (?1, ?2, ?3, ?4)");
+    for (int i = 0; i < n; i++) {
+      for (int k = 0; k < 4; k++)
+        insert->bind(k + 1, data[4 * i + k]);
+      insert->step();
+      insert->reset();
+    }
+    delete insert;
+    sql->exec("COMMIT", NULL, NULL, &msg);
+    results[0][l] = (now() - t0) * 1000000.0 / n;
+    for (int q = 0; q < nShapes; q++) {
+      SQL::Statement *select = new SQL::Statement(sql, shapeQuery(shapes[q].mask).c_str());
+      unsigned int pick = 7;
+      t0 = now();
+      for (int j = 0; j < queries; j++) {
+        int i = lcg(&pick) % n;
+        for (int k = 0; k < 4; k++)
+          if (shapes[q].mask & (1 << k))
+            select->bind(k + 1, data[4 * i + k]);
+        while (select->step())
+          ;
+        select->reset();
+      }
+      results[2 + q][l] = (now() - t0) * 1000000.0 / queries;
+      delete select;
+    }
+    delete sql;
+    struct stat st;
+    results[1][l] = (stat(name.c_str(), &st) == 0) ? (double)st.st_size / n : 0.0;
+    unlink(name.c_str());
+  }
+  printf("%-24s", "layout");
+  for (int l = 0; l < nLayouts; l++)
+    printf(" %12s", layouts[l][0]);
+  printf("\n%-24s", "insert (us/triple)");
+  for (int l = 0; l < nLayouts; l++)
+    printf(" %12.2f", results[0][l]);
+  printf("\n%-24s", "file (bytes/triple)");
+  for (int l = 0; l < nLayouts; l++)
+    printf(" %12.1f", results[1][l]);
+  printf("\n");
+  for (int q = 0; q < nShapes; q++) {
+    printf("%-24s", (std::string("query ") + shapes[q].name + " (us)").c_str());
+    for (int l = 0; l < nLayouts; l++)
+      printf(" %12.2f", results[2 + q][l]);
+    printf("\n");
+  }
+  delete [] data;
+}
+
+struct Lookups {
+  DB *db;
+  Node *subjects;
+  Node *literals;
+  int n;
+  std::string content;
+  volatile bool stop;
+  long lookups;
+  long adds;
+  long loads;
+  pthread_mutex_t lock;
+};
+
+static void *lookupThread(void *arg)
+{
+  Lookups *w = (Lookups *)arg;
+  unsigned int i = (unsigned int)(size_t)pthread_self();
+  long lookups = 0;
+  char str[64];
+  try {
+    while (!w->stop) {
+      i = i * 1103515245 + 12345;
+      int k = (i >> 8) % w->n;
+      switch (lookups % 4) {
+        case 0:
+          sprintf(str, "http://example.org/s%d", k);
+          w->db->node(str);
+          break;
+        case 1:
+          sprintf(str, "value %d", k);
+          w->db->literal(str, NULL_NODE, NULL);
+          break;
+        case 2:
+          free(w->db->info(w->subjects[k]));
+          break;
+        default:
+          free(w->db->toString(w->literals[k]));
+          break;
+      }
+      lookups++;
+    }
+  }
+  catch (Condition &c) {
+    std::cerr << c;
+  }
+  pthread_mutex_lock(&w->lock);
+  w->lookups += lookups;
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+static void *reloadThread(void *arg)
+{
+  Lookups *w = (Lookups *)arg;
+  Node source = w->db->node("http://example.org/contention");
+  try {
+    while (!w->stop) {
+      w->db->load(source, (unsigned char *)w->content.c_str(), false);
+      w->loads++;
+    }
+  }
+  catch (Condition &c) {
+    std::cerr << c;
+  }
+  return NULL;
+}
+
+static void *internThread(void *arg)
+{
+  Lookups *w = (Lookups *)arg;
+  Node p = w->db->node("http://example.org/new");
+  char uri[64];
+  try {
+    for (int i = 0; !w->stop; i++) {
+      sprintf(uri, "http://example.org/new%ld_%d", (long)w->loads, i);
+      Triple t(w->db->node(uri), p, w->subjects[i % w->n]);
+      w->db->add(&t);
+      w->adds++;
+    }
+  }
+  catch (Condition &c) {
+    std::cerr << c;
+  }
+  return NULL;
+}
+
+static double lookupRate(Lookups &w, int threads, bool writing)
+{
+  pthread_t reloader, interner, ids[64];
+  w.stop = false;
+  w.lookups = w.adds = w.loads = 0;
+  if (writing) {
+    pthread_create(&reloader, NULL, reloadThread, &w);
+    pthread_create(&interner, NULL, internThread, &w);
+    usleep(100000);
+  }
+  double t0 = now();
+  for (int i = 0; i < threads; i++)
+    pthread_create(&ids[i], NULL, lookupThread, &w);
+  usleep(1000000);
+  w.stop = true;
+  for (int i = 0; i < threads; i++)
+    pthread_join(ids[i], NULL);
+  double elapsed = now() - t0;
+  if (writing) {
+    pthread_join(reloader, NULL);
+    pthread_join(interner, NULL);
+  }
+  return w.lookups / elapsed;
+}
+
+static void benchmarkContention(DB &db, const char *file, int n)
+{
+  Lookups w;
+  w.db = &db;
+  w.n = n;
+  w.subjects = new Node[n];
+  w.literals = new Node[n];
+  pthread_mutex_init(&w.lock, NULL);
+  char str[64];
+  db.transaction();
+  for (int i = 0; i < n; i++) {
+    sprintf(str, "http://example.org/s%d", i);
+    w.subjects[i] = db.node(str);
+    sprintf(str, "value %d", i);
+    w.literals[i] = db.literal(str, NULL_NODE, NULL);
+  }
+  db.commit();
+  std::string path = writeSource(file, 0, n);
+  FILE *in = fopen(path.c_str(), "r");
+  char buffer[4096];
+  size_t length;
+  while ((length = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    w.content.append(buffer, length);
+  fclose(in);
+  unlink(path.c_str());
+  printf("%-24s %12s %12s %12s %8s\n", "threads (lookups/s)", "idle", "writing", "adds", "loads");
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    double idle = lookupRate(w, threads, false);
+    double writing = lookupRate(w, threads, true);
+    printf("%-24d %12.0f %12.0f %12ld %8ld\n", threads, idle, writing, w.adds, w.loads);
+  }
+  pthread_mutex_destroy(&w.lock);
+  delete [] w.subjects;
+  delete [] w.literals;
+}
+
+static bool expect(bool ok, const std::string &what)
+{
+  if (!ok)
+    fprintf(stderr, "FAILED: %s\n", what.c_str());
+  return ok;
+}
+
+static size_t appendText(char *data, size_t size, size_t n, std::string *text)
+{
+  text->append(data, size * n);
+  return size * n;
+}
+
+// The requests the stand-in has served since it was last asked
+
+static std::string standinRequests(const std::string &standin)
+{
+  using namespace libcurl;
+  std::string text;
+  if (standin.empty())
+    return text;
+  Curl curl;
+  curl.setURL((standin + "-/requests").c_str());
+  curl.setOption(CURLOPT_WRITEFUNCTION, (void *)appendText);
+  curl.setOption(CURLOPT_WRITEDATA, &text);
+  curl.perform();
+  return text;
+}
+
+static std::string writeNTriples(const char *file, int n)
+{
+  std::string path = std::string(file) + "-fetch.nt";
+  FILE *out = fopen(path.c_str(), "w");
+  for (int i = 0; i < n; i++)
+    fprintf(out, "<http://example.org/s%d> <http://example.org/p> <http://example.org/s%d> .\n"
+            "<http://example.org/s%d> <http://example.org/q> \"value %d\" .\n",
+            i, (i + 1) % n, i, i);
+  fclose(out);
+  return path;
+}
+
+static double loadOnce(DB &db, Node source, LoadResult &result)
+{
+  std::vector<Node> sources(1, source);
+  std::vector<LoadResult> results;
+  double t0 = now();
+  db.loadMany(sources, results);
+  double elapsed = now() - t0;
+  result = results[0];
+  return elapsed;
+}
+
+static void removeStore(const std::string &store)
+{
+  unlink(store.c_str());
+  unlink((store + "-wal").c_str());
+  unlink((store + "-shm").c_str());
+}
+
+// Loads a source, loads it again unchanged, changes it and loads it once more;
+// with a stand-in, a second store then loads it through the fetch cache
+
+static bool fetchFrom(const char *file, const char *label, const std::string &base,
+                      const std::string &standin, int n)
+{
+  std::string path = writeNTriples(file, n);
+  std::string name = path.substr(path.rfind('/') + 1);
+  std::string uri = base + name;
+  std::string request = "GET /" + name;
+  std::string store = std::string(file) + "-" + label;
+  std::string cache = std::string(file) + "-cache";
+  struct utimbuf old = { time(NULL) - 100, time(NULL) - 100 };
+  utime(path.c_str(), &old);
+  mkdir(cache.c_str(), 0777);
+  standinRequests(standin);
+  bool ok = true;
+  double fetched, unchanged, cached = 0;
+  LoadResult result;
+  {
+    DB db((char *)store.c_str());
+    db.setFetchCache(cache.c_str());
+    Node source = db.node(uri.c_str());
+    fetched = loadOnce(db, source, result);
+    ok &= expect(result.ok && !result.unchanged, uri + " was not loaded: " + result.error);
+    ok &= expect(db.count(NULL_NODE, NULL_NODE, NULL_NODE, source, false) == 2 * n,
+                 uri + " did not load all of its triples");
+    ok &= expect(standin.empty() || (standinRequests(standin) == request + " 200\n"),
+                 uri + " was not fetched with one GET");
+    unchanged = loadOnce(db, source, result);
+    ok &= expect(result.ok && result.unchanged, uri + " was loaded again, unchanged");
+    ok &= expect(standin.empty() || (standinRequests(standin) == request + " 304\n"),
+                 uri + " was transferred again, unchanged");
+    writeNTriples(file, n + 1);
+    loadOnce(db, source, result);
+    ok &= expect(result.ok && !result.unchanged, uri + " was not loaded again, changed");
+    ok &= expect(db.count(NULL_NODE, NULL_NODE, NULL_NODE, source, false) == 2 * (n + 1),
+                 uri + " kept triples it no longer has");
+    standinRequests(standin);
+  }
+  if (!standin.empty()) {
+    std::string other = store + "-other";
+    DB db((char *)other.c_str());
+    db.setFetchCache(cache.c_str());
+    Node source = db.node(uri.c_str());
+    cached = loadOnce(db, source, result);
+    ok &= expect(result.ok && !result.unchanged, uri + " was not loaded from the cache");
+    ok &= expect(db.count(NULL_NODE, NULL_NODE, NULL_NODE, source, false) == 2 * (n + 1),
+                 uri + " did not load all of its triples from the cache");
+    ok &= expect(standinRequests(standin) == request + " 304\n",
+                 uri + " was transferred again, though cached");
+    removeStore(other);
+  }
+  report((std::string(label) + " not modified").c_str(), fetched, unchanged, 1);
+  if (!standin.empty())
+    report((std::string(label) + " from cache").c_str(), fetched, cached, 1);
+  removeStore(store);
+  unlink(path.c_str());
+  system(("rm -rf " + cache).c_str());
+  return ok;
+}
+
+static bool benchmarkFetch(const char *file, int n)
+{
+  std::string path(file);
+  size_t slash = path.rfind('/');
+  std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+  char *real = realpath(dir.c_str(), NULL);
+  std::string base = "file://" + std::string(real ? real : dir.c_str()) + "/";
+  free(real);
+  std::string standin = getenv("PIGLET_STANDIN") ? getenv("PIGLET_STANDIN") : "";
+  if (!standin.empty() && (standin[standin.size() - 1] != '/'))
+    standin += "/";
+  printf("%-24s %12s %12s %9s\n", "load (us)", "fetched", "conditional", "speedup");
+  bool ok = fetchFrom(file, "file", base, "", n);
+  if (!standin.empty())
+    ok &= fetchFrom(file, "http", standin, standin, n);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s file [ops|bulk|memory|snapshot|sharded|loadmany|pipeline|groupcommit|concurrency|contention|layout|fetch [n]]\n", argv[0]);
+    exit(1);
+  }
+  const char *suite = (argc > 2) ? argv[2] : "ops";
+  int n = (argc > 3) ? atoi(argv[3]) : 10000;
+  unlink(argv[1]);
+  unlink((std::string(argv[1]) + "-wal").c_str());
+  unlink((std::string(argv[1]) + "-shm").c_str());
+  try {
+    if (strcmp(suite, "layout") == 0) {
+      benchmarkLayout(argv[1], n);
+      exit(0);
+    }
+    if (strcmp(suite, "memory") == 0) {
+      benchmarkMemory(argv[1], n);
+      exit(0);
+    }
+    if (strcmp(suite, "sharded") == 0) {
+      benchmarkSharded(argv[1], n);
+      exit(0);
+    }
+    if (strcmp(suite, "loadmany") == 0) {
+      benchmarkLoadMany(argv[1], n);
+      exit(0);
+    }
+    if (strcmp(suite, "pipeline") == 0) {
+      benchmarkPipeline(argv[1], n);
+      exit(0);
+    }
+    if (strcmp(suite, "fetch") == 0)
+      exit(benchmarkFetch(argv[1], n) ? 0 : 1);
+    DB db(argv[1]);
+    if (strcmp(suite, "ops") == 0)
+      benchmarkOps(db, n);
+    else if (strcmp(suite, "bulk") == 0)
+      benchmarkBulk(db, n);
+    else if (strcmp(suite, "snapshot") == 0)
+      benchmarkSnapshot(db, argv[1], n);
+    else if (strcmp(suite, "groupcommit") == 0)
+      benchmarkGroupCommit(db, n);
+    else if (strcmp(suite, "concurrency") == 0)
+      benchmarkConcurrency(db, n);
+    else if (strcmp(suite, "contention") == 0)
+      benchmarkContention(db, argv[1], n);
+    else {
+      fprintf(stderr, "Unknown suite %s\n", suite);
+      exit(1);
+    }
+  }
+  catch (Condition &c) {
+    std::cerr << c;
+    exit(1);
+  }
+  exit(0);
+}
@@ -45,6 +45,10 @@ extern "C" {
 #include <cstdlib>
 #include "Curl.h"
 #include "DB.h"
+#include "MemoryDB.h"
+#include "ShardedDB.h"
+#include "LoadJob.h"
+#include "Importer.h"
 
 const char *piglet_error_message;
 
@@ -71,6 +75,31 @@ DB piglet_open(char *name)
   }
 }
 
+DB piglet_open_backend(char *name, PigletBackend backend)
+{
+  try {
+    if (backend == PigletMemory)
+      return (DB)new Piglet::MemoryDB(name, false);
+    else
+      return (DB)new Piglet::DB(name, false);
+  }
+  catch (Piglet::Condition &c) {
+    piglet_error(c);
+    return NULL;
+  }
+}
+
+DB piglet_open_sharded(char *name, int shards)
+{
+  try {
+    return (DB)new Piglet::ShardedDB(name, shards, false);
+  }
+  catch (Piglet::Condition &c) {
+    piglet_error(c);
+    return NULL;
+  }
+}
+
 PigletStatus piglet_close(DB db)
 {
   try {
@@ -119,6 +148,43 @@ PigletStatus piglet_query(DB db, Node s, Node p, Node o, Node source, void* user
   }
 }
 
+PigletCursor piglet_query_open(DB db, Node s, Node p, Node o, Node source)
+{
+  try {
+    return (PigletCursor)((Piglet::DB *)db)->cursor(Piglet::Node(s),
+                                                    Piglet::Node(p),
+                                                    Piglet::Node(o),
+                                                    Piglet::Node(source));
+  }
+  catch (Piglet::Condition &c) {
+    piglet_error(c);
+    return NULL;
+  }
+}
+
+PigletStatus piglet_query_next(PigletCursor cursor, Node *s, Node *p, Node *o)
+{
+  try {
+    Piglet::TripleCursor *c = (Piglet::TripleCursor *)cursor;
+    if (!c->hasNext())
+      return PigletFalse;
+    Piglet::Triple t = c->next();
+    *s = id(t.s());
+    *p = id(t.p());
+    *o = id(t.o());
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_query_close(PigletCursor cursor)
+{
+  delete (Piglet::TripleCursor *)cursor;
+  return PigletTrue;
+}
+
 class CallbackNodeAction : public Piglet::NodeAction {
 public:
   CallbackNodeAction(Piglet::DB *db, void *userdata, NodeCallback callback)
@@ -203,6 +269,152 @@ PigletStatus piglet_load(DB db, Node source, bool append, bool verbose, char* sc
   }
 }
 
+class CallbackLoadProgress : public Piglet::LoadProgress {
+public:
+  CallbackLoadProgress(DB db, void *userdata, LoadProgressCallback callback)
+  { _db = db; _userdata = userdata; _callback = callback; }
+  void operator()(const Piglet::LoadStatus &status);
+private:
+  DB _db;
+  void *_userdata;
+  LoadProgressCallback _callback;
+};
+
+void CallbackLoadProgress::operator()(const Piglet::LoadStatus &status)
+{
+  PigletLoadProgress progress = { status.parsed, status.inserted, status.bytes };
+  _callback(_db, _userdata, &progress);
+}
+
+struct AsyncLoad {
+  Piglet::LoadJob *job;
+  CallbackLoadProgress *progress;
+  std::string error;
+};
+
+PigletLoad piglet_load_async(DB db, Node source, bool append, bool verbose,
+                             void *userdata, LoadProgressCallback callback)
+{
+  AsyncLoad *load = new AsyncLoad;
+  load->progress = callback ? new CallbackLoadProgress(db, userdata, callback) : NULL;
+  try {
+    load->job = ((Piglet::DB *)db)->loadAsync(Piglet::Node(source), append, verbose,
+                                              load->progress);
+    return (PigletLoad)load;
+  }
+  catch (Piglet::Condition &c) {
+    piglet_error(c);
+    delete load->progress;
+    delete load;
+    return NULL;
+  }
+}
+
+PigletStatus piglet_load_poll(PigletLoad load)
+{
+  return piglet_success(((AsyncLoad *)load)->job->poll());
+}
+
+PigletStatus piglet_load_wait(PigletLoad load)
+{
+  AsyncLoad *l = (AsyncLoad *)load;
+  switch (l->job->wait()) {
+    case Piglet::LoadJob::LOADED:
+      return PigletTrue;
+    case Piglet::LoadJob::FAILED:
+      l->error = l->job->error();
+      if (!l->error.empty()) {
+        piglet_error_message = l->error.c_str();
+        return PigletError;
+      }
+    default:
+      return PigletFalse;
+  }
+}
+
+PigletStatus piglet_load_cancel(PigletLoad load)
+{
+  ((AsyncLoad *)load)->job->cancel();
+  return PigletTrue;
+}
+
+PigletStatus piglet_load_progress(PigletLoad load, PigletLoadProgress *progress)
+{
+  Piglet::LoadStatus status = ((AsyncLoad *)load)->job->status();
+  progress->parsed = status.parsed;
+  progress->inserted = status.inserted;
+  progress->bytes = status.bytes;
+  return PigletTrue;
+}
+
+PigletStatus piglet_load_close(PigletLoad load)
+{
+  AsyncLoad *l = (AsyncLoad *)load;
+  delete l->job; // waits for the load to end
+  delete l->progress;
+  delete l;
+  return PigletTrue;
+}
+
+PigletStatus piglet_set_fetch_cache(DB db, const char *dir)
+{
+  ((Piglet::DB *)db)->setFetchCache(dir);
+  return PigletTrue;
+}
+
+PigletStatus piglet_load_many(DB db, Node *sources, int n, PigletStatus *results, bool append, bool verbose)
+{
+  try {
+    std::vector<Piglet::Node> nodes(sources, sources + n);
+    std::vector<Piglet::LoadResult> loaded;
+    ((Piglet::DB *)db)->loadMany(nodes, loaded, append, verbose);
+    bool all = true;
+    for (int i = 0; i < n; i++) {
+      results[i] = piglet_success(loaded[i].ok);
+      all = all && loaded[i].ok;
+    }
+    return piglet_success(all);
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_reload(DB db, Node source, bool verbose, PigletReloadCounts *counts)
+{
+  try {
+    Piglet::ReloadResult result;
+    bool ok = ((Piglet::DB *)db)->reload(Piglet::Node(source), result, verbose);
+    if (counts != NULL) {
+      counts->added = result.added;
+      counts->removed = result.removed;
+      counts->kept = result.kept;
+    }
+    return piglet_success(ok);
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_refresh_sources(DB db, bool verbose, PigletRefreshCounts *counts)
+{
+  try {
+    Piglet::RefreshResult result;
+    ((Piglet::DB *)db)->refreshAll(&result, verbose);
+    if (counts != NULL) {
+      counts->checked = result.checked;
+      counts->stale = result.stale;
+      counts->loaded = result.loaded;
+      counts->unknown = result.unknown;
+    }
+    return piglet_success(result.loaded == result.stale);
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
 PigletStatus piglet_load_m3(DB db, Node source, unsigned char* content, bool verbose)
 {
   try {
@@ -213,6 +425,55 @@ PigletStatus piglet_load_m3(DB db, Node source, unsigned char* content, bool ver
   }
 }
 
+PigletChunkedLoad piglet_load_begin(DB db, Node source, bool verbose)
+{
+  try {
+    return ((Piglet::DB *)db)->loadBegin(Piglet::Node(source), verbose);
+  }
+  catch (Piglet::Condition &c) {
+    piglet_error(c);
+    return NULL;
+  }
+}
+
+PigletStatus piglet_load_chunk(PigletChunkedLoad load, const unsigned char *data, size_t length)
+{
+  try {
+    return piglet_success(((Piglet::ChunkedLoad *)load)->chunk(data, length));
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_load_end(PigletChunkedLoad load)
+{
+  Piglet::ChunkedLoad *l = (Piglet::ChunkedLoad *)load;
+  PigletStatus status;
+  try {
+    status = piglet_success(l->end());
+  }
+  catch (Piglet::Condition &c) {
+    status = piglet_error(c);
+  }
+  delete l;
+  return status;
+}
+
+PigletStatus piglet_load_abort(PigletChunkedLoad load)
+{
+  Piglet::ChunkedLoad *l = (Piglet::ChunkedLoad *)load;
+  PigletStatus status = PigletTrue;
+  try {
+    l->abort();
+  }
+  catch (Piglet::Condition &c) {
+    status = piglet_error(c);
+  }
+  delete l;
+  return status;
+}
+
 char *piglet_info(DB db, Node node, Node *datatype, char *language)
 {
   try {
@@ -394,3 +655,160 @@ PigletStatus piglet_rollback(DB db)
     return piglet_error(c);
   }
 }
+
+PigletStatus piglet_begin_bulk(DB db, bool dropIndexes)
+{
+  try {
+    ((Piglet::DB *)db)->beginBulk(dropIndexes);
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_end_bulk(DB db)
+{
+  try {
+    ((Piglet::DB *)db)->endBulk();
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_compile_snapshot(DB db, const char *path, Node source)
+{
+  try {
+    ((Piglet::DB *)db)->compileSnapshot(path, Piglet::Node(source));
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_attach_snapshot(DB db, const char *path)
+{
+  try {
+    ((Piglet::DB *)db)->attachSnapshot(path);
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+static void piglet_fill_cache_stats(PigletCacheStats *stats, const Piglet::NodeCache &cache)
+{
+  if (stats) {
+    stats->hits = cache.hits();
+    stats->misses = cache.misses();
+    stats->entries = cache.size();
+    stats->capacity = cache.capacity();
+  }
+}
+
+PigletStatus piglet_cache_stats(DB db, PigletCacheStats *nodes, PigletCacheStats *bnodes)
+{
+  piglet_fill_cache_stats(nodes, ((Piglet::DB *)db)->nodeCache());
+  piglet_fill_cache_stats(bnodes, ((Piglet::DB *)db)->bnodeCache());
+  return PigletTrue;
+}
+
+PigletStatus piglet_set_cache_size(DB db, unsigned long entries)
+{
+  ((Piglet::DB *)db)->setNodeCacheSize(entries);
+  return PigletTrue;
+}
+
+PigletStatus piglet_set_group_commit(DB db, unsigned long maxBatch, long maxDelay)
+{
+  try {
+    ((Piglet::DB *)db)->setGroupCommit(maxBatch, maxDelay);
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_group_commit_stats(DB db, PigletGroupCommitStats *stats)
+{
+  Piglet::GroupCommitStats s = ((Piglet::DB *)db)->groupCommitStats();
+  stats->batches = s.batches;
+  stats->writes = s.writes;
+  stats->largest = s.largest;
+  stats->commitTime = s.commitTime;
+  stats->waitTime = s.waitTime;
+  return PigletTrue;
+}
+
+PigletStatus piglet_set_refresh(DB db, long interval)
+{
+  try {
+    ((Piglet::DB *)db)->setRefresh(interval);
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_set_refresh_interval(DB db, Node source, long interval)
+{
+  try {
+    ((Piglet::DB *)db)->setRefreshInterval(Piglet::Node(source), interval);
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+PigletStatus piglet_set_lock_stats(DB db, bool enabled)
+{
+  try {
+    ((Piglet::DB *)db)->setLockStats(enabled);
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
+
+int piglet_lock_stats(DB db, PigletLockStats *stats, int n)
+{
+  try {
+    std::vector<mutex::LockStats> sites;
+    ((Piglet::DB *)db)->lockStats(sites);
+    for (int i = 0; (i < n) && (i < (int)sites.size()); i++) {
+      stats[i].site = sites[i].site;
+      stats[i].acquisitions = sites[i].acquisitions;
+      stats[i].contended = sites[i].contended;
+      stats[i].waitTime = sites[i].waitTime;
+      stats[i].maxWait = sites[i].maxWait;
+      stats[i].holdTime = sites[i].holdTime;
+      stats[i].maxHold = sites[i].maxHold;
+    }
+    return (int)sites.size();
+  }
+  catch (Piglet::Condition &c) {
+    piglet_error(c);
+    return -1;
+  }
+}
+
+PigletStatus piglet_import(const char *path, const char **files, int n, unsigned long memory,
+                           bool verbose)
+{
+  try {
+    Piglet::ImportOptions options = { memory, 0, "", verbose };
+    Piglet::import(path, std::vector<std::string>(files, files + n), &options);
+    return PigletTrue;
+  }
+  catch (Piglet::Condition &c) {
+    return piglet_error(c);
+  }
+}
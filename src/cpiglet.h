@@ -57,24 +57,95 @@ typedef int Node;
 
 typedef void *DB;
 
+typedef void *PigletCursor;
+
+typedef void *PigletLoad;
+
+typedef void *PigletChunkedLoad;
+
 typedef bool (*TripleCallback)(DB db, void *userdata, Node s, Node p, Node o);
 
 typedef bool (*NodeCallback)(DB db, void *userdata, Node node);
 
 typedef enum { PigletFalse, PigletTrue, PigletError } PigletStatus;
 
+typedef struct {
+  long parsed;
+  long inserted;
+  long bytes;
+} PigletLoadProgress;
+
+typedef struct {
+  long added;
+  long removed;
+  long kept;
+} PigletReloadCounts;
+
+typedef struct {
+  long checked;
+  long stale;   // changed since they were last loaded
+  long loaded;  // of those, loaded again
+  long unknown; // could not be checked
+} PigletRefreshCounts;
+
+typedef void (*LoadProgressCallback)(DB db, void *userdata, const PigletLoadProgress *progress);
+
+typedef enum { PigletSQLite, PigletMemory } PigletBackend;
+
+typedef struct {
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long entries;
+  unsigned long capacity;
+} PigletCacheStats;
+
+typedef struct {
+  unsigned long batches;
+  unsigned long writes;
+  unsigned long largest;
+  double commitTime; // microseconds per batch
+  double waitTime;   // microseconds per call
+} PigletGroupCommitStats;
+
+typedef struct {
+  const char *site; // NULL for acquisitions without one
+  unsigned long acquisitions;
+  unsigned long contended;
+  double waitTime; // microseconds in total
+  double maxWait;
+  double holdTime; // microseconds in total
+  double maxHold;
+} PigletLockStats;
+
 extern const char *piglet_error_message;
 
 
 // Open triple store or create a new one, then make it "current"
 DB piglet_open(char *name);
 
+// Open triple store with the given backend; PigletMemory answers triple
+// queries from in-memory indexes built at open time
+DB piglet_open_backend(char *name, PigletBackend backend);
+
+// Open triple store with triples partitioned by subject over the given
+// number of shard files (0 reopens an existing sharded store as it is)
+DB piglet_open_sharded(char *name, int shards);
+
 // Close triple store
 PigletStatus piglet_close(DB db);
 
 // Query for triples
 PigletStatus piglet_query(DB db, Node s, Node p, Node o, Node source, void* userdata, TripleCallback callback);
 
+// Open a pull-style cursor over triples matching a pattern (NULL on error)
+PigletCursor piglet_query_open(DB db, Node s, Node p, Node o, Node source);
+
+// Fetch the next triple from a cursor (PigletFalse when exhausted)
+PigletStatus piglet_query_next(PigletCursor cursor, Node *s, Node *p, Node *o);
+
+// Release a cursor, whether or not it was exhausted
+PigletStatus piglet_query_close(PigletCursor cursor);
+
 // Query for triple sources
 PigletStatus piglet_sources(DB db, Node s, Node p, Node o, void *userdata, NodeCallback callback);
 
@@ -93,12 +164,73 @@ PigletStatus piglet_del(DB db, Node s, Node p, Node o, Node source, bool tempora
 // Remove an entire source from triple store
 PigletStatus piglet_del_source(DB db, Node source, bool triplesOnly);
 
-// Load triples from source node's URL
+// Load triples from source node's URL; URLs ending in .nt or .nq are read as
+// N-Triples or N-Quads (whose graph labels become the sources of their triples;
+// reloading or deleting the source empties those graphs as well). The URL is fetched with one conditional GET, and nothing is done if it has
+// not changed since it was last loaded
 PigletStatus piglet_load(DB db, Node source, bool append, bool verbose, char* script, char *argv[]);
 
+// Start loading triples from source node's URL on a thread of its own; the
+// callback (may be NULL) is called on that thread as the load progresses
+PigletLoad piglet_load_async(DB db, Node source, bool append, bool verbose,
+                             void *userdata, LoadProgressCallback callback);
+
+// PigletTrue once an asynchronous load has ended
+PigletStatus piglet_load_poll(PigletLoad load);
+
+// Wait for an asynchronous load to end; result as with piglet_load
+// (PigletFalse if the load was cancelled)
+PigletStatus piglet_load_wait(PigletLoad load);
+
+// Make an asynchronous load stop and roll back
+PigletStatus piglet_load_cancel(PigletLoad load);
+
+// Progress of an asynchronous load so far
+PigletStatus piglet_load_progress(PigletLoad load, PigletLoadProgress *progress);
+
+// Wait for an asynchronous load to end, and release it
+PigletStatus piglet_load_close(PigletLoad load);
+
+// Keep the content of sources fetched over the network in a directory, so that
+// loading them into another store (or again after piglet_del_source) can
+// reuse it if it is still current; NULL stops caching
+PigletStatus piglet_set_fetch_cache(DB db, const char *dir);
+
+// Load triples from several sources, parsing them in parallel; results[i]
+// tells whether sources[i] was loaded (or needed no reloading). Returns
+// PigletFalse if any of the sources failed
+PigletStatus piglet_load_many(DB db, Node *sources, int n, PigletStatus *results, bool append, bool verbose);
+
+// Reload triples from source node's URL if it has changed since it was last
+// loaded, adding and removing only the triples that differ; counts (may be
+// NULL) tell how many were (PigletFalse if parsing failed)
+PigletStatus piglet_reload(DB db, Node source, bool verbose, PigletReloadCounts *counts);
+
+// Check all sources for changes since they were last loaded, many at once
+// with conditional requests, and load only those that have changed; counts
+// (may be NULL) tell how many were (PigletFalse if any of them failed to load)
+PigletStatus piglet_refresh_sources(DB db, bool verbose, PigletRefreshCounts *counts);
+
 // Load triples from string
 PigletStatus piglet_load_m3(DB db, Node source, unsigned char* content, bool verbose);
 
+// Begin loading RDF/XML content (N-Triples or N-Quads for .nt or .nq sources)
+// for source node that the caller supplies in chunks, e.g. as it arrives from
+// the network (NULL on error); writes from other threads wait until the load
+// ends, and all calls must come from the thread that began it
+PigletChunkedLoad piglet_load_begin(DB db, Node source, bool verbose);
+
+// Parse the next chunk of content, which need not be NUL-terminated
+// (PigletFalse once parsing has failed)
+PigletStatus piglet_load_chunk(PigletChunkedLoad load, const unsigned char *data, size_t length);
+
+// Finish parsing and commit the load (PigletFalse, and rolled back, if parsing
+// failed), and release it
+PigletStatus piglet_load_end(PigletChunkedLoad load);
+
+// Roll back a load not yet ended, and release it
+PigletStatus piglet_load_abort(PigletChunkedLoad load);
+
 // Return the URI of node (or string if node is a literal)
 char *piglet_info(DB db, Node node, Node *datatype, char *language);
 
@@ -136,11 +268,65 @@ PigletStatus piglet_del_namespace(DB db, const char *prefix);
 // Match node URIs and literal strings
 PigletStatus piglet_match(DB db, const char *pattern, void* userdata, NodeCallback callback);
 
-// ...
+// Begin a transaction; within one already begun on this thread, begin a nested
+// transaction instead (loads and source deletions nest the same way)
 PigletStatus piglet_transaction(DB db);
 
-// ...
+// Commit the innermost transaction; nested ones become durable only when the
+// outermost is committed
 PigletStatus piglet_commit(DB db);
 
-// ...
+// Roll back the innermost transaction, leaving any enclosing one open
 PigletStatus piglet_rollback(DB db);
+
+// Enter bulk mode: triples are added without duplicate probes, and secondary
+// indexes are optionally dropped until the matching piglet_end_bulk
+PigletStatus piglet_begin_bulk(DB db, bool dropIndexes);
+
+// Leave bulk mode, rebuilding dropped indexes if this was the outermost level
+PigletStatus piglet_end_bulk(DB db);
+
+// Write the triples of a source (or of the whole store if source is 0) to an
+// immutable, memory-mappable snapshot file
+PigletStatus piglet_compile_snapshot(DB db, const char *path, Node source);
+
+// Map a snapshot file and serve its triples along with those of the store
+PigletStatus piglet_attach_snapshot(DB db, const char *path);
+
+// Report counters of the node dictionary cache (URIs and literals) and the blank node label cache
+PigletStatus piglet_cache_stats(DB db, PigletCacheStats *nodes, PigletCacheStats *bnodes);
+
+// Set the maximum number of entries in each node dictionary cache (0 disables caching)
+PigletStatus piglet_set_cache_size(DB db, unsigned long entries);
+
+// Commit add and delete calls made outside of transactions in groups of at most
+// maxBatch, waiting up to maxDelay microseconds for a group to fill (maxBatch 0
+// turns group commit off)
+PigletStatus piglet_set_group_commit(DB db, unsigned long maxBatch, long maxDelay);
+
+// Report counters of group commit
+PigletStatus piglet_group_commit_stats(DB db, PigletGroupCommitStats *stats);
+
+// Refresh sources on a thread of their own, checking each every interval
+// seconds (0 stops)
+PigletStatus piglet_set_refresh(DB db, long interval);
+
+// Check a source every interval seconds instead (0 never, negative for the
+// interval of piglet_set_refresh, which must be on)
+PigletStatus piglet_set_refresh_interval(DB db, Node source, long interval);
+
+// Count acquisitions of the store's write lock per call site (node, literal,
+// add, load, ...), with the time spent waiting for and holding it; turning
+// this on clears the counters
+PigletStatus piglet_set_lock_stats(DB db, bool enabled);
+
+// Fill in the counters of at most n call sites; returns the number of sites
+// (-1 on error)
+int piglet_lock_stats(DB db, PigletLockStats *stats, int n);
+
+// Build a new triple store from local N-Triples, N-Quads and RDF/XML files,
+// sorting on disk in bounded memory (bytes in all, SQLite's cache included,
+// 0 for the default) instead of loading them one triple at a time; the store must not
+// exist yet, and is opened with piglet_open afterwards
+PigletStatus piglet_import(const char *path, const char **files, int n, unsigned long memory,
+                           bool verbose);
@@ -20,16 +20,15 @@ INSERT INTO node VALUES(5, 'http://www.w3.org/2000/01/rdf-schema#subClassOf', 0,
 INSERT INTO node VALUES(6, 'http://www.w3.org/2000/01/rdf-schema#label', 0, NULL);
 INSERT INTO node VALUES(0, 'http://www.nokia.com/NRC/M3/sib#any', 0, NULL);
 
-CREATE TABLE triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER);
-CREATE INDEX s ON triple (s);
-CREATE INDEX o ON triple (o);
-CREATE INDEX sp ON triple (s, p);
-CREATE INDEX spo ON triple (s, p, o);
-CREATE INDEX po ON triple (p, o);
+CREATE TABLE triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER,
+                     PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;
+CREATE INDEX pos ON triple (p, o);
+CREATE INDEX osp ON triple (o, s);
+CREATE INDEX srcspo ON triple (src);
 
-CREATE TABLE source (src INTEGER UNIQUE PRIMARY KEY, created INTEGER, loaded INTEGER);
+CREATE TABLE source (src INTEGER UNIQUE PRIMARY KEY, created INTEGER, loaded INTEGER, etag TEXT);
 
 CREATE TABLE info (version TEXT);
-INSERT INTO info VALUES('Piglet 0.1');
+INSERT INTO info VALUES('Piglet 0.3');
 
 COMMIT;
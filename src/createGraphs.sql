@@ -0,0 +1,2 @@
+CREATE TABLE IF NOT EXISTS graph (src INTEGER, graph INTEGER,
+                                  PRIMARY KEY (src, graph)) WITHOUT ROWID;
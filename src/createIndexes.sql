@@ -0,0 +1,3 @@
+CREATE INDEX IF NOT EXISTS pos ON triple (p, o);
+CREATE INDEX IF NOT EXISTS osp ON triple (o, s);
+CREATE INDEX IF NOT EXISTS srcspo ON triple (src);
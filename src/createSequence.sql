@@ -0,0 +1,5 @@
+CREATE TABLE IF NOT EXISTS sequence (high INTEGER, low INTEGER);
+INSERT INTO sequence
+  SELECT max(0, coalesce((SELECT max(id) FROM node), 0)),
+         min(0, coalesce((SELECT min(id) FROM node), 0))
+  WHERE NOT EXISTS (SELECT 1 FROM sequence);
@@ -0,0 +1,2 @@
+CREATE TABLE IF NOT EXISTS triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER,
+                                   PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;
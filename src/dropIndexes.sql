@@ -0,0 +1,3 @@
+DROP INDEX IF EXISTS pos;
+DROP INDEX IF EXISTS osp;
+DROP INDEX IF EXISTS srcspo;
@@ -0,0 +1,111 @@
+#!/usr/bin/python
+
+#
+#   fetch-standin.py
+#
+#   Author: Ora Lassila mailto:ora.lassila@nokia.com
+#   Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+#
+#   A local HTTP stand-in for testing conditional fetches: serves the files
+#   of a directory with an ETag and a Last-Modified header, answers 304 to
+#   If-None-Match and If-Modified-Since, and gzips bodies when asked to.
+#   GET /-/requests returns (and forgets) the requests served so far, one
+#   "METHOD path status" line each.
+#
+#   Usage: fetch-standin.py port directory
+#
+
+import sys
+import os
+import gzip
+import hashlib
+import io
+try:
+    import BaseHTTPServer as server
+    import SocketServer as socketserver
+    from email.Utils import formatdate, parsedate_tz, mktime_tz
+except ImportError:
+    import http.server as server
+    import socketserver
+    from email.utils import formatdate, parsedate_tz, mktime_tz
+
+requests = []
+
+class StandinServer(socketserver.ThreadingMixIn, server.HTTPServer):
+    daemon_threads = True
+
+class StandinRequestHandler(server.BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def do_HEAD(self):
+        self.answer(False)
+
+    def do_GET(self):
+        if self.path == '/-/requests':
+            body = ''.join(requests).encode('ascii')
+            del requests[:]
+            self.send_response(200)
+            self.send_header('Content-Type', 'text/plain')
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+        else:
+            self.answer(True)
+
+    def answer(self, withBody):
+        path = os.path.join(self.server.root, self.path.lstrip('/'))
+        if not os.path.isfile(path):
+            self.served(404)
+            self.send_error(404)
+            return
+        f = open(path, 'rb')
+        try:
+            body = f.read()
+        finally:
+            f.close()
+        mtime = int(os.stat(path).st_mtime)
+        etag = '"%s"' % hashlib.md5(body).hexdigest()
+        if self.notModified(etag, mtime):
+            self.served(304)
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+        zipped = 'gzip' in (self.headers.get('Accept-Encoding') or '')
+        if zipped:
+            out = io.BytesIO()
+            z = gzip.GzipFile(fileobj=out, mode='wb')
+            z.write(body)
+            z.close()
+            body = out.getvalue()
+        self.served(200)
+        self.send_response(200)
+        self.send_header('ETag', etag)
+        self.send_header('Last-Modified', formatdate(mtime, usegmt=True))
+        if zipped:
+            self.send_header('Content-Encoding', 'gzip')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        if withBody:
+            self.wfile.write(body)
+
+    def notModified(self, etag, mtime):
+        match = self.headers.get('If-None-Match')
+        if match is not None:
+            return match == etag
+        since = self.headers.get('If-Modified-Since')
+        if since is not None:
+            parsed = parsedate_tz(since)
+            return parsed is not None and mtime <= mktime_tz(parsed)
+        return False
+
+    def served(self, status):
+        requests.append('%s %s %d\n' % (self.command, self.path, status))
+
+    def log_message(self, format, *args):
+        pass
+
+if __name__ == "__main__":
+    httpd = StandinServer(('127.0.0.1', int(sys.argv[1])), StandinRequestHandler)
+    httpd.root = sys.argv[2]
+    httpd.serve_forever()
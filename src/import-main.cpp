@@ -0,0 +1,84 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  import-main.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ *
+ *  Builds a new store from N-Triples, N-Quads and RDF/XML files in bounded
+ *  memory, without loading them one triple at a time.
+ *
+ *  Usage: piglet-import [-m megabytes] [-j threads] [-t tempdir] [-v] store file...
+ *
+ *  -m  memory in all, SQLite's cache included (256)
+ *  -j  threads to parse and sort on (one per processor)
+ *  -t  directory for temporary files ($TMPDIR, or /tmp)
+ *  -v  report progress
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "piglet.h"
+
+using namespace Piglet;
+
+int main(int argc, char *argv[])
+{
+  ImportOptions options = { 0, 0, "", false };
+  int c;
+  while ((c = getopt(argc, argv, "m:j:t:v")) != -1) {
+    switch (c) {
+      case 'm': options.memory = (size_t)atol(optarg) << 20; break;
+      case 'j': options.threads = atoi(optarg); break;
+      case 't': options.tempDir = optarg; break;
+      case 'v': options.verbose = true; break;
+      default: optind = argc; // report usage
+    }
+  }
+  if (argc - optind < 2) {
+    fprintf(stderr, "Usage: %s [-m megabytes] [-j threads] [-t tempdir] [-v] store file...\n",
+            argv[0]);
+    exit(1);
+  }
+  try {
+    import(argv[optind], std::vector<std::string>(argv + optind + 1, argv + argc), &options);
+  }
+  catch (Condition &c) {
+    std::cerr << c << "\n";
+    exit(1);
+  }
+  exit(0);
+}
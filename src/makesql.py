@@ -23,6 +23,13 @@ if __name__ == "__main__":
         o.write("#pragma once\n\nnamespace Piglet {\n")
         makeStringConstant(o, "SQL_CREATE_TEMP_DB", "createTempDB.sql")
         makeStringConstant(o, "SQL_CREATE_DB", "createDB.sql")
+        makeStringConstant(o, "SQL_MIGRATE_DB", "migrateDB.sql")
+        makeStringConstant(o, "SQL_MIGRATE_SOURCE", "migrateSource.sql")
+        makeStringConstant(o, "SQL_CREATE_SEQUENCE", "createSequence.sql")
+        makeStringConstant(o, "SQL_CREATE_GRAPHS", "createGraphs.sql")
+        makeStringConstant(o, "SQL_CREATE_INDEXES", "createIndexes.sql")
+        makeStringConstant(o, "SQL_DROP_INDEXES", "dropIndexes.sql")
+        makeStringConstant(o, "SQL_CREATE_SHARD", "createShard.sql")
         o.write("\n}\n")
     finally:
         o.close()
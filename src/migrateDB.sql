@@ -0,0 +1,13 @@
+BEGIN;
+
+CREATE TABLE triple_0_3 (s INTEGER, p INTEGER, o INTEGER, src INTEGER,
+                         PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;
+INSERT OR IGNORE INTO triple_0_3 SELECT s, p, o, src FROM triple ORDER BY s, p, o, src;
+DROP TABLE triple;
+ALTER TABLE triple_0_3 RENAME TO triple;
+CREATE INDEX pos ON triple (p, o);
+CREATE INDEX osp ON triple (o, s);
+CREATE INDEX srcspo ON triple (src);
+UPDATE info SET version = 'Piglet 0.3';
+
+COMMIT;
@@ -0,0 +1 @@
+ALTER TABLE source ADD COLUMN etag TEXT;
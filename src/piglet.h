@@ -41,3 +41,7 @@
 #pragma once
 
 #include "DB.h"
+#include "MemoryDB.h"
+#include "ShardedDB.h"
+#include "LoadJob.h"
+#include "Importer.h"
@@ -90,10 +90,11 @@ static PyObject *PyPiglet_status(PigletStatus status)
 PyObject *PyPiglet_open(PyObject *self, PyObject *args)
 {
   char *name;
+  int backend = PigletSQLite;
   DB db;
   PyPiglet_DBObject *o;
-  if (PyArg_ParseTuple(args, "s", &name)) {
-    db = piglet_open(name);
+  if (PyArg_ParseTuple(args, "s|i", &name, &backend)) {
+    db = piglet_open_backend(name, (PigletBackend)backend);
     if (db) {
       o = new_PyPiglet_DBObject(NULL);
       if (o) {
@@ -107,6 +108,49 @@ PyObject *PyPiglet_open(PyObject *self, PyObject *args)
   return NULL;
 }
 
+PyObject *PyPiglet_openSharded(PyObject *self, PyObject *args)
+{
+  char *name;
+  int shards;
+  DB db;
+  PyPiglet_DBObject *o;
+  if (PyArg_ParseTuple(args, "si", &name, &shards)) {
+    db = piglet_open_sharded(name, shards);
+    if (db) {
+      o = new_PyPiglet_DBObject(NULL);
+      if (o) {
+        Py_INCREF(o);
+        o->db = db;
+        return (PyObject *)o;
+      }
+    }
+    return PyPiglet_status(PigletError);
+  }
+  return NULL;
+}
+
+PyObject *PyPiglet_importFiles(PyObject *self, PyObject *args)
+{
+  PyObject *list, *seq, *result = NULL;
+  char *name;
+  const char **files;
+  int i, n, verbose = 0;
+  unsigned long memory = 0;
+  if (!PyArg_ParseTuple(args, "sO|ki", &name, &list, &memory, &verbose))
+    return NULL;
+  if ((seq = PySequence_Fast(list, "importFiles expects a sequence of files")) == NULL)
+    return NULL;
+  n = PySequence_Fast_GET_SIZE(seq);
+  files = (const char **)malloc((n + 1) * sizeof(char *));
+  for (i = 0; i < n; i++)
+    files[i] = PyString_AsString(PySequence_Fast_GET_ITEM(seq, i));
+  if (!PyErr_Occurred())
+    result = PyPiglet_status(piglet_import(name, files, n, memory, verbose != 0));
+  free(files);
+  Py_DECREF(seq);
+  return result;
+}
+
 PyObject *PyPiglet_close(PyObject *self, PyObject *args)
 {
   if (PyArg_ParseTuple(args, ""))
@@ -278,6 +322,90 @@ PyObject *PyPiglet_load(PyObject *self, PyObject *args)
     return NULL;
 }
 
+PyObject *PyPiglet_setFetchCache(PyObject *self, PyObject *args)
+{
+  char *dir = NULL;
+  if (PyArg_ParseTuple(args, "z", &dir))
+    return PyPiglet_status(piglet_set_fetch_cache(asDB(self), dir));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_loadMany(PyObject *self, PyObject *args)
+{
+  PyObject *list, *seq, *loaded = NULL;
+  int i, n, append = 0, verbose = 0;
+  Node *sources;
+  PigletStatus *results;
+  if (!PyArg_ParseTuple(args, "O|ii", &list, &append, &verbose))
+    return NULL;
+  if ((seq = PySequence_Fast(list, "loadMany expects a sequence of nodes")) == NULL)
+    return NULL;
+  n = PySequence_Fast_GET_SIZE(seq);
+  sources = (Node *)malloc((n + 1) * sizeof(Node));
+  results = (PigletStatus *)malloc((n + 1) * sizeof(PigletStatus));
+  for (i = 0; i < n; i++)
+    sources[i] = PyInt_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+  if (!PyErr_Occurred()) {
+    if (piglet_load_many(asDB(self), sources, n, results, append != 0, verbose != 0) == PigletError)
+      loaded = PyPiglet_status(PigletError);
+    else {
+      loaded = PyList_New(n);
+      for (i = 0; i < n; i++)
+        PyList_SET_ITEM(loaded, i, PyBool_FromLong(results[i] == PigletTrue));
+    }
+  }
+  free(results);
+  free(sources);
+  Py_DECREF(seq);
+  return loaded;
+}
+
+PyObject *PyPiglet_reload(PyObject *self, PyObject *args)
+{
+  int source, verbose = 0;
+  PigletReloadCounts counts;
+  PigletStatus status;
+  if (!PyArg_ParseTuple(args, "i|i", &source, &verbose))
+    return NULL;
+  status = piglet_reload(asDB(self), source, verbose != 0, &counts);
+  if (status == PigletTrue)
+    return Py_BuildValue("(lll)", counts.added, counts.removed, counts.kept);
+  return PyPiglet_status(status);
+}
+
+PyObject *PyPiglet_refreshSources(PyObject *self, PyObject *args)
+{
+  int verbose = 0;
+  PigletRefreshCounts counts;
+  PigletStatus status;
+  if (!PyArg_ParseTuple(args, "|i", &verbose))
+    return NULL;
+  status = piglet_refresh_sources(asDB(self), verbose != 0, &counts);
+  if (status == PigletError)
+    return PyPiglet_status(status);
+  return Py_BuildValue("(llll)", counts.checked, counts.stale, counts.loaded, counts.unknown);
+}
+
+PyObject *PyPiglet_setRefresh(PyObject *self, PyObject *args)
+{
+  long interval;
+  if (PyArg_ParseTuple(args, "l", &interval))
+    return PyPiglet_status(piglet_set_refresh(asDB(self), interval));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_setRefreshInterval(PyObject *self, PyObject *args)
+{
+  int source;
+  long interval;
+  if (PyArg_ParseTuple(args, "il", &source, &interval))
+    return PyPiglet_status(piglet_set_refresh_interval(asDB(self), source, interval));
+  else
+    return NULL;
+}
+
 PyObject *PyPiglet_node_tostring(PyObject *self, PyObject *args)
 {
   int node;
@@ -413,6 +541,101 @@ PyObject *PyPiglet_rollback(PyObject *self, PyObject *args)
     return NULL;
 }
 
+PyObject *PyPiglet_begin_bulk(PyObject *self, PyObject *args)
+{
+  int dropIndexes = 0;
+  if (PyArg_ParseTuple(args, "|i", &dropIndexes))
+    return PyPiglet_status(piglet_begin_bulk(asDB(self), dropIndexes));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_end_bulk(PyObject *self, PyObject *args)
+{
+  if (PyArg_ParseTuple(args, ""))
+    return PyPiglet_status(piglet_end_bulk(asDB(self)));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_compile_snapshot(PyObject *self, PyObject *args)
+{
+  char *path;
+  Node source = 0;
+  if (PyArg_ParseTuple(args, "s|i", &path, &source))
+    return PyPiglet_status(piglet_compile_snapshot(asDB(self), path, source));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_attach_snapshot(PyObject *self, PyObject *args)
+{
+  char *path;
+  if (PyArg_ParseTuple(args, "s", &path))
+    return PyPiglet_status(piglet_attach_snapshot(asDB(self), path));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_cache_stats(PyObject *self, PyObject *args)
+{
+  PigletCacheStats nodes, bnodes;
+  if (PyArg_ParseTuple(args, "")) {
+    piglet_cache_stats(asDB(self), &nodes, &bnodes);
+    return Py_BuildValue("((kkkk)(kkkk))",
+                         nodes.hits, nodes.misses, nodes.entries, nodes.capacity,
+                         bnodes.hits, bnodes.misses, bnodes.entries, bnodes.capacity);
+  }
+  return NULL;
+}
+
+PyObject *PyPiglet_set_cache_size(PyObject *self, PyObject *args)
+{
+  unsigned long entries;
+  if (PyArg_ParseTuple(args, "k", &entries))
+    return PyPiglet_status(piglet_set_cache_size(asDB(self), entries));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_set_lock_stats(PyObject *self, PyObject *args)
+{
+  int enabled;
+  if (PyArg_ParseTuple(args, "i", &enabled))
+    return PyPiglet_status(piglet_set_lock_stats(asDB(self), enabled));
+  else
+    return NULL;
+}
+
+PyObject *PyPiglet_lock_stats(PyObject *self, PyObject *args)
+{
+  PigletLockStats *stats;
+  PyObject *list;
+  int i, n;
+  if (!PyArg_ParseTuple(args, ""))
+    return NULL;
+  n = piglet_lock_stats(asDB(self), NULL, 0);
+  if (n < 0)
+    return PyPiglet_status(PigletError);
+  stats = (PigletLockStats *)malloc((n + 1) * sizeof(PigletLockStats));
+  n = piglet_lock_stats(asDB(self), stats, n);
+  list = PyList_New(0);
+  for (i = 0; (i < n) && list; i++) {
+    PyObject *item = Py_BuildValue("(zkkdddd)", stats[i].site, stats[i].acquisitions,
+                                   stats[i].contended, stats[i].waitTime, stats[i].maxWait,
+                                   stats[i].holdTime, stats[i].maxHold);
+    if (item == NULL || PyList_Append(list, item) < 0) {
+      Py_XDECREF(item);
+      Py_DECREF(list);
+      list = NULL;
+    }
+    else
+      Py_DECREF(item);
+  }
+  free(stats);
+  return list;
+}
+
 #define method(name, func, doc) {name, func, METH_VARARGS, PyDoc_STR(doc)}
 
 static PyMethodDef PyPiglet_DBObject_methods[] = {
@@ -428,6 +651,12 @@ static PyMethodDef PyPiglet_DBObject_methods[] = {
   method("literal",        PyPiglet_literal,         "literal(string[, datatype, language]) -> node"),
   method("augmentLiteral", PyPiglet_augmentLiteral,  "augmentLiteral(literal, datatype) -> bool"),
   method("load",           PyPiglet_load,            "load(node, append) -> bool"),
+  method("loadMany",       PyPiglet_loadMany,        "loadMany(nodes[, append, verbose]) -> list"),
+  method("setFetchCache",  PyPiglet_setFetchCache,   "setFetchCache(dir or None) -> bool"),
+  method("reload",         PyPiglet_reload,          "reload(node[, verbose]) -> (added, removed, kept) or False"),
+  method("refreshSources", PyPiglet_refreshSources,  "refreshSources([verbose]) -> (checked, stale, loaded, unknown)"),
+  method("setRefresh",     PyPiglet_setRefresh,      "setRefresh(seconds) -> bool"),
+  method("setRefreshInterval", PyPiglet_setRefreshInterval, "setRefreshInterval(node, seconds) -> bool"),
   method("nodeToString",   PyPiglet_node_tostring,   "nodeToString(node) -> string"),
   method("tripleToString", PyPiglet_triple_tostring, "tripleToString(s, p, o) -> string"),
   method("expand",         PyPiglet_expand,          "expand(qname) -> uri"),
@@ -439,6 +668,14 @@ static PyMethodDef PyPiglet_DBObject_methods[] = {
   method("transaction",    PyPiglet_transaction,     "transaction() -> bool"),
   method("commit",         PyPiglet_commit,          "commit() -> bool"),
   method("rollback",       PyPiglet_rollback,        "rollback() -> bool"),
+  method("beginBulk",      PyPiglet_begin_bulk,      "beginBulk([dropIndexes]) -> bool"),
+  method("endBulk",        PyPiglet_end_bulk,        "endBulk() -> bool"),
+  method("compileSnapshot", PyPiglet_compile_snapshot, "compileSnapshot(path[, source]) -> bool"),
+  method("attachSnapshot", PyPiglet_attach_snapshot,  "attachSnapshot(path) -> bool"),
+  method("cacheStats",     PyPiglet_cache_stats,     "cacheStats() -> ((hits, misses, entries, capacity), (...))"),
+  method("setCacheSize",   PyPiglet_set_cache_size,  "setCacheSize(entries) -> bool"),
+  method("setLockStats",   PyPiglet_set_lock_stats,  "setLockStats(enabled) -> bool"),
+  method("lockStats",      PyPiglet_lock_stats,      "lockStats() -> [(site, acquisitions, contended, wait, maxWait, hold, maxHold), ...]"),
   {NULL, NULL}
 };
 
@@ -487,7 +724,9 @@ static PyTypeObject PyPiglet_DBType = {
 };
 
 static PyMethodDef PyPiglet_methods[] = {
-  method("open", PyPiglet_open, "open(file) -> DB"),
+  method("open", PyPiglet_open, "open(file[, backend]) -> DB"),
+  method("openSharded", PyPiglet_openSharded, "openSharded(file, shards) -> DB"),
+  method("importFiles", PyPiglet_importFiles, "importFiles(file, files[, memory, verbose]) -> bool"),
   {NULL, NULL} /* sentinel */
 };
 
@@ -498,6 +737,8 @@ PyMODINIT_FUNC initpiglet(void)
     if (m != NULL) {
       Py_INCREF(&PyPiglet_DBType);
       PyModule_AddObject(m, "DB", (PyObject *)&PyPiglet_DBType);
+      PyModule_AddIntConstant(m, "SQLITE", PigletSQLite);
+      PyModule_AddIntConstant(m, "MEMORY", PigletMemory);
       PyPiglet_Exception = PyErr_NewException("piglet.error", NULL, NULL);
       Py_INCREF(PyPiglet_Exception);
       PyModule_AddObject(m, "error", PyPiglet_Exception);
@@ -6,12 +6,11 @@ static const char *SQL_CREATE_TEMP_DB =
 "CREATE TABLE cache.bnode (id INTEGER UNIQUE PRIMARY KEY, str TEXT);\
 CREATE INDEX cache.strs ON bnode (str);\
 \
-CREATE TABLE cache.triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER);\
-CREATE INDEX cache.s ON triple (s);\
-CREATE INDEX cache.o ON triple (o);\
-CREATE INDEX cache.sp ON triple (s, p);\
-CREATE INDEX cache.spo ON triple (s, p, o);\
-CREATE INDEX cache.po ON triple (p, o);";
+CREATE TABLE cache.triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER,\
+                           PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;\
+CREATE INDEX cache.pos ON triple (p, o);\
+CREATE INDEX cache.osp ON triple (o, s);\
+CREATE INDEX cache.srcspo ON triple (src);";
 
 static const char *SQL_CREATE_DB =
 "BEGIN;\
@@ -36,18 +35,60 @@ INSERT INTO node VALUES(5, 'http://www.w3.org/2000/01/rdf-schema#subClassOf', 0,
 INSERT INTO node VALUES(6, 'http://www.w3.org/2000/01/rdf-schema#label', 0, NULL);\
 INSERT INTO node VALUES(0, 'http://www.nokia.com/NRC/M3/sib#any', 0, NULL);\
 \
-CREATE TABLE triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER);\
-CREATE INDEX s ON triple (s);\
-CREATE INDEX o ON triple (o);\
-CREATE INDEX sp ON triple (s, p);\
-CREATE INDEX spo ON triple (s, p, o);\
-CREATE INDEX po ON triple (p, o);\
+CREATE TABLE triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER,\
+                     PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;\
+CREATE INDEX pos ON triple (p, o);\
+CREATE INDEX osp ON triple (o, s);\
+CREATE INDEX srcspo ON triple (src);\
 \
-CREATE TABLE source (src INTEGER UNIQUE PRIMARY KEY, created INTEGER, loaded INTEGER);\
+CREATE TABLE source (src INTEGER UNIQUE PRIMARY KEY, created INTEGER, loaded INTEGER, etag TEXT);\
 \
 CREATE TABLE info (version TEXT);\
-INSERT INTO info VALUES('Piglet 0.1');\
+INSERT INTO info VALUES('Piglet 0.3');\
 \
 COMMIT;";
 
+static const char *SQL_MIGRATE_DB =
+"BEGIN;\
+\
+CREATE TABLE triple_0_3 (s INTEGER, p INTEGER, o INTEGER, src INTEGER,\
+                         PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;\
+INSERT OR IGNORE INTO triple_0_3 SELECT s, p, o, src FROM triple ORDER BY s, p, o, src;\
+DROP TABLE triple;\
+ALTER TABLE triple_0_3 RENAME TO triple;\
+CREATE INDEX pos ON triple (p, o);\
+CREATE INDEX osp ON triple (o, s);\
+CREATE INDEX srcspo ON triple (src);\
+UPDATE info SET version = 'Piglet 0.3';\
+\
+COMMIT;";
+
+static const char *SQL_MIGRATE_SOURCE =
+"ALTER TABLE source ADD COLUMN etag TEXT;";
+
+static const char *SQL_CREATE_SEQUENCE =
+"CREATE TABLE IF NOT EXISTS sequence (high INTEGER, low INTEGER);\
+INSERT INTO sequence\
+  SELECT max(0, coalesce((SELECT max(id) FROM node), 0)),\
+         min(0, coalesce((SELECT min(id) FROM node), 0))\
+  WHERE NOT EXISTS (SELECT 1 FROM sequence);";
+
+static const char *SQL_CREATE_GRAPHS =
+"CREATE TABLE IF NOT EXISTS graph (src INTEGER, graph INTEGER,\
+                                  PRIMARY KEY (src, graph)) WITHOUT ROWID;";
+
+static const char *SQL_CREATE_INDEXES =
+"CREATE INDEX IF NOT EXISTS pos ON triple (p, o);\
+CREATE INDEX IF NOT EXISTS osp ON triple (o, s);\
+CREATE INDEX IF NOT EXISTS srcspo ON triple (src);";
+
+static const char *SQL_DROP_INDEXES =
+"DROP INDEX IF EXISTS pos;\
+DROP INDEX IF EXISTS osp;\
+DROP INDEX IF EXISTS srcspo;";
+
+static const char *SQL_CREATE_SHARD =
+"CREATE TABLE IF NOT EXISTS triple (s INTEGER, p INTEGER, o INTEGER, src INTEGER,\
+                                   PRIMARY KEY (s, p, o, src)) WITHOUT ROWID;";
+
 }
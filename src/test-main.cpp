@@ -0,0 +1,602 @@
+/*
+
+  Copyright (c) 2009, Nokia Corporation
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions
+  are met:
+  
+    * Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.  
+    * Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in
+    the documentation and/or other materials provided with the
+    distribution.  
+    * Neither the name of Nokia nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+  INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+  SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+  HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+  OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+  EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+/*
+ *  test-main.cpp
+ *
+ *  Author: Ora Lassila mailto:ora.lassila@nokia.com
+ *  Copyright (c) 2001-2008 Nokia. All Rights Reserved.
+ *
+ *  Checks loading against expected output.
+ *
+ *  Usage: piglet-test directory
+ *
+ *  Every name.nt or name.nq in the directory is loaded as a source of a new
+ *  store, and the store must then hold exactly the triples listed in
+ *  name.out. A case of several steps has inputs name.1.nq, name.2.nq, ...,
+ *  loaded in turn as the same source, with name.out listing what the store
+ *  holds after the last; a case without name.out must fail to load. Each
+ *  case is run with
+ *
+ *  load       DB::load()
+ *  async      DB::loadAsync(), which tokenizes a file on several threads
+ *  pipelined  DB::load() with parsing, encoding and inserting on separate
+ *             threads
+ *  loadMany   DB::loadMany()
+ *  reload     DB::reload() for every step
+ *  import     import() of the first step, in little memory and with few
+ *             descriptors to spare, and DB::load() of the rest
+ *
+ *  Every name.script is run against a new DB, MemoryDB and ShardedDB, and
+ *  what the source it writes to then holds must be what name.out lists. A
+ *  script has a command per line:
+ *
+ *  begin, commit, rollback   DB::transaction(), commit() and rollback(),
+ *                            which nest
+ *  add s p o, del s p o      DB::add() and del() of a triple, whose terms
+ *                            are IRIs or plain literals without escapes
+ *  count n                   the source must hold n triples
+ *
+ *  A further case, split, is generated: a file large enough to be tokenized
+ *  in several segments, with a blank node label used throughout.
+ *
+ *  Expected output has a line per triple, in N-Quads: triples of the loaded
+ *  source have no graph, and blank nodes are labelled b1, b2, ... in the
+ *  order they first appear once the lines are sorted. Lines starting with #
+ *  are ignored. Exits with 1 if any case fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include "piglet.h"
+
+using namespace Piglet;
+
+static const char *modes[] = { "load", "async", "pipelined", "loadMany", "reload", "import", NULL };
+static const char *stores[] = { "DB", "MemoryDB", "ShardedDB", NULL };
+static const int SHARDS = 3;
+
+struct TestCase {
+  std::string name;
+  std::string extension; // of the source, ".nt" or ".nq", or ".script"
+  std::vector<std::string> steps; // input files, loaded in turn
+};
+
+static std::string escape(const char *s)
+{
+  std::string escaped;
+  for (; *s; s++) {
+    switch (*s) {
+      case '\\': escaped += "\\\\"; break;
+      case '"':  escaped += "\\\""; break;
+      case '\n': escaped += "\\n"; break;
+      case '\r': escaped += "\\r"; break;
+      case '\t': escaped += "\\t"; break;
+      default:   escaped += *s;
+    }
+  }
+  return escaped;
+}
+
+// Blank nodes are written as "_:" here, and numbered once the lines are sorted
+
+static std::string term(DB &db, Node n)
+{
+  Node datatype = NULL_NODE;
+  char language[256];
+  language[0] = '\0';
+  TemporaryString str(db.info(n, &datatype, language));
+  if (!n.isLiteral())
+    return str.string() ? "<" + std::string(str.string()) + ">" : "_:";
+  std::string literal = "\"" + escape(str.string() ? str.string() : "") + "\"";
+  if (datatype != NULL_NODE)
+    return literal + "^^" + term(db, datatype);
+  return language[0] ? literal + "@" + language : literal;
+}
+
+struct DumpedQuad {
+  std::string terms[4]; // the graph empty for the source
+  int ids[4];
+  std::string line(const std::map<int, int> &bnodes) const;
+};
+
+std::string DumpedQuad::line(const std::map<int, int> &bnodes) const
+{
+  std::string l;
+  for (int i = 0; i < 4; i++) {
+    if (terms[i].empty())
+      continue;
+    l += terms[i];
+    std::map<int, int>::const_iterator b = bnodes.find(ids[i]);
+    if ((terms[i] == "_:") && (b != bnodes.end())) {
+      char label[16];
+      snprintf(label, sizeof(label), "b%d", b->second);
+      l += label;
+    }
+    l += " ";
+  }
+  return l + ".";
+}
+
+static bool byMaskedLine(const std::pair<std::string, size_t> &a,
+                         const std::pair<std::string, size_t> &b)
+{
+  return a.first < b.first;
+}
+
+static std::vector<std::string> dumpLines(DB &db, Node source, const std::vector<Quad> &stored)
+{
+  std::vector<DumpedQuad> quads;
+  for (size_t i = 0; i < stored.size(); i++) {
+    DumpedQuad quad;
+    for (int j = 0; j < 4; j++) {
+      quad.ids[j] = stored[i].k[j];
+      quad.terms[j] = ((j < 3) || (Node(quad.ids[j]) != source)) ? term(db, Node(quad.ids[j])) : "";
+    }
+    quads.push_back(quad);
+  }
+  std::map<int, int> none, bnodes;
+  std::vector<std::pair<std::string, size_t> > masked;
+  for (size_t i = 0; i < quads.size(); i++)
+    masked.push_back(std::make_pair(quads[i].line(none), i));
+  std::stable_sort(masked.begin(), masked.end(), byMaskedLine);
+  for (size_t i = 0; i < masked.size(); i++) {
+    const DumpedQuad &quad = quads[masked[i].second];
+    for (int j = 0; j < 4; j++)
+      if ((quad.terms[j] == "_:") && (bnodes.find(quad.ids[j]) == bnodes.end()))
+        bnodes.insert(std::make_pair(quad.ids[j], (int)bnodes.size() + 1));
+  }
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < quads.size(); i++)
+    lines.push_back(quads[i].line(bnodes));
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+// Every triple of the store, whatever its source
+
+static std::vector<std::string> dump(DB &db, Node source)
+{
+  std::vector<Quad> quads;
+  SQL::Statement q(db.getDatabase(), "SELECT s, p, o, src FROM triple");
+  while (q.step()) {
+    Quad quad = { { q.column(0), q.column(1), q.column(2), q.column(3) } };
+    quads.push_back(quad);
+  }
+  return dumpLines(db, source, quads);
+}
+
+// The triples of one source, through the API, which every kind of store has
+
+static std::vector<std::string> dumpSource(DB &db, Node source) MAYFAIL
+{
+  std::vector<Quad> quads;
+  TripleCursor *cursor = db.cursor(NULL_NODE, NULL_NODE, NULL_NODE, source);
+  while (cursor->hasNext()) {
+    Triple t = cursor->next();
+    Quad quad = { { id(t.s()), id(t.p()), id(t.o()), id(source) } };
+    quads.push_back(quad);
+  }
+  delete cursor;
+  return dumpLines(db, source, quads);
+}
+
+static std::vector<std::string> readExpected(const std::string &path)
+{
+  std::vector<std::string> lines;
+  std::ifstream in(path.c_str());
+  std::string line;
+  while (std::getline(in, line))
+    if (!line.empty() && (line[0] != '#'))
+      lines.push_back(line);
+  std::sort(lines.begin(), lines.end());
+  return lines;
+}
+
+static bool compare(const std::vector<std::string> &expected, const std::vector<std::string> &got)
+{
+  std::vector<std::string> missing, extra;
+  std::set_difference(expected.begin(), expected.end(), got.begin(), got.end(),
+                      std::back_inserter(missing));
+  std::set_difference(got.begin(), got.end(), expected.begin(), expected.end(),
+                      std::back_inserter(extra));
+  for (size_t i = 0; i < missing.size(); i++)
+    printf("  missing: %s\n", missing[i].c_str());
+  for (size_t i = 0; i < extra.size(); i++)
+    printf("  extra:   %s\n", extra[i].c_str());
+  return missing.empty() && extra.empty() && (expected.size() == got.size());
+}
+
+static void copyStep(const std::string &from, const std::string &to, time_t modified) MAYFAIL
+{
+  FILE *in = fopen(from.c_str(), "rb");
+  FILE *out = fopen(to.c_str(), "wb");
+  if ((in == NULL) || (out == NULL)) {
+    if (in) fclose(in);
+    if (out) fclose(out);
+    FAIL("Unable to copy " + from);
+  }
+  char buffer[8192];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    fwrite(buffer, 1, n, out);
+  fclose(in);
+  fclose(out);
+  struct utimbuf times = { modified, modified }; // every step is a newer file
+  utime(to.c_str(), &times);
+}
+
+// Returns false if the source did not load, for whatever reason
+
+static bool loadStep(DB &db, const char *mode, Node source)
+{
+  try {
+    if (strcmp(mode, "async") == 0) {
+      LoadJob *job = db.loadAsync(source);
+      bool loaded = (job->wait() == LoadJob::LOADED);
+      if (!loaded)
+        printf("  %s\n", job->error().c_str());
+      delete job;
+      return loaded;
+    }
+    else if (strcmp(mode, "loadMany") == 0) {
+      std::vector<Node> sources(1, source);
+      std::vector<LoadResult> results;
+      db.loadMany(sources, results);
+      if (!results[0].ok)
+        printf("  %s\n", results[0].error.c_str());
+      return results[0].ok;
+    }
+    else if (strcmp(mode, "reload") == 0) {
+      ReloadResult result;
+      return db.reload(source, result);
+    }
+    else
+      return db.load(source);
+  }
+  catch (Condition &c) {
+    printf("  %s\n", c.message());
+    return false;
+  }
+}
+
+// Little memory spreads even a small file over several partitions, and the
+// lowered limit on open files caps how many there are
+
+static bool importStep(const std::string &store, const std::string &input)
+{
+  ImportOptions options = { 1 << 20, 0, "", false };
+  struct rlimit limit;
+  bool lowered = ((getrlimit(RLIMIT_NOFILE, &limit) == 0) && (limit.rlim_cur > 40));
+  if (lowered) {
+    struct rlimit few = limit;
+    few.rlim_cur = 40;
+    setrlimit(RLIMIT_NOFILE, &few);
+  }
+  bool imported = true;
+  try {
+    import(store.c_str(), std::vector<std::string>(1, input), &options);
+  }
+  catch (Condition &c) {
+    printf("  %s\n", c.message());
+    imported = false;
+  }
+  if (lowered)
+    setrlimit(RLIMIT_NOFILE, &limit);
+  return imported;
+}
+
+static void removeFile(const std::string &path)
+{
+  unlink(path.c_str());
+  unlink((path + "-wal").c_str());
+  unlink((path + "-shm").c_str());
+  unlink((path + "-journal").c_str());
+}
+
+static void removeStore(const std::string &path)
+{
+  removeFile(path);
+  for (int i = 0; i < SHARDS; i++) {
+    char suffix[32];
+    sprintf(suffix, ".shard%d", i);
+    removeFile(path + suffix);
+  }
+}
+
+// A case without expected output must fail to load, and leave nothing behind
+
+static bool run(const TestCase &test, const char *dir, const char *work)
+{
+  std::string out = std::string(dir) + "/" + test.name + ".out";
+  bool fails = (access(out.c_str(), F_OK) != 0);
+  std::vector<std::string> expected = readExpected(out);
+  std::string store = std::string(work) + "/" + test.name + ".db";
+  std::string input = std::string(work) + "/" + test.name + test.extension;
+  bool passed = true;
+  for (int m = 0; modes[m]; m++) {
+    bool ok = true;
+    removeStore(store);
+    try {
+      time_t modified = time(NULL) - 1000;
+      size_t first = 0;
+      bool loaded = true;
+      if (strcmp(modes[m], "import") == 0) {
+        copyStep(std::string(dir) + "/" + test.steps[0], input, modified);
+        loaded = importStep(store, input);
+        first = 1;
+      }
+      DB db((char *)store.c_str());
+      db.setPipelinedLoad(strcmp(modes[m], "pipelined") == 0);
+      Node source = db.node(("file://" + input).c_str());
+      for (size_t i = first; loaded && (i < test.steps.size()); i++) {
+        copyStep(std::string(dir) + "/" + test.steps[i], input, modified + 10 * i);
+        loaded = loadStep(db, modes[m], source);
+        if (!loaded && !fails)
+          printf("  %s failed to load\n", test.steps[i].c_str());
+      }
+      if (loaded && fails)
+        printf("  %s loaded\n", test.name.c_str());
+      ok = (loaded != fails) && compare(expected, dump(db, source));
+    }
+    catch (Condition &c) {
+      printf("  %s\n", c.message());
+      ok = false;
+    }
+    printf("%s %s %s\n", test.name.c_str(), modes[m], ok ? "ok" : "FAILED");
+    passed = passed && ok;
+  }
+  removeStore(store);
+  unlink(input.c_str());
+  return passed;
+}
+
+static Node scriptTerm(DB &db, const std::string &line, size_t &at) MAYFAIL
+{
+  size_t begin = line.find_first_not_of(" \t", at);
+  if ((begin == std::string::npos) || ((line[begin] != '<') && (line[begin] != '"')))
+    FAIL("Expected a term: " + line);
+  size_t end = line.find((line[begin] == '<') ? '>' : '"', begin + 1);
+  if (end == std::string::npos)
+    FAIL("Unterminated term: " + line);
+  at = end + 1;
+  std::string str(line, begin + 1, end - begin - 1);
+  return (line[begin] == '<') ? db.node(str.c_str()) : db.literal(str.c_str());
+}
+
+static void runScript(DB &db, const std::string &path, Node source) MAYFAIL
+{
+  std::ifstream in(path.c_str());
+  std::string line;
+  int number = 0;
+  while (std::getline(in, line)) {
+    number++;
+    size_t at = line.find_first_not_of(" \t");
+    if ((at == std::string::npos) || (line[at] == '#'))
+      continue;
+    size_t end = line.find_first_of(" \t", at);
+    std::string command(line, at, (end == std::string::npos) ? std::string::npos : end - at);
+    at = end;
+    if (command == "begin")
+      db.transaction();
+    else if (command == "commit")
+      db.commit();
+    else if (command == "rollback")
+      db.rollback();
+    else if ((command == "add") || (command == "del")) {
+      Node s = scriptTerm(db, line, at);
+      Node p = scriptTerm(db, line, at);
+      Node o = scriptTerm(db, line, at);
+      Triple t(s, p, o);
+      if (command == "add")
+        db.add(&t, source);
+      else
+        db.del(&t, source);
+    }
+    else if (command == "count") {
+      int expected = atoi(line.c_str() + at);
+      int n = db.count(NULL_NODE, NULL_NODE, NULL_NODE, source, false);
+      if (n != expected) {
+        char message[128];
+        snprintf(message, sizeof(message), "Line %d: %d triples, not %d", number, n, expected);
+        FAIL(message);
+      }
+    }
+    else
+      FAIL("Unknown command: " + line);
+  }
+}
+
+static DB *openStore(const char *kind, const std::string &path) MAYFAIL
+{
+  if (strcmp(kind, "MemoryDB") == 0)
+    return new MemoryDB((char *)path.c_str());
+  else if (strcmp(kind, "ShardedDB") == 0)
+    return new ShardedDB((char *)path.c_str(), SHARDS);
+  else
+    return new DB((char *)path.c_str());
+}
+
+static bool runScripted(const TestCase &test, const char *dir, const char *work)
+{
+  std::vector<std::string> expected = readExpected(std::string(dir) + "/" + test.name + ".out");
+  std::string store = std::string(work) + "/" + test.name + ".db";
+  bool passed = true;
+  for (int k = 0; stores[k]; k++) {
+    bool ok = true;
+    removeStore(store);
+    try {
+      DB *db = openStore(stores[k], store);
+      try {
+        Node source = db->node("http://example.org/script");
+        runScript(*db, std::string(dir) + "/" + test.steps[0], source);
+        if (db->getDatabase()->inTransaction())
+          FAIL("Transaction left open");
+        ok = compare(expected, dumpSource(*db, source));
+      }
+      catch (Condition &c) {
+        delete db;
+        throw;
+      }
+      delete db;
+    }
+    catch (Condition &c) {
+      printf("  %s\n", c.message());
+      ok = false;
+    }
+    printf("%s %s %s\n", test.name.c_str(), stores[k], ok ? "ok" : "FAILED");
+    passed = passed && ok;
+  }
+  removeStore(store);
+  return passed;
+}
+
+// Larger than NTriplesParser tokenizes as one segment several times over
+
+static TestCase generateSplit(const std::string &dir) MAYFAIL
+{
+  TestCase test;
+  test.name = "split";
+  test.extension = ".nt";
+  test.steps.push_back("split.nt");
+  FILE *input = fopen((dir + "/split.nt").c_str(), "w");
+  FILE *output = fopen((dir + "/split.out").c_str(), "w");
+  if ((input == NULL) || (output == NULL)) {
+    if (input) fclose(input);
+    if (output) fclose(output);
+    FAIL("Unable to write " + dir + "/split.nt");
+  }
+  for (int i = 0; i < 60000; i++) {
+    if (i % 5000 == 0) {
+      fprintf(input, "_:x.y <http://example.org/q> \"%d\" .\n", i);
+      fprintf(output, "_:b1 <http://example.org/q> \"%d\" .\n", i);
+    }
+    fprintf(input, "<http://example.org/s%06d> <http://example.org/p> \"%d\" .\n", i, i);
+    fprintf(output, "<http://example.org/s%06d> <http://example.org/p> \"%d\" .\n", i, i);
+  }
+  fclose(input);
+  fclose(output);
+  return test;
+}
+
+// Finds the cases of a directory: name.script, name.nt, name.nq, or the
+// steps name.1.nq, name.2.nq, ... (fewer than ten)
+
+static bool endsWith(const std::string &s, const char *suffix)
+{
+  size_t n = strlen(suffix);
+  return (s.size() > n) && (s.compare(s.size() - n, n, suffix) == 0);
+}
+
+static std::vector<TestCase> findCases(const char *dir) MAYFAIL
+{
+  std::map<std::string, TestCase> cases;
+  DIR *d = opendir(dir);
+  if (d == NULL)
+    FAIL(std::string("Unable to read ") + dir);
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL) {
+    std::string file(entry->d_name);
+    const char *extension = endsWith(file, ".nt") ? ".nt" : endsWith(file, ".nq") ? ".nq"
+                          : endsWith(file, ".script") ? ".script" : NULL;
+    if (extension == NULL)
+      continue;
+    std::string name = file.substr(0, file.size() - strlen(extension));
+    size_t dot = name.rfind('.');
+    if ((dot != std::string::npos) && (dot + 2 == name.size()) && isdigit(name[dot + 1]))
+      name.erase(dot);
+    TestCase &test = cases[name];
+    test.name = name;
+    test.extension = extension;
+    test.steps.push_back(file);
+  }
+  closedir(d);
+  std::vector<TestCase> found;
+  for (std::map<std::string, TestCase>::iterator i = cases.begin(); i != cases.end(); i++) {
+    std::sort(i->second.steps.begin(), i->second.steps.end());
+    found.push_back(i->second);
+  }
+  return found;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s directory\n", argv[0]);
+    exit(1);
+  }
+  const char *tmp = getenv("TMPDIR");
+  std::string pattern = std::string(tmp ? tmp : "/tmp") + "/piglet-test-XXXXXX";
+  char resolved[PATH_MAX];
+  if ((mkdtemp(&pattern[0]) == NULL) || (realpath(pattern.c_str(), resolved) == NULL)) {
+    perror(pattern.c_str());
+    exit(1);
+  }
+  int failed = 0;
+  try {
+    std::vector<TestCase> cases = findCases(argv[1]);
+    for (size_t i = 0; i < cases.size(); i++)
+      if (!((cases[i].extension == ".script") ? runScripted(cases[i], argv[1], resolved)
+                                               : run(cases[i], argv[1], resolved)))
+        failed++;
+    std::string generated = std::string(resolved) + "/generated";
+    mkdir(generated.c_str(), 0700);
+    if (!run(generateSplit(generated), generated.c_str(), resolved))
+      failed++;
+    unlink((generated + "/split.nt").c_str());
+    unlink((generated + "/split.out").c_str());
+    rmdir(generated.c_str());
+  }
+  catch (Condition &c) {
+    std::cerr << c << "\n";
+    failed++;
+  }
+  rmdir(resolved);
+  if (failed)
+    printf("%d case(s) failed\n", failed);
+  return failed ? 1 : 0;
+}